@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include "camera_wake.hpp"
+
+// ========== 按需唤醒：空闲低帧率 <-> 满帧率 ==========
+// 没有障碍物时采集只跑 idle_fps（编码、广播、回看环的开销随之降到很低），
+// 收到传感器的唤醒消息（camera_wake.hpp）立即切到 active_fps；
+// 每个发送方（按 Message::source 区分）各自一份租约：Enter/Hold 续到 hold_ms + cooldown_ms 之后，
+// Leave 缩短到 cooldown_ms 之后；所有租约都到期才回到空闲。
+// 自己一条线程阻塞在 poll 上（数据报 socket + timerfd + 停止用的 eventfd），没有任何轮询。
+class ActivityGate {
+public:
+    struct Config {
+        unsigned idle_fps = 2;
+        unsigned active_fps = 20;
+        unsigned cooldown_ms = 5000;   // 障碍物离开后再保持满帧率这么久
+        unsigned max_hold_ms = 10000;  // 发送方给的租约上限（hold_ms 为 0 时也用它）
+    };
+
+    // 切换帧率的回调，在 gate 的线程里调用；start() 里会先以 idle_fps 调用一次
+    using RateFn = std::function<void(unsigned fps)>;
+
+    ActivityGate() = default;
+    ~ActivityGate();
+    ActivityGate(const ActivityGate&) = delete;
+    ActivityGate& operator=(const ActivityGate&) = delete;
+
+    bool start(const std::string& socket_path, const Config& config, RateFn apply);
+    void stop();
+
+    bool active() const { return active_.load(std::memory_order_relaxed); }
+
+    struct Stats {
+        uint64_t messages = 0;
+        uint64_t invalid = 0;      // 长度、magic 或版本不对
+        uint64_t activations = 0;  // 空闲 -> 满帧率的次数
+        uint64_t active_ms = 0;    // 累计满帧率时长（不含正在进行的这一段）
+    };
+    Stats stats() const;
+
+private:
+    static constexpr size_t SOURCES = 256;
+
+    void run();
+    void onMessage(const CameraWake::Message& msg, uint64_t now);
+    void onTimer(uint64_t now);
+    void rearm(uint64_t now);
+    void setActive(bool active, uint64_t now);
+
+    Config config_;
+    RateFn apply_;
+    int sock_fd_ = -1;
+    int timer_fd_ = -1;
+    int stop_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> active_{false};
+
+    // 只在 gate 线程里访问
+    uint64_t deadline_ns_[SOURCES] = {};  // 各发送方租约到期时刻，0 表示没有
+    uint64_t activated_ns_ = 0;
+
+    std::atomic<uint64_t> messages_{0}, invalid_{0}, activations_{0}, active_ms_{0};
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// 堆分配计数（只给压测工具用）：链接 src/alloc_counter.cpp 的程序里，malloc 系列函数被替换成
+// 带计数的版本（operator new、OpenCV、libjpeg 最终都走 malloc），用来确认稳态下每帧没有堆分配。
+// 不链接时这些函数不存在，服务端本身不受影响。
+namespace AllocCounter {
+
+struct Snapshot {
+    uint64_t allocs = 0;  // malloc/calloc/realloc/memalign 调用次数
+    uint64_t bytes = 0;   // 申请的字节数（不扣除释放）
+};
+
+Snapshot now();
+
+// 两次快照之间的增量
+inline Snapshot since(const Snapshot& start) {
+    Snapshot s = now();
+    return {s.allocs - start.allocs, s.bytes - start.bytes};
+}
+
+}  // namespace AllocCounter
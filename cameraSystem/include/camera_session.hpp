@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Poco/Net/StreamSocket.h>
+#include "capture_pipeline.hpp"
+#include "client_stats.hpp"
+#include "congestion.hpp"
+#include "event_loop.hpp"
+#include "frame.hpp"
+#include "frame_broadcaster.hpp"
+#include "protocol.hpp"
+
+// 一个相机客户端连接（非阻塞 socket，由 EventLoop 驱动，不占线程）。
+// 发送端同一时刻最多排一帧：上一帧还没全部写进内核时不取新帧，广播器会替这个连接跳过过期的帧；
+// 消息头和负载用 sendmsg 的分散/聚集一起写，帧数据直接引用共享的 EncodedFrame，不拷贝；
+// 视频帧的消息头存在消息自身的定长缓冲里，发送队列复用容量，稳态推流时不分配内存。
+// 协议版本由客户端的第一条消息决定（见 protocol.hpp）；连接后短时间内没收到任何消息就按 v1 开始推流。
+class CameraSession {
+public:
+    CameraSession(const Poco::Net::StreamSocket& socket, EventLoop& loop, CapturePipeline& pipeline,
+                  ClientRegistry& registry);
+    ~CameraSession();
+
+    // 设为非阻塞并注册到事件循环；失败返回 false
+    bool open();
+
+    // 有新帧发布时调用（循环线程）：发送队列空着就取一帧
+    void pump();
+
+    // 定时调用（now_ns 为 CLOCK_MONOTONIC）：发送超时检测、统计上报
+    void tick(uint64_t now_ns);
+
+    bool closed() const { return closed_; }
+
+private:
+    // 等窗口结束的抓拍（CAPTURE_COMMAND 带 CaptureRequest），时刻都是 CLOCK_MONOTONIC
+    struct PendingCapture {
+        uint32_t id = 0;
+        uint64_t trigger_ns = 0;
+        uint64_t from_ns = 0;
+        uint64_t until_ns = 0;
+        uint16_t max_frames = 0;
+        uint64_t interval_ns = 0;
+    };
+
+    // 一条待发送的消息：head 是消息头和小负载，body 是共享的帧数据（可为空）
+    struct Outgoing {
+        // 消息头 + FrameTiming 放得下；更大的负载（统计 JSON、v1 抓拍回复）才用 heap_head
+        static constexpr size_t INLINE_HEAD = Protocol::MAX_HEADER_SIZE + 64;
+        uint8_t inline_head[INLINE_HEAD];
+        std::vector<uint8_t> heap_head;
+        size_t head_len = 0;
+        FramePtr body;
+        size_t offset = 0;  // 已经写出的字节
+        bool frame = false; // 视频帧（写完后计入拥塞控制和延迟统计）
+        uint64_t queued_ns = 0;
+        const uint8_t* head() const { return heap_head.empty() ? inline_head : heap_head.data(); }
+        size_t size() const { return head_len + (body ? body->data.size() : 0); }
+    };
+
+    void onEvents(uint32_t events);
+    void onReadable();
+    bool flush();  // 尽量写出发送队列；出错时关闭连接并返回 false
+    void updateInterest();
+    void close(const char* reason);
+
+    void handleMessage(const Protocol::Header& header, const uint8_t* payload);
+    void handleHello(const uint8_t* payload, size_t len);
+    void startCapture(uint32_t id, const Protocol::CaptureRequest& request);
+    void serveCaptures(uint64_t now_ns);
+    void setVersion(uint8_t version);
+    void upgradeToV2();
+    // frame 为 true 时 body 是视频帧：写完后计入拥塞控制和延迟统计，v2 消息头带上它的采集时间、关键帧标志，
+    // 协商了 FEATURE_TIMING 时负载前面加 FrameTiming（这时忽略 payload/len）
+    void queueMessage(Protocol::MessageType type, const void* payload, size_t len, FramePtr body = nullptr,
+                      bool frame = false);
+    // 返回是否排进了发送队列；skipped_before：取这一帧时广播器跳过了前面的帧
+    bool sendFrame(const FramePtr& frame, bool skipped_before);
+
+    void selectStream(Protocol::StreamCodec codec);
+    void resubscribe(FrameBroadcaster& stream);
+    void switchTier(int tier);
+    void publishStats(uint64_t now_ns);
+
+    Poco::Net::StreamSocket socket_;
+    int fd_;
+    std::string peer_;
+    EventLoop& loop_;
+    CapturePipeline& pipeline_;
+    ClientRegistry& registry_;
+    std::shared_ptr<ClientStats> stats_;  // 本连接在登记表里的槽位
+
+    Protocol::MessageReader reader_;
+    uint8_t version_ = 0;     // 协议版本，0 表示还在等客户端的第一条消息
+    uint32_t features_ = 0;   // v2 HELLO 协商出的 Protocol::Feature
+    uint64_t opened_ns_ = 0;
+    std::vector<Outgoing> out_;  // 发送队列：out_[out_head_] 起是还没写完的消息，清空时保留容量
+    size_t out_head_ = 0;
+    std::vector<PendingCapture> captures_;
+    bool want_write_ = false;
+    uint64_t last_progress_ns_ = 0;  // 发送队列最近一次有进展的时刻
+    bool closed_ = false;
+
+    CongestionController cc_;
+    int tier_ = 0;              // 当前订阅的 MJPEG 档位
+    FrameBroadcaster* stream_;  // 当前订阅的流
+    FrameBroadcaster::Cursor cursor_;
+    Protocol::StreamCodec codec_ = Protocol::StreamCodec::MJPEG;
+    bool need_keyframe_ = false;
+    uint32_t next_message_id_ = 0;
+    uint64_t frame_count_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t last_stats_ns_ = 0;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ========== 本机唤醒消息：传感器程序 -> camera_server ==========
+// 超声波等传感器发现障碍物时，往 camera_server 的 Unix 数据报 socket 发一条消息，
+// 服务端从空闲的低帧率切到满帧率，障碍物离开（或租约过期）后冷却一段时间再回到空闲（见 activity_gate.hpp）。
+// 只依赖 libc，传感器一侧直接包含这个头文件即可，不需要链接 camera_server 的任何库。
+namespace CameraWake {
+
+constexpr const char* DEFAULT_SOCKET = "@camera_server/wake";  // '@' 开头表示抽象命名空间，不落文件
+constexpr uint32_t MAGIC = 0x454B4157;                         // "WAKE"
+constexpr uint16_t VERSION = 1;
+
+enum class Event : uint8_t {
+    Enter = 1,  // 障碍物进入范围：立即切满帧率
+    Hold = 2,   // 障碍物还在：续租（发送方每隔 hold_ms 的一半发一次）
+    Leave = 3,  // 障碍物离开：冷却后回到空闲
+};
+
+struct Message {
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    Event event = Event::Enter;
+    uint8_t source = 0;         // 发送方自定的传感器编号，每个编号各自一份租约
+    uint32_t hold_ms = 0;       // Enter/Hold 的租约：这么久没有续租就当作已经离开
+    float distance_cm = 0;      // 触发时的距离，只用于日志
+    uint64_t timestamp_ns = 0;  // 发送方的 CLOCK_MONOTONIC
+};
+static_assert(sizeof(Message) == 24, "Message 布局是线上格式");
+
+inline socklen_t makeAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    size_t n = std::min(path.size(), sizeof(addr.sun_path) - 1);
+    std::memcpy(addr.sun_path, path.data(), n);
+    if (path[0] == '@') addr.sun_path[0] = '\0';
+    return socklen_t(offsetof(sockaddr_un, sun_path) + n + (path[0] == '@' ? 0 : 1));
+}
+
+// 发送端：非阻塞数据报，服务端没在运行时 send() 返回 false，不影响传感器程序
+class Sender {
+public:
+    explicit Sender(const std::string& socket_path = DEFAULT_SOCKET) {
+        addr_len_ = makeAddress(socket_path, addr_);
+        fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    }
+    ~Sender() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    Sender(const Sender&) = delete;
+    Sender& operator=(const Sender&) = delete;
+
+    bool send(const Message& msg) {
+        if (fd_ < 0) return false;
+        return ::sendto(fd_, &msg, sizeof(msg), MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&addr_), addr_len_) ==
+               ssize_t(sizeof(msg));
+    }
+
+private:
+    int fd_ = -1;
+    sockaddr_un addr_;
+    socklen_t addr_len_ = 0;
+};
+
+}  // namespace CameraWake
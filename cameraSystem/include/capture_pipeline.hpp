@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "capture_ring.hpp"
+#include "capture_source.hpp"
+#include "frame_broadcaster.hpp"
+#include "frame_pool.hpp"
+#include "h264_nal.hpp"
+#include "jpeg_encoder.hpp"
+#include "latency_stats.hpp"
+#include "shm_ring.hpp"
+#include "v4l2_h264_encoder.hpp"
+
+// ========== 采集 -> 编码 -> 广播 ==========
+// 采集源的输出端：
+//   - 编码好的 JPEG（MJPEG 码流）直接发到 MJPEG 广播器；
+//   - 原始帧（libcamera）同时交给两条编码线程：JPEG 线程（后端见 makeJpegEncoder）和 H.264 线程。
+// 每条编码线程只处理最新的一帧：编码跟不上时旧的原始帧直接放手，缓冲区立刻还给相机。
+// H.264 只有一个编码器实例，所有 H.264 观众共用同一路码流；没有观众时不编码。
+// 降级档位（给拥塞的连接用）：档位 0 就是原始 MJPEG 流，档位 1、2 依次降低 JPEG 质量和分辨率，
+// 由第三条编码线程从原始帧（或解码后的 JPEG）生成；同样只在有观众时编码，同档位的观众共用一路。
+// 有本地读者连着共享内存环时，每一帧原始帧和主码流 JPEG 也写一份进环（见 shm_ring.hpp）。
+// 启用抓拍回看环时，主码流的每一帧 JPEG 还拷一份进回看环，抓拍命令可以取触发之前的画面。
+class CapturePipeline : public FrameSink {
+public:
+    static constexpr int TIERS = 3;
+
+    CapturePipeline(FrameBroadcaster& mjpeg, FrameBroadcaster& h264, std::unique_ptr<JpegEncoder> jpeg_encoder,
+                    int quality);
+    ~CapturePipeline() override;
+
+    // 启用 H.264（采集源 start 和 start() 之前调用，传 nullptr 撤掉）；没有调用或采集源不出原始帧时没有 H.264 流
+    void enableH264(std::unique_ptr<V4l2H264Encoder> encoder);
+    bool hasH264() const { return h264_encoder_ != nullptr; }
+
+    // 把原始帧和 JPEG 也发布到共享内存环（start() 之前调用；server 由调用方持有）
+    void setShmServer(ShmRing::Server* server) { shm_ = server; }
+
+    // 启用抓拍回看环（start() 之前调用）：保留最近 seconds 秒、最多 max_bytes 字节的主码流 JPEG
+    void enableCaptureRing(size_t max_bytes, unsigned seconds);
+    // 没有启用时为 nullptr
+    const CaptureRing* captureRing() const { return capture_ring_.get(); }
+
+    // 抽帧：两帧采集时刻至少相隔 interval_ns 才处理（0 表示不抽帧，任意线程可调用）。
+    // 给不能运行中改帧率的采集源用（见 CaptureSource::setFrameRate），被抽掉的帧不编码、不进任何环
+    void setFrameInterval(uint64_t interval_ns) { frame_interval_ns_.store(interval_ns, std::memory_order_relaxed); }
+
+    // 各阶段耗时直方图：流水线记录采集到编码，连接记录排队和发送
+    LatencyStats& latency() { return latency_; }
+
+    // 启用降级档位（start() 之前调用），encoder 只给档位线程使用；不启用时所有档位都是原始流
+    void enableTiers(std::unique_ptr<JpegEncoder> encoder);
+
+    // 某个档位的 MJPEG 广播器（0 即 mjpeg()）
+    FrameBroadcaster& tier(int t);
+    void addTierViewer(int t);
+    void removeTierViewer(int t);
+
+    void start();
+    void stop();
+
+    FrameBroadcaster& mjpeg() { return mjpeg_; }
+    FrameBroadcaster& h264() { return h264_; }
+
+    // H.264 观众加入/离开；加入时请求一个关键帧，让他不用等整个 I 帧周期
+    void addH264Viewer();
+    void removeH264Viewer();
+
+    // 客户端请求关键帧（解码出错、丢帧后）；多个观众同时请求时合并，最多每 250ms 插一个 IDR
+    void requestKeyframe();
+
+    void onEncoded(std::shared_ptr<EncodedFrame> frame) override;
+    void onRaw(RawFrameRef frame) override;
+    // MJPEG 采集源直接用 JPEG 线程的缓冲池（两者不会同时出帧：采集源要么出原始帧要么出 JPEG）
+    FramePool* jpegPool() override { return &jpeg_pool_; }
+
+    // 各缓冲池的命中/未命中计数和回看环的占用，JSON 对象（给 STATS_RESPONSE）
+    std::string poolStatsJson() const;
+
+private:
+    // 一条编码线程：只保留最新的一帧原始帧
+    struct Lane {
+        std::thread thread;
+        RawFrameRef pending;
+        uint64_t dropped = 0;
+    };
+
+    struct TierSpec {
+        int quality;
+        int divisor;  // 分辨率缩小倍数
+    };
+    static const TierSpec kTiers[TIERS];
+
+    void jpegLoop();
+    void h264Loop();
+    void tierLoop();
+    bool wantTiers() const;
+    bool skipFrame(uint64_t capture_ns);
+    void publishShm(const RawFrame& frame);
+    void publishShm(const EncodedFrame& frame);
+    RawFrameRef waitFrame(Lane& lane);
+
+    FrameBroadcaster& mjpeg_;
+    FrameBroadcaster& h264_;
+    std::unique_ptr<JpegEncoder> jpeg_encoder_;  // 只在 JPEG 线程里使用
+    std::unique_ptr<V4l2H264Encoder> h264_encoder_;
+    int quality_;
+    FramePool jpeg_pool_{16, 32, 1 << 20};
+    FramePool h264_pool_{16, 32, 512 << 10};
+    H264::ParamCache params_;  // 只在 H.264 线程里使用
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    Lane jpeg_lane_;
+    Lane h264_lane_;
+
+    std::unique_ptr<JpegEncoder> tier_encoder_;  // 只在档位线程里使用
+    FrameBroadcaster tier_streams_[TIERS - 1];
+    FramePool tier_pool_{16, 32, 512 << 10};
+    Lane tier_lane_;
+    FramePtr tier_pending_jpeg_;  // 只出 JPEG 的采集源：解码后再降级
+    cv::Mat scaled_;
+    std::atomic<int> tier_viewers_[TIERS] = {};
+
+    std::atomic<int> h264_viewers_{0};
+    LatencyStats latency_;
+    ShmRing::Server* shm_ = nullptr;
+    std::unique_ptr<CaptureRing> capture_ring_;
+    bool shm_raw_warned_ = false;  // 只在采集线程里访问
+    std::atomic<uint64_t> frame_interval_ns_{0};
+    uint64_t next_keep_ns_ = 0;    // 只在采集线程里访问
+    std::atomic<int64_t> last_keyframe_request_ns_{0};
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "frame.hpp"
+
+// 抓拍回看环：按采集时间保存最近一段时间的 JPEG，供 CAPTURE_COMMAND 取触发时刻前后的帧。
+// 帧数据拷进一块预先分配的连续内存（按字节封顶），不占用广播用的缓冲池；
+// 写满后从最老的帧开始覆盖，同时按时间跨度和帧数淘汰，稳态下 push() 不分配内存。
+// push() 在采集/编码线程里调用，collect() 在事件循环线程里调用，内部加锁。
+class CaptureRing {
+public:
+    // max_bytes：数据区大小；max_age_ns：最多保留多久（相对最新一帧）；max_frames：索引容量
+    CaptureRing(size_t max_bytes, uint64_t max_age_ns, size_t max_frames = 1024);
+
+    // 存一帧（拷贝）；单帧超过数据区的一半时丢弃
+    void push(const EncodedFrame& frame);
+
+    // 取采集时间在 [from_ns, until_ns] 里的帧（各自拷贝一份，按时间先后）：
+    // interval_ns 不为 0 时相邻两帧至少间隔这么久；max_frames 不为 0 且帧数更多时在窗口里均匀抽取。
+    // 窗口里一帧都没有时退而取 until_ns 之前最近的一帧（窗口为一个时刻时就是"触发那一刻的画面"）
+    std::vector<FramePtr> collect(uint64_t from_ns, uint64_t until_ns, size_t max_frames, uint64_t interval_ns) const;
+
+    struct Stats {
+        size_t frames = 0;
+        size_t bytes = 0;          // 有效帧数据的字节数
+        uint64_t span_ns = 0;      // 最老到最新一帧的时间跨度
+        uint64_t evicted = 0;      // 被覆盖/淘汰的帧
+        uint64_t rejected = 0;     // 太大放不下的帧
+    };
+    Stats stats() const;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t length;
+        uint32_t seq;
+        uint64_t capture_ns;
+        uint64_t framed_ns;
+        uint64_t encoded_ns;
+    };
+
+    const Entry& at(size_t i) const { return entries_[(first_ + i) % entries_.size()]; }
+    void popOldest();
+    FramePtr copyOut(const Entry& e) const;
+
+    mutable std::mutex mutex_;
+    std::vector<uint8_t> data_;
+    std::vector<Entry> entries_;  // 环形索引：从 first_ 起 count_ 个，按时间先后
+    size_t first_ = 0;
+    size_t count_ = 0;
+    size_t write_pos_ = 0;  // 下一帧写入的位置
+    size_t bytes_ = 0;
+    uint64_t max_age_ns_;
+    uint64_t evicted_ = 0;
+    uint64_t rejected_ = 0;
+};
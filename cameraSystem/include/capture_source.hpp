@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "frame.hpp"
+#include "frame_pool.hpp"
+#include "raw_frame.hpp"
+
+// 采集源输出的去向。回调在采集源自己的线程里执行，应尽快返回：
+// 耗时的处理（编码等）交给别的线程，原始帧的 RawFrameRef 也不要久留，否则采集源会缺缓冲而丢帧。
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    // 已经编码好的 JPEG（MJPEG 码流切出来的帧）
+    virtual void onEncoded(std::shared_ptr<EncodedFrame> frame) = 0;
+    // 未编码的原始帧（libcamera 直接采集）
+    virtual void onRaw(RawFrameRef frame) = 0;
+    // 自己切 JPEG 帧的采集源从这个池取帧（sink 要活得比采集源的 stop() 久）；返回 nullptr 时采集源自备缓冲池
+    virtual FramePool* jpegPool() { return nullptr; }
+};
+
+// 可替换的采集源：进程内 libcamera、rpicam-vid 管道、MJPEG 文件回放……
+class CaptureSource {
+public:
+    virtual ~CaptureSource() = default;
+
+    virtual const char* name() const = 0;
+
+    // 是否输出原始帧（onRaw）；只输出 JPEG 的采集源无法提供 H.264
+    virtual bool producesRaw() const { return false; }
+
+    // 开始向 sink 输出帧；打开设备失败时返回 false（不抛异常，调用方可以换别的采集源）
+    virtual bool start(FrameSink& sink) = 0;
+
+    // 停止输出并等待采集线程退出；返回后不会再调用 sink
+    virtual void stop() = 0;
+
+    // 运行中改帧率（start() 之后，任意线程）；不支持时返回 false，调用方可以改用 CapturePipeline::setFrameInterval 抽帧
+    virtual bool setFrameRate(unsigned fps) {
+        (void)fps;
+        return false;
+    }
+};
+
+// 采集参数（各采集源只使用自己认识的部分）
+struct CaptureConfig {
+    unsigned width = 640;
+    unsigned height = 480;
+    unsigned fps = 20;
+    int quality = 80;       // MJPEG 质量（rpicam-vid 管道）
+    bool rotate180 = true;  // 相机倒装，画面旋转 180°
+};
+
+// 按描述创建采集源：
+//   "libcamera"      进程内 libcamera，原始帧零拷贝
+//   "rpicam"         popen(rpicam-vid) 输出的 MJPEG 管道
+//   "file:<path>"    回放 MJPEG 文件（按 fps 限速，到结尾从头循环）
+//   "pipe:<path>"    读取 MJPEG 管道/FIFO（"pipe:-" 为标准输入），不限速
+// 描述不认识时返回 nullptr
+std::unique_ptr<CaptureSource> makeCaptureSource(const std::string& spec, const CaptureConfig& config);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "congestion.hpp"
+
+// 一个客户端连接的统计，由连接线程更新，STATS_REQUEST 时被别的线程读取
+struct ClientStats {
+    std::string peer;
+    std::string codec = "mjpeg";
+    CongestionController::Stats cc;
+    uint64_t bytes = 0;
+    uint64_t broadcaster_dropped = 0;  // 连接线程来不及取、被广播器跳过的帧
+};
+
+// 所有在线客户端的统计
+class ClientRegistry {
+public:
+    // 连接建立时登记，返回的槽位由连接独占写入
+    std::shared_ptr<ClientStats> add(const std::string& peer);
+    void remove(const std::shared_ptr<ClientStats>& stats);
+
+    // 更新一个客户端的统计（连接线程调用）
+    void update(const std::shared_ptr<ClientStats>& slot, const ClientStats& value);
+
+    // 所有客户端的统计，JSON 数组
+    std::string toJson() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<ClientStats>> clients_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 从内核读出的一条 TCP 发送端状态
+struct TcpSample {
+    uint32_t outq_bytes = 0;     // 发送队列里还没被确认的字节（SIOCOUTQ）
+    uint32_t rtt_us = 0;         // 平滑 RTT（TCP_INFO tcpi_rtt）
+    uint64_t delivery_rate = 0;  // 内核估计的交付速率（字节/秒，老内核为 0）
+};
+
+// 读取 socket 的发送队列深度和 RTT；失败返回 false
+bool probeTcp(int fd, TcpSample& sample);
+
+// 每个连接一个的拥塞控制器。
+// 目标是让"采集 -> 客户端收到"的延迟不超过 target_latency_ms：
+//   - 帧级：估计这一帧如果现在发出去、排在发送队列后面到达客户端时有多老，超过目标就跳过
+//     （等于按带宽自动降帧率）；发送队列空时总是发送，保证再慢的链路也有画面；
+//   - 档位级：每个统计窗口看跳帧比例和延迟，持续拥塞就降一档（更低质量/分辨率），
+//     连续几个窗口都很宽裕再升一档，带滞回，避免来回抖动。
+class CongestionController {
+public:
+    struct Config {
+        double target_latency_ms = 250;
+        int tiers = 3;         // 档位数，0 为最高质量
+        double window_s = 1.0; // 档位调整的统计窗口
+    };
+
+    // 一个统计窗口的结果（导出给客户端统计）
+    struct Stats {
+        int tier = 0;
+        double rate_bps = 0;     // 估计的可用带宽（字节/秒）
+        double queue_ms = 0;     // 发送队列排空需要的时间
+        double latency_ms = 0;   // 估计的端到端延迟（平滑）
+        double skip_ratio = 0;   // 最近一个窗口的跳帧比例
+        uint32_t rtt_us = 0;
+        uint32_t outq_bytes = 0;
+        uint64_t sent = 0;
+        uint64_t skipped = 0;
+    };
+
+    CongestionController();
+    explicit CongestionController(const Config& config);
+
+    // 每帧发送前调用，返回是否发送这一帧；capture_ns / now_ns 都是 CLOCK_MONOTONIC
+    bool shouldSend(const TcpSample& sample, size_t frame_bytes, uint64_t capture_ns, uint64_t now_ns);
+
+    // 每次 write/sendmsg 成功后调用，bytes 是这次交给内核的全部字节（帧、HELLO、统计、抓拍……都算：
+    // SIOCOUTQ 统计的是整个发送队列，只算帧字节会让"已确认字节"倒退）
+    void onWritten(size_t bytes) { bytes_sent_ += bytes; }
+
+    // 一帧完整交给内核后调用（只计数）
+    void onSent() { stats_.sent++; }
+
+    int tier() const { return stats_.tier; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    void updateRate(const TcpSample& sample, uint64_t now_ns);
+    void endWindow();
+
+    Config config_;
+    Stats stats_;
+
+    uint64_t bytes_sent_ = 0;     // 交给内核的累计字节（所有消息）
+    uint64_t last_acked_ = 0;     // 上次采样时已确认的累计字节
+    uint64_t last_sample_ns_ = 0;
+    double own_rate_ = 0;         // 自己按确认字节估算的速率（内核不提供 delivery_rate 时用）
+
+    uint64_t window_start_ns_ = 0;
+    uint32_t window_sent_ = 0;
+    uint32_t window_skipped_ = 0;
+    int good_windows_ = 0;
+};
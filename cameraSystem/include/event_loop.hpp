@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+// 单线程 epoll 事件循环（水平触发）。
+// add/modify/remove 只能在循环线程里（或 run() 之前）调用；wake()/stop() 可以在任何线程调用。
+class EventLoop {
+public:
+    using Handler = std::function<void(uint32_t events)>;  // events 为 EPOLLIN/EPOLLOUT/...
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool valid() const { return epfd_ >= 0 && wakefd_ >= 0; }
+
+    bool add(int fd, uint32_t events, Handler handler);
+    bool modify(int fd, uint32_t events);
+    // 移除后同一轮里已经取到的该 fd 的事件也不会再分发
+    void remove(int fd);
+
+    // 唤醒 run()，随后在循环线程里调用 on_wake（多次 wake 可能合并成一次）
+    void wake();
+
+    // 运行到 stop()：被 wake() 唤醒时调用 on_wake，每隔约 tick_ms 调用一次 on_tick
+    void run(int tick_ms, const std::function<void()>& on_wake, const std::function<void()>& on_tick);
+    void stop();
+
+private:
+    struct Entry {
+        uint32_t gen;  // 区分同一个 fd 号先后注册的两个对象
+        std::shared_ptr<Handler> handler;
+    };
+
+    int epfd_ = -1;
+    int wakefd_ = -1;
+    std::unordered_map<int, Entry> handlers_;
+    uint32_t next_gen_ = 1;  // 0 留给 wakefd_
+    std::atomic<bool> running_{false};
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core.hpp>
+
+enum class FrameCodec : uint8_t {
+    Jpeg,  // 一帧完整的 JPEG
+    H264,  // 一个 H.264 访问单元（Annex-B，带起始码）；关键帧总是带着 SPS/PPS
+};
+
+// 一帧编码好的图像。
+// 由采集线程创建后只读，通过 shared_ptr 在所有连接之间共享（引用计数），不再按客户端各拷贝一份。
+struct EncodedFrame {
+    uint32_t seq = 0;          // 帧序号（采集端递增）
+    uint64_t capture_ns = 0;   // 采集到的时刻（CLOCK_MONOTONIC，纳秒）
+    // 之后各阶段完成的时刻（同一时钟，0 表示没经过这一步），见 LatencyStats
+    uint64_t framed_ns = 0;    // 整帧可用
+    uint64_t decoded_ns = 0;   // 解码完成
+    uint64_t encoded_ns = 0;   // 编码完成（直接转发的 MJPEG 等于 framed_ns）
+    FrameCodec codec = FrameCodec::Jpeg;
+    bool keyframe = true;      // JPEG 帧都是；H.264 只有 IDR 是，新观众要从关键帧开始
+    std::vector<uint8_t> data; // 编码后的原始字节（未经解码/重编码）
+
+    // 只有真正需要像素时才解码（仅 JPEG）（比如带处理的抓拍、视觉算法）；
+    // 第一次调用时解码并缓存，之后的调用共享同一个 Mat。
+    // 像素缓冲跟着帧一起被缓冲池复用：帧回收后内容会被下一次解码覆盖，要长期保留请 clone()
+    cv::Mat decode() const;
+
+    // 帧对象被缓冲池回收复用前调用：清空内容，但保留 data 的容量和解码用的像素缓冲
+    void reset();
+
+private:
+    mutable std::mutex decode_mutex_;
+    mutable bool decoded_valid_ = false;
+    mutable cv::Mat decoded_;
+};
+
+using FramePtr = std::shared_ptr<const EncodedFrame>;
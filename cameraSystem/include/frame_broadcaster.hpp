@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "frame.hpp"
+
+// 单生产者、多消费者的帧广播器。
+// 采集线程 publish() 把帧放进按序号编号的环形缓冲；每个连接持有自己的 Cursor 独立读取，
+// 互不抢帧。消费者落后太多时直接跳到最新帧并累计丢帧数；生产者从不等待消费者，
+// 慢客户端只会丢自己的帧，不影响采集和其它客户端。帧本身是只读共享的，不会为每个客户端重复编码或拷贝。
+class FrameBroadcaster {
+public:
+    // 每个消费者自己的读位置和统计
+    struct Cursor {
+        uint64_t next_seq = 0;   // 下一帧期望的广播序号
+        uint64_t delivered = 0;  // 已取到的帧数
+        uint64_t dropped = 0;    // 因为落后被跳过的帧数
+    };
+
+    // capacity：环形缓冲保留的帧数；max_lag：消费者最多落后几帧，超过就跳到最新帧
+    explicit FrameBroadcaster(size_t capacity = 8, size_t max_lag = 2);
+
+    // 生产者发布一帧（只持锁交换一个 shared_ptr）
+    void publish(FramePtr frame);
+
+    // 等待 cursor 之后的下一帧；超时或已 close() 返回 nullptr
+    FramePtr next(Cursor& cursor, std::chrono::milliseconds timeout);
+
+    // 不等待：cursor 之后已经有帧就取出，否则返回 nullptr（事件循环里使用）
+    FramePtr tryNext(Cursor& cursor);
+
+    // 每次 publish() 之后调用的通知（在生产者线程里执行，应尽快返回，比如写一个 eventfd）。
+    // 任意时刻都可以注册（采集已经在 publish 也行）：列表写时复制，publish 在锁里取一份快照，锁外逐个调用
+    void addListener(std::function<void()> listener);
+
+    // 新消费者从当前最新帧之后开始读
+    Cursor subscribe() const;
+
+    // 最近发布的一帧（没有则返回 nullptr）
+    FramePtr latest() const;
+
+    uint64_t published() const;
+
+    // 唤醒所有等待中的消费者（服务停止时调用）
+    void close();
+
+private:
+    FramePtr take(Cursor& cursor);  // 调用方持锁，且 seq_ > cursor.next_seq
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<FramePtr> slots_;
+    uint64_t seq_ = 0;   // 已发布的帧数，也是下一帧的广播序号
+    size_t max_lag_;
+    bool closed_ = false;
+    using Listeners = std::vector<std::function<void()>>;
+    std::shared_ptr<const Listeners> listeners_;  // 持锁读写指针；指向的列表创建后不再修改
+};
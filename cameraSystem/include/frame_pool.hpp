@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "frame.hpp"
+
+// 可复用的帧缓冲池。
+// 池子一直持有每个 EncodedFrame 的一个 shared_ptr；use_count() == 1 说明其它地方（广播器、连接）都已放手，
+// 这个帧就可以重新交给采集端填充。复用时不重新分配数据缓冲，也不新建 shared_ptr 控制块，
+// 稳态下每帧零次堆分配。
+class FramePool {
+public:
+    // initial：预先创建的帧数；max_frames：最多帧数（消费者全部占着时最多扩容到这里）；
+    // frame_bytes：每帧数据缓冲预留的容量
+    FramePool(size_t initial, size_t max_frames, size_t frame_bytes);
+
+    // 取一个空闲帧（已 reset）；池子用尽且不能扩容时返回 nullptr，调用方应丢弃这一帧
+    std::shared_ptr<EncodedFrame> acquire();
+
+    size_t frameBytes() const { return frame_bytes_; }
+
+    // 命中/未命中计数（任意线程可读）：稳态下应该只有 hits 在涨
+    struct Stats {
+        uint64_t hits = 0;       // 复用了空闲帧
+        uint64_t misses = 0;     // 没有空闲帧，新建了一帧（堆分配）
+        uint64_t exhausted = 0;  // 已到上限，调用方只能丢帧
+        size_t frames = 0;       // 当前帧数
+    };
+    Stats stats() const;
+
+private:
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<EncodedFrame>> frames_;
+    size_t next_ = 0;     // 轮询起点，最久没用的帧最可能已空闲
+    size_t max_frames_;
+    size_t frame_bytes_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> exhausted_{0};
+    std::atomic<size_t> size_{0};
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// H.264 Annex-B 码流的 NAL 单元工具。
+namespace H264 {
+
+enum NalType : uint8_t {
+    NAL_SLICE = 1,  // 非 IDR 图像
+    NAL_IDR = 5,    // IDR 图像（关键帧）
+    NAL_SEI = 6,
+    NAL_SPS = 7,
+    NAL_PPS = 8,
+    NAL_AUD = 9,
+};
+
+// 一个 NAL 单元：start 指向起始码，payload 指向 NAL 头（起始码之后）
+struct Nal {
+    const uint8_t* start;
+    const uint8_t* payload;
+    size_t size;  // 从 start 到下一个起始码（或末尾）的长度，包含起始码
+    uint8_t type() const { return payload[0] & 0x1F; }
+};
+
+// 依次回调每个 NAL 单元（3 字节或 4 字节起始码都认）；码流开头的非起始码字节被忽略
+template <typename F>
+void forEachNal(const uint8_t* data, size_t len, F&& cb) {
+    auto findStart = [&](size_t from, size_t& sc_len) -> size_t {
+        for (size_t i = from; i + 3 <= len; ++i) {
+            if (data[i] == 0 && data[i + 1] == 0) {
+                if (data[i + 2] == 1) {
+                    sc_len = 3;
+                    return i;
+                }
+                if (data[i + 2] == 0 && i + 4 <= len && data[i + 3] == 1) {
+                    sc_len = 4;
+                    return i;
+                }
+            }
+        }
+        return len;
+    };
+    size_t sc = 0;
+    size_t pos = findStart(0, sc);
+    while (pos < len) {
+        size_t next_sc = 0;
+        size_t next = findStart(pos + sc, next_sc);
+        if (pos + sc < next) cb(Nal{data + pos, data + pos + sc, next - pos});
+        pos = next;
+        sc = next_sc;
+    }
+}
+
+// 访问单元里有没有图像数据（编码器可能先单独吐出参数集）
+bool containsPicture(const uint8_t* data, size_t len);
+
+// 是否包含 IDR 图像
+bool isKeyframe(const uint8_t* data, size_t len);
+
+// 缓存最近的 SPS/PPS。编码器只在第一个关键帧前输出参数集时，
+// 后来的关键帧靠它补上参数集，新观众从任意一个 IDR 开始都能解码。
+class ParamCache {
+public:
+    // 从一个访问单元里提取 SPS/PPS（有就更新）
+    void update(const uint8_t* data, size_t len);
+
+    bool ready() const { return !sps_.empty() && !pps_.empty(); }
+
+    // 关键帧缺参数集时把缓存的 SPS/PPS 插到最前面
+    void completeKeyframe(std::vector<uint8_t>& au) const;
+
+private:
+    std::vector<uint8_t> sps_;
+    std::vector<uint8_t> pps_;
+};
+
+}  // namespace H264
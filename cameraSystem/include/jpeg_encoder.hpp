@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "raw_frame.hpp"
+
+// 原始帧 -> JPEG 的编码器。
+// 实现可以是硬件（V4L2 M2M）也可以是软件（libjpeg-turbo、OpenCV）；实例内部会缓存句柄和缓冲区，
+// 同一个实例只能在一个线程里使用。
+class JpegEncoder {
+public:
+    virtual ~JpegEncoder() = default;
+
+    virtual const char* name() const = 0;
+
+    // 把 frame 编码成 JPEG 写进 out（覆盖原内容，尽量复用 out 已有的容量）；失败返回 false
+    virtual bool encode(const RawFrame& frame, int quality, std::vector<uint8_t>& out) = 0;
+};
+
+// 按名字创建编码器：
+//   "v4l2"       V4L2 M2M 硬件编码（树莓派 bcm2835-codec，/dev/video31）
+//   "turbojpeg"  libjpeg-turbo（编译时找到 libturbojpeg 才有）
+//   "opencv"     cv::imencode
+//   "auto"       依次尝试 v4l2、turbojpeg、opencv，用第一个可用的
+// 不认识的名字或后端不可用时返回 nullptr
+std::unique_ptr<JpegEncoder> makeJpegEncoder(const std::string& backend);
+
+// 当前环境可用的后端名字（压测工具用）
+std::vector<std::string> availableJpegEncoders();
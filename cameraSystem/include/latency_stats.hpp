@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 无锁的对数-线性直方图（HDR 风格），单位微秒：
+// 按 2 的幂分段，每段再等分 16 个桶，相对误差不超过 1/16；能记录到约 70 分钟。
+// record() 只有几次 relaxed 原子操作，任意线程都可以并发调用；读取不阻塞写入，得到的是近似快照。
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int MAX_EXP = 31;  // 最大 2^32 微秒
+    static constexpr int BUCKETS = (MAX_EXP - SUB_BITS + 2) * SUB;
+
+    void record(uint64_t us) {
+        counts_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (us > max && !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    struct Summary {
+        uint64_t count = 0;
+        double mean_us = 0;
+        uint64_t p50_us = 0;
+        uint64_t p90_us = 0;
+        uint64_t p99_us = 0;
+        uint64_t max_us = 0;
+    };
+    Summary summary() const;
+
+    static int bucketOf(uint64_t us);
+    static uint64_t bucketLow(int index);   // 桶的下界
+    static uint64_t bucketHigh(int index);  // 桶的上界（不含）
+
+private:
+    std::atomic<uint64_t> counts_[BUCKETS] = {};
+    std::atomic<uint64_t> total_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// 采集链路各阶段的耗时分布（用来看端到端 150~300 ms 延迟花在哪一段）。
+// 时间点都是 CLOCK_MONOTONIC 纳秒，依次为：
+//   capture  曝光（libcamera 传感器时间戳）或 MJPEG 第一个字节到达
+//   framed   整帧可用：libcamera 请求完成 / MJPEG 切帧完成
+//   decoded  解码完成（只有从 JPEG 生成降级档位时才有）
+//   encoded  编码完成（直接转发的 MJPEG 等于 framed）
+//   queued   某个连接从广播器取到这一帧、排进发送队列
+//   sent     这一帧的最后一个字节写进内核
+class LatencyStats {
+public:
+    enum Stage {
+        Framing,     // capture -> framed
+        Decode,      // framed -> decoded
+        EncodeJpeg,  // framed/decoded -> encoded
+        EncodeH264,
+        Queue,       // encoded -> queued（在广播器里等连接来取）
+        Send,        // queued -> sent
+        Total,       // capture -> sent
+        STAGE_COUNT
+    };
+
+    // 记录 from_ns -> to_ns 的耗时；任一时间点缺失（0）或顺序颠倒时不记
+    void record(Stage stage, uint64_t from_ns, uint64_t to_ns) {
+        if (from_ns == 0 || to_ns < from_ns) return;
+        stages_[stage].record((to_ns - from_ns) / 1000);
+    }
+
+    const LatencyHistogram& histogram(Stage stage) const { return stages_[stage]; }
+
+    static const char* stageName(Stage stage);
+
+    // {"framing":{"count":..,"mean_ms":..,"p50_ms":..,"p90_ms":..,"p99_ms":..,"max_ms":..},...}
+    std::string toJson() const;
+
+private:
+    LatencyHistogram stages_[STAGE_COUNT];
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <libcamera/libcamera.h>
+#include "capture_source.hpp"
+
+// 进程内 libcamera 采集源，替代 popen(rpicam-vid) + 管道：
+//   - 每个 FrameBuffer 配一个固定的 Request，启动时一次性建好，之后只 reuse() + 重新排队，不再分配；
+//   - dmabuf 平面在启动时 mmap 一次，完成的帧以 RawFrameRef 直接指向映射区交给 sink，不拷贝像素；
+//   - 最后一个引用释放时才把 Request 还给相机，所以消费者拿着帧期间缓冲区不会被覆盖。
+// 消费者占着全部缓冲区时相机会暂停出帧（驱动侧丢帧），不会覆盖正在使用的数据。
+// 旋转 180° 通过 CameraConfiguration::orientation 交给 ISP 完成。
+class LibcameraSource : public CaptureSource, public RawFrameOwner {
+public:
+    explicit LibcameraSource(const CaptureConfig& config);
+    ~LibcameraSource() override;
+
+    const char* name() const override { return "libcamera"; }
+    bool producesRaw() const override { return true; }
+    bool start(FrameSink& sink) override;
+    void stop() override;
+    // 通过下一个排队的 Request 的 FrameDurationLimits 生效（相机队列里已有的几帧仍是旧帧率）
+    bool setFrameRate(unsigned fps) override;
+
+    void recycle(RawFrame* frame) override;
+
+private:
+    struct Slot {
+        std::unique_ptr<libcamera::Request> request;
+        libcamera::FrameBuffer* buffer = nullptr;
+        RawFrame frame;
+    };
+
+    bool setup();
+    bool mapBuffers();
+    void teardown();
+    void requestComplete(libcamera::Request* request);
+    void requeue(libcamera::Request* request);
+
+    CaptureConfig config_;
+    FrameSink* sink_ = nullptr;
+    std::atomic<bool> running_{false};
+    std::atomic<int64_t> pending_frame_us_{0};  // 待下发的帧间隔，0 表示没有变化
+
+    std::unique_ptr<libcamera::CameraManager> manager_;
+    std::shared_ptr<libcamera::Camera> camera_;
+    std::unique_ptr<libcamera::CameraConfiguration> camera_config_;
+    std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
+    libcamera::Stream* stream_ = nullptr;
+    bool acquired_ = false;
+    bool started_ = false;
+
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::vector<std::pair<void*, size_t>> mappings_;
+
+    // 消费者还持有的帧数，stop() 等它归零后才释放缓冲区
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    int outstanding_ = 0;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <iostream>
+
+// ========== 工具：安全日志辅助 ==========
+#define LOG_I(msg) std::cout << "[INFO] " << msg << std::endl
+#define LOG_W(msg) std::cerr << "[WARN] " << msg << std::endl
+#define LOG_E(msg) std::cerr << "[ERR ] " << msg << std::endl
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "frame.hpp"
+#include "frame_pool.hpp"
+
+// 流式 MJPEG 切帧器。
+// 输入是任意切分的字节流（管道 read() 的结果），按 JPEG 语法逐段解析：
+//   - 带长度的段（APPn、DQT、DHT、SOF、SOS 头……）整段跳过，所以 EXIF 缩略图里的 FFD8/FFD9 不会被误判；
+//   - 熵编码数据里用 memchr 找 0xFF，FF00（填充字节）、FFD0~FFD7（RST）、FFFF（填充）不是帧边界；
+//   - 只有段结构之外的 FFD9 才是 EOI。
+// 扫描状态跨 feed() 保存，每个字节只看一次；帧数据直接追加进缓冲池里的帧（预留容量，不扩容），
+// 没有整帧拷贝、没有从缓冲区头部 erase。
+class MjpegFramer {
+public:
+    using FrameCallback = std::function<void(std::shared_ptr<EncodedFrame>)>;
+
+    struct Stats {
+        uint64_t frames = 0;          // 完整输出的帧数
+        uint64_t skipped_bytes = 0;   // 帧之外被丢弃的字节（找 SOI 时跳过的）
+        uint64_t oversize_drops = 0;  // 超过单帧容量被丢弃的帧
+        uint64_t pool_drops = 0;      // 缓冲池没有空闲帧而被丢弃的帧
+    };
+
+    // on_frame 在 feed() 所在线程里被调用
+    MjpegFramer(FramePool& pool, FrameCallback on_frame);
+
+    // 喂入一段数据；可能输出 0 到多帧
+    void feed(const uint8_t* data, size_t len);
+
+    // 丢弃当前未完成的帧，回到找 SOI 的状态（数据源重启时调用）
+    void reset();
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    enum class State : uint8_t {
+        SeekSoiFF,    // 帧外：找 0xFF
+        SeekSoiD8,    // 帧外：上一个字节是 0xFF，看是不是 D8
+        MarkerFF,     // 段结构里：期待 0xFF
+        MarkerCode,   // 段结构里：读标记码
+        LengthHi,     // 段长度高字节
+        LengthLo,     // 段长度低字节
+        SkipSegment,  // 跳过段内容
+        Entropy,      // 熵编码数据
+        EntropyFF,    // 熵编码数据里遇到 0xFF
+    };
+
+    void beginFrame();
+    void append(const uint8_t* p, size_t n);
+    void finishFrame();
+    void dropFrame();
+
+    FramePool& pool_;
+    FrameCallback on_frame_;
+    std::shared_ptr<EncodedFrame> current_;
+    State state_ = State::SeekSoiFF;
+    bool after_sos_ = false;  // 当前段是 SOS，段结束后进入熵编码数据
+    bool discarding_ = false; // 当前帧已放弃（超长或没有缓冲），只解析不保存
+    uint32_t seg_remaining_ = 0;
+    uint16_t seg_len_ = 0;
+    uint32_t next_seq_ = 0;
+    Stats stats_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include "capture_source.hpp"
+#include "frame_pool.hpp"
+#include "mjpeg_framer.hpp"
+
+// 从字节流里切 MJPEG 帧的采集源，三种输入：
+//   Command：popen 一条命令（rpicam-vid）读它的 stdout，进程退出后自动重启；
+//   File：   回放 MJPEG 文件，按 fps 限速，读到结尾从头循环（没有相机时调试、压测用）；
+//   Pipe：   读管道/FIFO（"-" 为标准输入），不限速，写端关闭后重新打开。
+// 读取用 poll + read 直接读文件描述符，stop() 最多等一个 poll 周期。
+class MjpegStreamSource : public CaptureSource {
+public:
+    enum class Mode { Command, File, Pipe };
+
+    MjpegStreamSource(Mode mode, std::string target, unsigned fps = 0);
+    ~MjpegStreamSource() override;
+
+    const char* name() const override;
+    bool start(FrameSink& sink) override;
+    void stop() override;
+    // 只有文件回放能改（改的是限速）；命令和管道的出帧节奏由上游决定
+    bool setFrameRate(unsigned fps) override;
+
+private:
+    void run();
+    bool open();
+    void close();
+    void onFrame(std::shared_ptr<EncodedFrame> frame);
+
+    Mode mode_;
+    std::string target_;
+    std::atomic<unsigned> fps_;
+    FrameSink* sink_ = nullptr;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+
+    FILE* proc_ = nullptr;  // Command 模式的子进程
+    int fd_ = -1;
+
+    // 优先用 sink 的 JPEG 缓冲池（同一批帧给广播环、连接和共享内存环轮流用）；
+    // sink 不提供时自备：广播环 8 帧 + 每个连接正在发送的 1 帧，16 帧起步、最多 32 帧；单帧上限 1MB
+    std::unique_ptr<FramePool> own_pool_;
+    std::unique_ptr<MjpegFramer> framer_;
+    uint64_t frames_ = 0;
+    std::chrono::steady_clock::time_point next_due_;
+};
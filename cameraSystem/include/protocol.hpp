@@ -1,24 +1,51 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 #include <string>
 #include <arpa/inet.h>  // 用于 htonl/ntohl
+#include <endian.h>     // 用于 htobe64/be64toh
 
 #pragma pack(push, 1)  //强制 1 字节对齐
 
-// 通信协议定义
+// 通信协议定义。
+// v1：13 字节紧凑消息头（MessageHeader），老客户端一直在用，继续支持；
+// v2：32 字节对齐消息头（MessageHeaderV2），带魔数/版本、纳秒级采集时间戳、标志位和 CRC，连接建立后先交换 HELLO。
+// 服务端看客户端发来的第一条消息的开头是不是 v2 魔数来区分版本；客户端一直不发消息就按 v1 处理。
+// HELLO 在等待时间（300ms）之后才到时，服务端已经按 v1 推了几帧，收到 v2 魔数后在消息边界切到 v2：
+// v2 客户端应跳过 HELLO 回复之前的字节，按魔数 + header_crc 找到第一个 v2 消息头。
 namespace Protocol {
     // 消息类型
     enum class MessageType : uint8_t {
         UNKNOWN = 0x00,
         VIDEO_FRAME = 0x01,    // 视频帧数据
-        CAPTURE_COMMAND = 0x02, // 拍照命令
+        CAPTURE_COMMAND = 0x02, // 拍照命令：无负载时回复最近一帧（CAPTURE_RESPONSE）；
+                                //   带 CaptureRequest 时按时间窗口回复一组 CAPTURE_BATCH
         CAPTURE_RESPONSE = 0x03, // 拍照响应
-        HEARTBEAT = 0x04       // 心跳包
+        HEARTBEAT = 0x04,      // 心跳包
+        VIDEO_FRAME_H264 = 0x05, // H.264 视频帧：一个访问单元，Annex-B 格式（00 00 00 01 起始码分隔的 NAL 单元）
+        STREAM_SELECT = 0x06,  // 选择视频流：客户端发送请求，服务端回复实际使用的流（负载 StreamSelect）
+        KEYFRAME_REQUEST = 0x07, // 客户端请求尽快发一个 H.264 关键帧（无负载）
+        STATS_REQUEST = 0x08,  // 查询所有连接的传输统计（无负载）
+        STATS_RESPONSE = 0x09, // 统计结果：UTF-8 JSON 对象 {"clients":[每个连接的档位、码率、RTT、跳帧数……],
+                               //                         "latency":{各阶段耗时分布，见 LatencyStats}}
+        HELLO = 0x0A,          // v2 握手：客户端发送自己支持的范围，服务端回复协商结果（负载 Hello，仅 v2）
+        CAPTURE_BATCH = 0x0B   // 窗口抓拍的一张图：负载 CaptureBatchItem + JPEG，同一次抓拍的各张按时间先后连续发送
     };
 
-    // 消息头
+    // 视频流编码。连接建立后默认 MJPEG（VIDEO_FRAME），发送 STREAM_SELECT 切换到 H.264（VIDEO_FRAME_H264）；
+    // 切换后第一帧一定是带 SPS/PPS 的关键帧，可以直接开始解码
+    enum class StreamCodec : uint8_t {
+        MJPEG = 0,
+        H264 = 1
+    };
+
+    struct StreamSelect {
+        StreamCodec codec;
+    };
+
+    // v1 消息头
     struct MessageHeader {
         MessageHeader() : message_id(0), type(MessageType::UNKNOWN), payload_length(0), timestamp(0) {}
         
@@ -60,9 +87,221 @@ namespace Protocol {
         }
     };
 
-    // 序列化工具
-    std::vector<uint8_t> serializeHeader(const MessageHeader& header);
-    bool parseHeader(const std::vector<uint8_t>& data, MessageHeader& header);
 }
 
-#pragma pack(pop)  // 恢复对齐
\ No newline at end of file
+#pragma pack(pop)  // 恢复对齐
+
+namespace Protocol {
+    constexpr uint8_t VERSION_1 = 1;
+    constexpr uint8_t VERSION_2 = 2;
+    constexpr uint32_t MAGIC_V2 = 0x434D5632;  // "CMV2"
+
+    // v2 消息头标志位
+    enum HeaderFlags : uint16_t {
+        FLAG_KEYFRAME = 1 << 0,     // H.264 关键帧（带 SPS/PPS，可以从这里开始解码）
+        FLAG_PAYLOAD_CRC = 1 << 1,  // payload_crc 有效
+        FLAG_TIMING = 1 << 2        // 视频帧负载以 FrameTiming 开头，后面才是码流
+    };
+
+    // HELLO 里协商的可选功能
+    enum Feature : uint32_t {
+        FEATURE_PAYLOAD_CRC = 1u << 0,  // 服务端给每条消息的负载算 CRC
+        FEATURE_STATS = 1u << 1,        // 支持 STATS_REQUEST
+        FEATURE_ADAPTIVE = 1u << 2,     // 服务端按链路状况跳帧/降档
+        FEATURE_TIMING = 1u << 3        // 视频帧带 FrameTiming（各阶段时间戳）
+    };
+
+    // HELLO 里的编码位图
+    constexpr uint32_t codecBit(StreamCodec codec) { return 1u << uint8_t(codec); }
+
+    // v2 消息头：32 字节，每个字段都按自身大小对齐；线上为网络字节序，用 writeHeader/parseHeader 读写
+    struct MessageHeaderV2 {
+        uint32_t magic;           // MAGIC_V2
+        uint8_t version;          // VERSION_2
+        MessageType type;
+        uint16_t flags;           // HeaderFlags
+        uint32_t message_id;
+        uint32_t payload_length;
+        uint64_t timestamp_ns;    // 视频帧为采集时刻，其它消息为发送时刻（CLOCK_MONOTONIC，纳秒）
+        uint32_t payload_crc;     // 负载的 CRC-32（flags 含 FLAG_PAYLOAD_CRC 时有效）
+        uint32_t header_crc;      // 前 28 字节的 CRC-32
+    };
+    static_assert(sizeof(MessageHeaderV2) == 32, "v2 header must stay 32 bytes");
+    static_assert(offsetof(MessageHeaderV2, timestamp_ns) % 8 == 0, "v2 header fields must be aligned");
+
+    // HELLO 负载：客户端发自己支持的范围，服务端回复协商结果（version 为选定版本，codecs/features 为双方都支持的）
+    struct Hello {
+        uint8_t min_version;
+        uint8_t max_version;
+        uint16_t reserved;
+        uint32_t codecs;    // codecBit() 位图
+        uint32_t features;  // Feature 位图
+
+        void toNetworkOrder() {
+            codecs = htonl(codecs);
+            features = htonl(features);
+        }
+
+        void toHostOrder() {
+            codecs = ntohl(codecs);
+            features = ntohl(features);
+        }
+    };
+    static_assert(sizeof(Hello) == 12, "");
+
+    // 窗口抓拍请求（CAPTURE_COMMAND 的负载，两个版本通用）：取触发时刻（服务端收到命令的时刻）前 pre_ms
+    // 到后 post_ms 之间的帧，等窗口结束后一起回复。前面的帧来自服务端的回看环，最多能往前取几秒
+    struct CaptureRequest {
+        uint32_t pre_ms;       // 触发前
+        uint32_t post_ms;      // 触发后（服务端最多等 MAX_CAPTURE_POST_MS）
+        uint16_t max_frames;   // 最多几张，0 表示窗口里全部（服务端上限 MAX_CAPTURE_FRAMES）；多了在窗口里均匀抽取
+        uint16_t interval_ms;  // 相邻两张至少间隔多久，0 表示逐帧
+
+        void toNetworkOrder() {
+            pre_ms = htonl(pre_ms);
+            post_ms = htonl(post_ms);
+            max_frames = htons(max_frames);
+            interval_ms = htons(interval_ms);
+        }
+
+        void toHostOrder() {
+            pre_ms = ntohl(pre_ms);
+            post_ms = ntohl(post_ms);
+            max_frames = ntohs(max_frames);
+            interval_ms = ntohs(interval_ms);
+        }
+    };
+    static_assert(sizeof(CaptureRequest) == 12, "");
+
+    constexpr uint32_t MAX_CAPTURE_POST_MS = 10000;
+    constexpr uint16_t MAX_CAPTURE_FRAMES = 200;
+
+    // CAPTURE_BATCH 负载头，后面紧跟 JPEG 数据。窗口里一张都没有时只发一条 count 为 0、image_size 为 0 的消息
+    struct CaptureBatchItem {
+        uint32_t capture_id;   // CAPTURE_COMMAND 的 message_id
+        uint16_t index;        // 第几张（从 0 开始）
+        uint16_t count;        // 这次抓拍一共几张
+        uint64_t capture_ns;   // 这一张的采集时刻（CLOCK_MONOTONIC，纳秒）
+        int32_t offset_us;     // 相对触发时刻的偏移，负数为触发之前
+        uint32_t image_size;
+
+        void toNetworkOrder() {
+            capture_id = htonl(capture_id);
+            index = htons(index);
+            count = htons(count);
+            capture_ns = htobe64(capture_ns);
+            offset_us = int32_t(htonl(uint32_t(offset_us)));
+            image_size = htonl(image_size);
+        }
+
+        void toHostOrder() {
+            capture_id = ntohl(capture_id);
+            index = ntohs(index);
+            count = ntohs(count);
+            capture_ns = be64toh(capture_ns);
+            offset_us = int32_t(ntohl(uint32_t(offset_us)));
+            image_size = ntohl(image_size);
+        }
+    };
+    static_assert(sizeof(CaptureBatchItem) == 24, "");
+
+    // v2 拍照响应：后面紧跟 JPEG 数据（不再带固定 256 字节的文件名）
+    struct CaptureResponseV2 {
+        uint32_t capture_id;
+        uint32_t image_size;
+
+        void toNetworkOrder() {
+            capture_id = htonl(capture_id);
+            image_size = htonl(image_size);
+        }
+
+        void toHostOrder() {
+            capture_id = ntohl(capture_id);
+            image_size = ntohl(image_size);
+        }
+    };
+
+    // 一帧在服务端各阶段完成的时刻（CLOCK_MONOTONIC 纳秒，0 表示没经过这一步）。
+    // 协商了 FEATURE_TIMING 时放在视频帧负载的最前面，客户端再记下收到和显示的时刻就能算出端到端各段延迟
+    struct FrameTiming {
+        uint64_t capture_ns;  // 曝光 / MJPEG 到达（消息头的 timestamp_ns 也是它）
+        uint64_t framed_ns;   // 整帧可用
+        uint64_t encoded_ns;  // 编码完成
+        uint64_t queued_ns;   // 排进这个连接的发送队列
+
+        void toNetworkOrder() {
+            capture_ns = htobe64(capture_ns);
+            framed_ns = htobe64(framed_ns);
+            encoded_ns = htobe64(encoded_ns);
+            queued_ns = htobe64(queued_ns);
+        }
+
+        void toHostOrder() {
+            capture_ns = be64toh(capture_ns);
+            framed_ns = be64toh(framed_ns);
+            encoded_ns = be64toh(encoded_ns);
+            queued_ns = be64toh(queued_ns);
+        }
+    };
+    static_assert(sizeof(FrameTiming) == 32, "");
+
+    // 解析后的消息头（两个版本通用，主机字节序）
+    struct Header {
+        uint8_t version = VERSION_1;
+        MessageType type = MessageType::UNKNOWN;
+        uint16_t flags = 0;          // 仅 v2
+        uint32_t message_id = 0;
+        uint32_t payload_length = 0;
+        uint64_t timestamp_ns = 0;   // v1 只有秒级墙钟时间（这里换算成纳秒）
+        uint32_t payload_crc = 0;    // 仅 v2
+    };
+
+    enum class ParseResult {
+        NeedMore,  // 数据还不够一个消息头
+        Ok,
+        Invalid    // 魔数/版本/CRC 不对
+    };
+
+    constexpr size_t MAX_HEADER_SIZE = sizeof(MessageHeaderV2);
+    constexpr size_t headerSize(uint8_t version) {
+        return version == VERSION_2 ? sizeof(MessageHeaderV2) : sizeof(MessageHeader);
+    }
+
+    // 从 data 开头解析一个 version 版本的消息头；不分配内存，不要求 data 对齐
+    ParseResult parseHeader(const uint8_t* data, size_t len, uint8_t version, Header& header);
+
+    // 按 header.version 写出消息头（v2 会填上 header_crc），out 至少 MAX_HEADER_SIZE 字节；返回写入的字节数
+    size_t writeHeader(const Header& header, uint8_t* out);
+
+    // 按连接的头几个字节判断协议版本；不到 4 字节时返回 0
+    uint8_t detectVersion(const uint8_t* data, size_t len);
+
+    // CRC-32（IEEE 802.3），可以分段累加：crc32(b, n2, crc32(a, n1))
+    uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+    // 增量消息解析：非阻塞 socket 每次读到多少就 feed 多少，消息被拆开或粘在一起都能正确切分。
+    // 第一条消息决定整个连接的协议版本
+    class MessageReader {
+    public:
+        explicit MessageReader(size_t max_payload = 64 * 1024);
+
+        void feed(const uint8_t* data, size_t len);
+
+        // 取出下一条完整消息；payload 指向内部缓冲，到下一次 feed() 之前有效。
+        // 数据不够一条消息时返回 false
+        bool next(Header& header, const uint8_t*& payload);
+
+        // 连接的协议版本，还没收到足够的字节时为 0
+        uint8_t version() const { return version_; }
+
+        // 协议错误（消息头损坏、负载超长、负载 CRC 不对），应断开连接
+        bool failed() const { return failed_; }
+
+    private:
+        std::vector<uint8_t> buffer_;
+        size_t pos_ = 0;  // 已经取走的字节
+        size_t max_payload_;
+        uint8_t version_ = 0;
+        bool failed_ = false;
+    };
+}
\ No newline at end of file
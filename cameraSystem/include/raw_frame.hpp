@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// 未编码的原始帧：直接指向采集端映射好的缓冲区（libcamera 的 dmabuf），不拷贝像素。
+// 帧对象和缓冲区都属于采集源、循环使用；持有 RawFrameRef 期间缓冲区不会被重新填充，
+// 最后一个引用释放时通过 RawFrameOwner::recycle() 把缓冲区还给采集源（比如重新排队 libcamera Request）。
+// 用侵入式引用计数而不是 shared_ptr：每帧不需要新分配控制块。
+
+enum class RawPixelFormat : uint8_t {
+    BGR888,  // 每像素 3 字节，内存顺序 B,G,R（libcamera 的 RGB888，和 OpenCV 的默认顺序一致）
+    YUV420,  // I420 三平面
+};
+
+struct RawFrame;
+
+class RawFrameOwner {
+public:
+    virtual ~RawFrameOwner() = default;
+    // 最后一个 RawFrameRef 释放时调用，可能在任意线程
+    virtual void recycle(RawFrame* frame) = 0;
+};
+
+struct RawFrame {
+    struct Plane {
+        const uint8_t* data = nullptr;
+        size_t length = 0;  // 本帧实际写入的字节数
+        uint32_t stride = 0;
+    };
+
+    uint32_t seq = 0;
+    uint64_t capture_ns = 0;  // 曝光时间戳（CLOCK_MONOTONIC，纳秒）
+    uint64_t framed_ns = 0;   // 采集源拿到整帧的时刻（同一时钟）
+    uint32_t width = 0;
+    uint32_t height = 0;
+    RawPixelFormat format = RawPixelFormat::BGR888;
+    Plane planes[3];
+    unsigned plane_count = 0;
+
+    RawFrameOwner* owner = nullptr;
+    void* cookie = nullptr;  // 采集源自用（比如对应的 Request）
+
+private:
+    friend class RawFrameRef;
+    std::atomic<int> refs_{0};
+};
+
+// RawFrame 的共享引用，语义和 shared_ptr 相同
+class RawFrameRef {
+public:
+    RawFrameRef() = default;
+    explicit RawFrameRef(RawFrame* frame) : frame_(frame) {
+        if (frame_) frame_->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    RawFrameRef(const RawFrameRef& other) : RawFrameRef(other.frame_) {}
+    RawFrameRef(RawFrameRef&& other) noexcept : frame_(std::exchange(other.frame_, nullptr)) {}
+    RawFrameRef& operator=(RawFrameRef other) noexcept {
+        std::swap(frame_, other.frame_);
+        return *this;
+    }
+    ~RawFrameRef() { reset(); }
+
+    void reset() {
+        RawFrame* f = std::exchange(frame_, nullptr);
+        // acq_rel：保证其它持有者对缓冲区的读取都发生在回收之前
+        if (f && f->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1 && f->owner) {
+            f->owner->recycle(f);
+        }
+    }
+
+    const RawFrame* get() const { return frame_; }
+    const RawFrame* operator->() const { return frame_; }
+    const RawFrame& operator*() const { return *frame_; }
+    explicit operator bool() const { return frame_ != nullptr; }
+
+private:
+    RawFrame* frame_ = nullptr;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 本机进程间的共享内存帧环（memfd），给障碍物检测这类本地视觉程序用：不走 TCP、不解码 JPEG。
+//
+// camera_server 为每路流（原始帧、JPEG）各建一个 memfd 环，在一个 Unix socket 上等读者连接；
+// 读者连上后通过 SCM_RIGHTS 拿到各个环的 memfd（只读映射）和一个专属的 eventfd，每发布一帧 eventfd 加一。
+// 每个槽位有自己的序号锁（seqlock）：写者写之前把锁加成奇数、写完加回偶数；读者直接在共享内存里读（零拷贝），
+// 读完再检查锁没变，变了说明这一帧已经被覆盖。环里有多个槽位，读者有几帧的时间处理最新帧。
+// 只依赖 libc，客户端程序链接 shm_ring 库即可。
+namespace ShmRing {
+
+constexpr uint32_t MAGIC = 0x53484D52;  // "SHMR"
+constexpr uint32_t VERSION = 1;
+constexpr const char* DEFAULT_SOCKET = "@camera_server/frames";  // '@' 开头表示抽象命名空间，不落文件
+
+enum class Stream : uint32_t {
+    Raw = 0,   // 未编码的原始帧（只有 libcamera 采集源有）
+    Jpeg = 1,  // 与 TCP 上 MJPEG 流相同的 JPEG
+};
+constexpr int STREAM_COUNT = 2;
+
+enum class PixelFormat : uint32_t {
+    Jpeg = 0,
+    BGR888 = 1,  // 一个平面，stride 字节一行
+    I420 = 2,    // Y、U、V 三个平面紧挨着，色度平面的 stride 为 stride / 2
+};
+
+// 环的头部，位于 memfd 开头
+struct alignas(64) RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_bytes;   // 每个槽位最多能放的数据字节
+    uint64_t slot_stride;  // 相邻槽位的间隔（槽头 + 数据，64 字节对齐）
+    std::atomic<uint64_t> write_seq;  // 已发布的帧数；最新一帧在 (write_seq - 1) % slot_count
+};
+
+// 槽位头，后面紧跟数据
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> lock;  // 序号锁：奇数表示正在写
+    uint64_t ring_seq;           // 这一帧在环里的发布序号
+    uint64_t capture_ns;         // 采集时刻（CLOCK_MONOTONIC）
+    uint64_t published_ns;       // 写进环的时刻（同一时钟）
+    uint32_t frame_seq;          // 采集端帧序号
+    PixelFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t bytes;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+static_assert(sizeof(RingHeader) == 64 && sizeof(SlotHeader) == 64, "");
+
+// 要写入的一帧：描述信息加若干段数据（比如 I420 的三个平面），依次拼进槽位
+struct FrameInfo {
+    uint32_t frame_seq = 0;
+    uint64_t capture_ns = 0;
+    PixelFormat format = PixelFormat::Jpeg;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+};
+
+struct Part {
+    const void* data;
+    size_t len;
+};
+
+// 一个环的写端（单生产者）
+class Writer {
+public:
+    Writer() = default;
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool create(const char* name, uint32_t slot_count, size_t slot_bytes);
+    int fd() const { return fd_; }
+
+    // 写入一帧；数据超过槽位大小时返回 false
+    bool publish(const FrameInfo& info, const Part* parts, size_t part_count);
+
+private:
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+// camera_server 一侧：持有各路流的环，接受本地读者并通知它们
+class Server {
+public:
+    struct RingConfig {
+        uint32_t slot_count;
+        size_t slot_bytes;
+    };
+
+    Server() = default;
+    ~Server();
+
+    bool start(const std::string& socket_path, const RingConfig (&rings)[STREAM_COUNT]);
+    void stop();
+
+    // 有读者连着时才值得拷贝
+    bool hasReaders() const { return readers_.load(std::memory_order_relaxed) > 0; }
+
+    // 写入一帧并唤醒所有读者（每路流只能有一个线程调用）
+    bool publish(Stream stream, const FrameInfo& info, const Part* parts, size_t part_count);
+
+private:
+    struct Client {
+        int sock;
+        int event_fd;
+    };
+
+    void run();
+    void accept();
+    void drop(size_t index);
+
+    Writer rings_[STREAM_COUNT];
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::vector<Client> clients_;
+    std::atomic<int> readers_{0};
+};
+
+// 一帧的零拷贝视图，指向共享内存；用完前用 Reader::valid() 确认没被覆盖
+struct FrameView {
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    uint64_t ring_seq = 0;
+    uint64_t capture_ns = 0;
+    uint64_t published_ns = 0;
+    uint32_t frame_seq = 0;
+    PixelFormat format = PixelFormat::Jpeg;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+
+private:
+    friend class Reader;
+    const SlotHeader* slot_ = nullptr;
+    uint64_t lock_ = 0;
+};
+
+// 读者（客户端库）
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool connect(const std::string& socket_path = DEFAULT_SOCKET);
+    void close();
+
+    // 每发布一帧（任一路流）变为可读，可以放进自己的 poll/epoll
+    int eventFd() const { return event_fd_; }
+
+    // 等到有新帧或超时（毫秒，-1 一直等）；返回是否有新帧
+    bool wait(int timeout_ms);
+
+    // 某路流最新一帧的零拷贝视图；还没有帧时返回 false
+    bool latest(Stream stream, FrameView& view) const;
+
+    // 视图指向的数据是否仍然完整（处理完之后调用；false 时结果应丢弃）
+    bool valid(const FrameView& view) const;
+
+    // 把最新一帧拷出来（拷贝期间被覆盖会自动重试）；还没有帧时返回 false
+    bool copyLatest(Stream stream, std::vector<uint8_t>& out, FrameView& info) const;
+
+private:
+    int sock_ = -1;
+    int event_fd_ = -1;
+    const uint8_t* rings_[STREAM_COUNT] = {};
+    size_t sizes_[STREAM_COUNT] = {};
+};
+
+}  // namespace ShmRing
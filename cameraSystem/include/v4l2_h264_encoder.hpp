@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "raw_frame.hpp"
+#include "v4l2_m2m.hpp"
+
+// V4L2 M2M H.264 编码器，树莓派上对应 bcm2835-codec 的 /dev/video11。
+// 所有观众共用这一个编码器实例；每次 encode() 输出一个完整的访问单元（Annex-B）。
+// 关键帧间隔由 I 帧周期决定，观众加入或丢帧时可以 requestKeyframe() 立刻插一个 IDR。
+class V4l2H264Encoder {
+public:
+    struct Settings {
+        unsigned bitrate = 1500000;  // 码率（bit/s）
+        unsigned fps = 20;
+        unsigned idr_period = 60;    // 没人请求时每隔多少帧一个 IDR
+    };
+
+    explicit V4l2H264Encoder(const Settings& settings, std::string device = "/dev/video11");
+
+    // 打开设备并确认是支持 H.264 输出的 M2M 编码器；不可用时返回 false
+    bool open();
+
+    // 编码一帧，访问单元写进 out（覆盖原内容）；keyframe 返回是否为 IDR
+    bool encode(const RawFrame& frame, std::vector<uint8_t>& out, bool& keyframe);
+
+    // 下一帧编成 IDR（任意线程可调用）
+    void requestKeyframe() { keyframe_requested_.store(true, std::memory_order_relaxed); }
+
+private:
+    bool configure(const RawFrame& frame);
+
+    Settings settings_;
+    V4l2M2m dev_;
+    std::atomic<bool> keyframe_requested_{false};
+};
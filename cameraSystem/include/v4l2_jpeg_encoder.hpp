@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include "jpeg_encoder.hpp"
+#include "v4l2_m2m.hpp"
+
+// V4L2 M2M JPEG 编码器，树莓派上对应 bcm2835-codec 的 /dev/video31（encode_image）。
+// 分辨率或像素格式变化时重新配置；质量通过 V4L2_CID_JPEG_COMPRESSION_QUALITY 设置。
+class V4l2JpegEncoder : public JpegEncoder {
+public:
+    explicit V4l2JpegEncoder(std::string device = "/dev/video31");
+
+    // 打开设备并确认是支持 JPEG 输出的 M2M 编码器；不可用时返回 false
+    bool open();
+
+    const char* name() const override { return "v4l2"; }
+    bool encode(const RawFrame& frame, int quality, std::vector<uint8_t>& out) override;
+
+private:
+    V4l2M2m dev_;
+    int quality_ = -1;
+};
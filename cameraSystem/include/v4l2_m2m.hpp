@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <linux/videodev2.h>
+#include "raw_frame.hpp"
+
+// V4L2 内存到内存（M2M）编码设备的公共部分，JPEG 和 H.264 编码器共用。
+// 输入端一个 MMAP 缓冲区、输出端若干个 MMAP 缓冲区，配置时映射一次；
+// 每帧把像素按设备要求的行跨度拷进输入缓冲区（一次 memcpy），排队后同步等待输出。
+// 用法：open() -> configure() -> setControl()... -> start() -> process()...；输入尺寸/格式变化时重新 configure。
+class V4l2M2m {
+public:
+    explicit V4l2M2m(std::string device);
+    ~V4l2M2m();
+
+    // 打开设备并确认是输出端支持 capture_fourcc 的 M2M 设备；不可用时返回 false
+    bool open(uint32_t capture_fourcc);
+    bool isOpen() const { return fd_ >= 0; }
+    const std::string& device() const { return device_; }
+
+    // 当前配置是否和这一帧的尺寸、格式一致
+    bool matches(const RawFrame& frame) const;
+
+    // 设置输入/输出格式并映射缓冲区（不开始流）
+    bool configure(const RawFrame& frame, uint32_t capture_fourcc, uint32_t capture_size, unsigned capture_buffers);
+    bool setControl(uint32_t id, int32_t value);
+    bool start();
+
+    // 送入一帧，收集输出写进 out（覆盖原内容），直到 done(out) 为真；flags 返回输出缓冲区标志的并集
+    bool process(const RawFrame& frame, std::vector<uint8_t>& out, uint32_t& flags,
+                 const std::function<bool(const std::vector<uint8_t>&)>& done);
+
+    // 停止流并释放缓冲区（下一帧会重新配置）
+    void release();
+
+private:
+    struct Mapping {
+        void* ptr = nullptr;
+        size_t length = 0;
+    };
+
+    int xioctl(unsigned long request, void* arg);
+    bool requestBuffers(uint32_t type, unsigned count, std::vector<Mapping>& maps);
+    bool queueCapture(uint32_t index);
+    void copyInput(const RawFrame& frame);
+
+    std::string device_;
+    int fd_ = -1;
+    bool streaming_ = false;
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    RawPixelFormat format_ = RawPixelFormat::BGR888;
+
+    // 设备接受的输入布局（S_FMT 之后驱动返回的）
+    uint32_t out_stride_ = 0;
+    uint32_t out_height_ = 0;
+    uint32_t out_size_ = 0;
+
+    std::vector<Mapping> out_maps_;  // 输入端（V4L2 的 OUTPUT 队列）
+    std::vector<Mapping> cap_maps_;  // 输出端（V4L2 的 CAPTURE 队列）
+};
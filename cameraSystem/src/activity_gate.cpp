@@ -0,0 +1,153 @@
+#include "../include/activity_gate.hpp"
+#include "../include/log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+ActivityGate::~ActivityGate() {
+    stop();
+}
+
+bool ActivityGate::start(const std::string& socket_path, const Config& config, RateFn apply) {
+    config_ = config;
+    apply_ = std::move(apply);
+
+    sockaddr_un addr;
+    socklen_t len = CameraWake::makeAddress(socket_path, addr);
+    if (socket_path[0] != '@') ::unlink(socket_path.c_str());
+    sock_fd_ = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (sock_fd_ < 0 || timer_fd_ < 0 || stop_fd_ < 0 ||
+        ::bind(sock_fd_, reinterpret_cast<sockaddr*>(&addr), len) < 0) {
+        LOG_E("[ActivityGate] listen on " << socket_path << ": " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    // 先进入空闲：有障碍物时传感器会马上发 Enter
+    apply_(config_.idle_fps);
+    LOG_I("[ActivityGate] idle at " << config_.idle_fps << " fps, waiting for wake on " << socket_path);
+    thread_ = std::thread(&ActivityGate::run, this);
+    return true;
+}
+
+void ActivityGate::stop() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t n = ::write(stop_fd_, &one, sizeof(one));
+        (void)n;
+        thread_.join();
+    }
+    for (int* fd : {&sock_fd_, &timer_fd_, &stop_fd_}) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+}
+
+void ActivityGate::run() {
+    pollfd fds[3] = {{stop_fd_, POLLIN, 0}, {sock_fd_, POLLIN, 0}, {timer_fd_, POLLIN, 0}};
+    while (true) {
+        if (::poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) break;
+        uint64_t now = monotonicNs();
+        if (fds[1].revents & POLLIN) {
+            CameraWake::Message msg;
+            ssize_t n;
+            while ((n = ::recv(sock_fd_, &msg, sizeof(msg), MSG_TRUNC)) >= 0) {
+                messages_.fetch_add(1, std::memory_order_relaxed);
+                if (n != ssize_t(sizeof(msg)) || msg.magic != CameraWake::MAGIC || msg.version != CameraWake::VERSION) {
+                    invalid_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                onMessage(msg, now);
+            }
+        }
+        if (fds[2].revents & POLLIN) {
+            uint64_t expirations;
+            ssize_t n = ::read(timer_fd_, &expirations, sizeof(expirations));
+            (void)n;
+            onTimer(now);
+        }
+    }
+}
+
+void ActivityGate::onMessage(const CameraWake::Message& msg, uint64_t now) {
+    uint64_t cooldown_ns = uint64_t(config_.cooldown_ms) * 1000000ull;
+    switch (msg.event) {
+        case CameraWake::Event::Enter:
+        case CameraWake::Event::Hold: {
+            unsigned hold_ms = msg.hold_ms ? std::min(msg.hold_ms, config_.max_hold_ms) : config_.max_hold_ms;
+            deadline_ns_[msg.source] = now + uint64_t(hold_ms) * 1000000ull + cooldown_ns;
+            if (!active_) {
+                LOG_I("[ActivityGate] wake from sensor " << int(msg.source) << " at " << msg.distance_cm << " cm");
+                setActive(true, now);
+            }
+            break;
+        }
+        case CameraWake::Event::Leave:
+            if (deadline_ns_[msg.source]) deadline_ns_[msg.source] = now + cooldown_ns;
+            break;
+        default:
+            invalid_.fetch_add(1, std::memory_order_relaxed);
+            return;
+    }
+    rearm(now);
+}
+
+void ActivityGate::onTimer(uint64_t now) {
+    for (uint64_t& deadline : deadline_ns_) {
+        if (deadline && deadline <= now) deadline = 0;
+    }
+    rearm(now);
+}
+
+// 定时器对准最晚的租约；全部到期就回到空闲
+void ActivityGate::rearm(uint64_t now) {
+    uint64_t latest = *std::max_element(std::begin(deadline_ns_), std::end(deadline_ns_));
+    if (latest == 0) {
+        if (active_) {
+            LOG_I("[ActivityGate] cooldown elapsed, back to " << config_.idle_fps << " fps");
+            setActive(false, now);
+        }
+        return;
+    }
+    uint64_t wait_ns = latest > now ? latest - now : 1;
+    itimerspec spec{};
+    spec.it_value.tv_sec = time_t(wait_ns / 1000000000ull);
+    spec.it_value.tv_nsec = long(wait_ns % 1000000000ull);
+    timerfd_settime(timer_fd_, 0, &spec, nullptr);
+}
+
+void ActivityGate::setActive(bool active, uint64_t now) {
+    active_ = active;
+    if (active) {
+        activated_ns_ = now;
+        activations_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        active_ms_.fetch_add((now - activated_ns_) / 1000000ull, std::memory_order_relaxed);
+    }
+    apply_(active ? config_.active_fps : config_.idle_fps);
+}
+
+ActivityGate::Stats ActivityGate::stats() const {
+    Stats s;
+    s.messages = messages_.load(std::memory_order_relaxed);
+    s.invalid = invalid_.load(std::memory_order_relaxed);
+    s.activations = activations_.load(std::memory_order_relaxed);
+    s.active_ms = active_ms_.load(std::memory_order_relaxed);
+    return s;
+}
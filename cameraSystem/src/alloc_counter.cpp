@@ -0,0 +1,64 @@
+#include "../include/alloc_counter.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <malloc.h>
+
+// glibc 导出的真正实现（声明和 glibc 头文件一致，带 noexcept）；可执行文件里定义的同名函数会覆盖动态库里的 malloc（符号插入）
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+static std::atomic<uint64_t> g_allocs{0};
+static std::atomic<uint64_t> g_bytes{0};
+
+static inline void count(size_t bytes) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+    count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    count(size);
+    void* p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+}  // extern "C"
+
+AllocCounter::Snapshot AllocCounter::now() {
+    return {g_allocs.load(std::memory_order_relaxed), g_bytes.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,501 @@
+#include "../include/camera_session.hpp"
+#include "../include/log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+static constexpr uint64_t SEND_TIMEOUT_NS = 5000000000ull;  // 发送队列 5 秒没有进展就断开
+static constexpr uint64_t HELLO_WAIT_NS = 300000000ull;     // 等客户端第一条消息的时间，过了先按 v1 推流（之后收到 v2 魔数再切换）
+static constexpr uint64_t CAPTURE_SETTLE_NS = 150000000ull; // 窗口结束后再等一会，让还在编码的帧进回看环
+static constexpr size_t MAX_PENDING_CAPTURES = 4;           // 每个连接同时等待中的窗口抓拍
+
+// 服务端支持的 v2 可选功能
+static constexpr uint32_t SERVER_FEATURES =
+    Protocol::FEATURE_PAYLOAD_CRC | Protocol::FEATURE_STATS | Protocol::FEATURE_ADAPTIVE | Protocol::FEATURE_TIMING;
+
+CameraSession::CameraSession(const Poco::Net::StreamSocket& socket, EventLoop& loop, CapturePipeline& pipeline,
+                             ClientRegistry& registry)
+    : socket_(socket),
+      fd_(socket_.impl()->sockfd()),
+      peer_(socket_.peerAddress().toString()),
+      loop_(loop),
+      pipeline_(pipeline),
+      registry_(registry),
+      stream_(&pipeline.mjpeg()) {}
+
+CameraSession::~CameraSession() {
+    close("server stopped");
+}
+
+bool CameraSession::open() {
+    socket_.setBlocking(false);
+    // 发送缓冲区压小：内核里排的数据越少，拥塞控制看到的队列越接近真实延迟
+    socket_.setSendBufferSize(192 * 1024);
+    if (!loop_.add(fd_, EPOLLIN, [this](uint32_t events) { onEvents(events); })) {
+        LOG_E("[CameraSession] epoll add failed for " << peer_ << ": " << strerror(errno));
+        closed_ = true;
+        return false;
+    }
+    stats_ = registry_.add(peer_);
+    // 每个连接有自己的读位置，从连接建立后的下一帧开始
+    cursor_ = stream_->subscribe();
+    out_.reserve(4);
+    last_progress_ns_ = opened_ns_ = monotonicNs();
+    LOG_I("=== CameraSession started for " << peer_ << " ===");
+    return true;
+}
+
+void CameraSession::close(const char* reason) {
+    if (closed_) return;
+    closed_ = true;
+    loop_.remove(fd_);
+    if (codec_ == Protocol::StreamCodec::H264) pipeline_.removeH264Viewer();
+    pipeline_.removeTierViewer(tier_);
+    if (stats_) registry_.remove(stats_);
+    out_.clear();
+    out_head_ = 0;
+    LOG_I("=== CameraSession closed for " << peer_ << " (" << reason << ", sent=" << cursor_.delivered
+          << ", dropped=" << cursor_.dropped << ") ===");
+}
+
+void CameraSession::onEvents(uint32_t events) {
+    if (events & EPOLLERR) {
+        close("socket error");
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLHUP)) onReadable();
+    if (!closed_ && (events & EPOLLOUT) && flush()) pump();
+}
+
+void CameraSession::onReadable() {
+    uint8_t buffer[4096];
+    // 一次最多读 16 块，剩下的下一轮再读（水平触发），一个客户端刷命令不会饿死别人
+    for (int i = 0; i < 16; ++i) {
+        ssize_t n = ::recv(fd_, buffer, sizeof(buffer), 0);
+        if (n == 0) {
+            close("peer closed");
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close("recv failed");
+            return;
+        }
+        reader_.feed(buffer, size_t(n));
+        if (size_t(n) < sizeof(buffer)) break;
+    }
+
+    Protocol::Header header;
+    const uint8_t* payload = nullptr;
+    bool undecided = version_ == 0;
+    while (!closed_ && reader_.next(header, payload)) {
+        if (version_ == 0) setVersion(reader_.version());
+        else if (version_ != reader_.version()) upgradeToV2();
+        handleMessage(header, payload);
+    }
+    if (reader_.failed()) {
+        close("protocol error");
+        return;
+    }
+    // 先回复第一条消息（比如 HELLO），再开始推流
+    if (undecided && version_ != 0) pump();
+}
+
+void CameraSession::setVersion(uint8_t version) {
+    version_ = version;
+    LOG_I("[CameraSession] " << peer_ << " protocol v" << int(version_));
+}
+
+// 超时后已经按 v1 推流，客户端的第一批字节却是 v2 魔数（慢链路上的 v2 客户端，读取器按开头 4 字节认出来）：
+// 在消息边界切到 v2。正在写的那条 v1 消息写完，还没开始写的丢掉（帧还给缓冲池），之后的消息（先是 HELLO 回复）都用 v2 消息头
+void CameraSession::upgradeToV2() {
+    size_t keep = out_head_ < out_.size() && out_[out_head_].offset > 0 ? out_head_ + 1 : out_head_;
+    size_t dropped = out_.size() - keep;
+    out_.erase(out_.begin() + keep, out_.end());
+    if (out_head_ == out_.size()) {
+        out_.clear();
+        out_head_ = 0;
+    }
+    LOG_I("[CameraSession] " << peer_ << " late v2 HELLO, switching from v1 (" << dropped << " queued v1 messages dropped)");
+    version_ = Protocol::VERSION_2;
+}
+
+void CameraSession::queueMessage(Protocol::MessageType type, const void* payload, size_t len, FramePtr body,
+                                 bool frame) {
+    uint64_t now = monotonicNs();
+    Protocol::FrameTiming timing;
+    if (frame && (features_ & Protocol::FEATURE_TIMING)) {
+        timing = {body->capture_ns, body->framed_ns, body->encoded_ns, now};
+        timing.toNetworkOrder();
+        payload = &timing;
+        len = sizeof(timing);
+    }
+
+    Protocol::Header header;
+    header.version = version_;
+    header.message_id = next_message_id_++;
+    header.type = type;
+    header.payload_length = static_cast<uint32_t>(len + (body ? body->data.size() : 0));
+    if (version_ == Protocol::VERSION_2) {
+        header.timestamp_ns = frame ? body->capture_ns : now;
+        if (frame && body->keyframe) header.flags |= Protocol::FLAG_KEYFRAME;
+        if (frame && (features_ & Protocol::FEATURE_TIMING)) header.flags |= Protocol::FLAG_TIMING;
+        if (features_ & Protocol::FEATURE_PAYLOAD_CRC) {
+            header.flags |= Protocol::FLAG_PAYLOAD_CRC;
+            header.payload_crc = Protocol::crc32(static_cast<const uint8_t*>(payload), len);
+            if (body) header.payload_crc = Protocol::crc32(body->data.data(), body->data.size(), header.payload_crc);
+        }
+    } else {
+        header.timestamp_ns = uint64_t(std::time(nullptr)) * 1000000000ull;  // v1 是秒级墙钟时间
+    }
+
+    out_.emplace_back();
+    Outgoing& msg = out_.back();
+    uint8_t* head = msg.inline_head;
+    if (Protocol::MAX_HEADER_SIZE + len > Outgoing::INLINE_HEAD) {
+        msg.heap_head.resize(Protocol::MAX_HEADER_SIZE + len);
+        head = msg.heap_head.data();
+    }
+    msg.head_len = Protocol::writeHeader(header, head);
+    if (len) std::memcpy(head + msg.head_len, payload, len);
+    msg.head_len += len;
+    msg.body = std::move(body);
+    msg.frame = frame;
+    msg.queued_ns = now;
+}
+
+bool CameraSession::flush() {
+    while (out_head_ < out_.size()) {
+        // 把队列里的消息头和帧数据拼成一次 sendmsg
+        iovec iov[16];
+        int count = 0;
+        for (size_t i = out_head_; i < out_.size(); ++i) {
+            const Outgoing& m = out_[i];
+            if (count + 2 > 16) break;
+            size_t off = m.offset;
+            if (off < m.head_len) {
+                iov[count++] = {const_cast<uint8_t*>(m.head()) + off, m.head_len - off};
+                off = 0;
+            } else {
+                off -= m.head_len;
+            }
+            if (m.body && off < m.body->data.size()) {
+                iov[count++] = {const_cast<uint8_t*>(m.body->data.data()) + off, m.body->data.size() - off};
+            }
+        }
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = size_t(count);
+        ssize_t written = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close("send failed");
+            return false;
+        }
+        last_progress_ns_ = monotonicNs();
+        cc_.onWritten(size_t(written));
+
+        size_t left = size_t(written);
+        while (left > 0) {
+            Outgoing& m = out_[out_head_];
+            size_t remaining = m.size() - m.offset;
+            if (left < remaining) {
+                m.offset += left;
+                break;
+            }
+            left -= remaining;
+            if (m.frame) {
+                cc_.onSent();
+                LatencyStats& latency = pipeline_.latency();
+                uint64_t sent_ns = monotonicNs();
+                latency.record(LatencyStats::Queue, m.body->encoded_ns, m.queued_ns);
+                latency.record(LatencyStats::Send, m.queued_ns, sent_ns);
+                latency.record(LatencyStats::Total, m.body->capture_ns, sent_ns);
+            }
+            bytes_ += m.size();
+            m.body.reset();  // 帧立刻还给缓冲池，不等整个队列清空
+            if (++out_head_ == out_.size()) {
+                out_.clear();
+                out_head_ = 0;
+            }
+        }
+    }
+    updateInterest();
+    return true;
+}
+
+void CameraSession::updateInterest() {
+    // 只在有数据积压时关心可写事件，否则水平触发会一直报可写
+    bool want = out_head_ < out_.size();
+    if (want == want_write_) return;
+    want_write_ = want;
+    loop_.modify(fd_, want ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+}
+
+void CameraSession::pump() {
+    if (!closed_ && !captures_.empty()) serveCaptures(monotonicNs());
+    // 上一帧还没写完就不取新帧：慢客户端的过期帧由广播器跳过（计入 cursor_.dropped）
+    while (!closed_ && version_ != 0 && out_head_ == out_.size()) {
+        uint64_t dropped_before = cursor_.dropped;
+        FramePtr frame = stream_->tryNext(cursor_);
+        if (!frame) return;
+        if (!sendFrame(frame, cursor_.dropped != dropped_before)) continue;
+        if (!flush()) return;
+
+        // MJPEG 按拥塞控制的档位换流（H.264 只有一路，只靠跳帧）
+        if (codec_ == Protocol::StreamCodec::MJPEG && cc_.tier() != tier_) switchTier(cc_.tier());
+
+        frame_count_++;
+        if (frame_count_ % 30 == 0) {
+            LOG_I("[CameraSession] " << peer_ << " sent frames=" << frame_count_ << " dropped=" << cursor_.dropped);
+        }
+    }
+}
+
+bool CameraSession::sendFrame(const FramePtr& frame, bool skipped_before) {
+    if (frame->data.empty()) {
+        LOG_W("[CameraSession] got empty frame.");
+        return false;
+    }
+
+    if (frame->codec == FrameCodec::H264) {
+        // H.264 的 P 帧依赖前面的帧：刚加入或中间被跳过帧时，一直等到下一个关键帧再发
+        if (skipped_before && !need_keyframe_) {
+            need_keyframe_ = true;
+            pipeline_.requestKeyframe();
+        }
+        if (need_keyframe_ && !frame->keyframe) return false;
+    }
+
+    // 拥塞控制：预计到达客户端时已经超过延迟目标的帧不发
+    TcpSample sample;
+    if (probeTcp(fd_, sample) && !cc_.shouldSend(sample, frame->data.size(), frame->capture_ns, monotonicNs())) {
+        if (frame->codec == FrameCodec::H264 && !need_keyframe_) {
+            // 跳过一个 H.264 帧后后面的 P 帧都解不出来，等下一个关键帧再继续
+            need_keyframe_ = true;
+            pipeline_.requestKeyframe();
+        }
+        return false;
+    }
+    if (frame->codec == FrameCodec::H264) need_keyframe_ = false;
+
+    // 采集端已经按需要的方向编码，直接转发，不解码/重编码
+    queueMessage(frame->codec == FrameCodec::H264 ? Protocol::MessageType::VIDEO_FRAME_H264
+                                                  : Protocol::MessageType::VIDEO_FRAME,
+                 nullptr, 0, frame, true);
+    return true;
+}
+
+void CameraSession::handleMessage(const Protocol::Header& header, const uint8_t* payload) {
+    if (header.type == Protocol::MessageType::CAPTURE_COMMAND &&
+        header.payload_length >= sizeof(Protocol::CaptureRequest)) {
+        Protocol::CaptureRequest request;
+        std::memcpy(&request, payload, sizeof(request));
+        request.toHostOrder();
+        startCapture(header.message_id, request);
+        return;
+    } else if (header.type == Protocol::MessageType::CAPTURE_COMMAND) {
+        LOG_I("Received capture command");
+        // 取最近一帧并返回（原样返回广播的 JPEG；再用更高质量重编码也找不回已经损失的细节）
+        FramePtr photo = pipeline_.mjpeg().latest(); // 最近一帧
+        if (!photo) {
+            LOG_W("No frame to capture.");
+            return;
+        }
+
+        if (version_ == Protocol::VERSION_2) {
+            // v2 不带文件名，客户端自己命名
+            Protocol::CaptureResponseV2 response{header.message_id, static_cast<uint32_t>(photo->data.size())};
+            response.toNetworkOrder();
+            queueMessage(Protocol::MessageType::CAPTURE_RESPONSE, &response, sizeof(response), photo);
+        } else {
+            Protocol::CaptureResponse response;
+            response.capture_id = header.message_id;
+            response.image_size = static_cast<uint32_t>(photo->data.size());
+            std::snprintf(response.filename, sizeof(response.filename), "capture_%u.jpg", header.message_id);
+            response.toNetworkOrder();
+            queueMessage(Protocol::MessageType::CAPTURE_RESPONSE, &response, sizeof(response), photo);
+        }
+        LOG_I("Photo captured and sent: capture_" << header.message_id);
+    } else if (header.type == Protocol::MessageType::STREAM_SELECT) {
+        Protocol::StreamSelect select{Protocol::StreamCodec::MJPEG};
+        if (header.payload_length >= sizeof(select)) std::memcpy(&select, payload, sizeof(select));
+        selectStream(select.codec);
+
+        // 回复实际使用的流（没有 H.264 编码器时仍是 MJPEG）
+        Protocol::StreamSelect resp{codec_};
+        queueMessage(Protocol::MessageType::STREAM_SELECT, &resp, sizeof(resp));
+    } else if (header.type == Protocol::MessageType::HELLO && version_ == Protocol::VERSION_2) {
+        handleHello(payload, header.payload_length);
+    } else if (header.type == Protocol::MessageType::KEYFRAME_REQUEST) {
+        pipeline_.requestKeyframe();
+    } else if (header.type == Protocol::MessageType::STATS_REQUEST) {
+        std::string json =
+            "{\"clients\":" + registry_.toJson() + ",\"latency\":" + pipeline_.latency().toJson() +
+                           ",\"pools\":" + pipeline_.poolStatsJson() + "}";
+        queueMessage(Protocol::MessageType::STATS_RESPONSE, json.data(), json.size());
+    } else {
+        return;
+    }
+    flush();
+}
+
+void CameraSession::startCapture(uint32_t id, const Protocol::CaptureRequest& request) {
+    if (captures_.size() >= MAX_PENDING_CAPTURES) {
+        LOG_W("[CameraSession] " << peer_ << " too many pending captures, ignoring capture " << id);
+        return;
+    }
+    uint64_t now = monotonicNs();
+    PendingCapture capture;
+    capture.id = id;
+    capture.trigger_ns = now;
+    uint64_t pre_ns = uint64_t(request.pre_ms) * 1000000ull;
+    capture.from_ns = now > pre_ns ? now - pre_ns : 0;
+    capture.until_ns = now + uint64_t(std::min(request.post_ms, Protocol::MAX_CAPTURE_POST_MS)) * 1000000ull;
+    capture.max_frames = request.max_frames ? std::min(request.max_frames, Protocol::MAX_CAPTURE_FRAMES)
+                                            : Protocol::MAX_CAPTURE_FRAMES;
+    capture.interval_ns = uint64_t(request.interval_ms) * 1000000ull;
+    captures_.push_back(capture);
+    LOG_I("[CameraSession] " << peer_ << " capture " << id << " window -" << request.pre_ms << "ms/+"
+          << request.post_ms << "ms max=" << capture.max_frames);
+    serveCaptures(now);
+}
+
+// 窗口已经结束的抓拍：从回看环取帧，按时间先后逐张排进发送队列（发完之前不再取新的视频帧）
+void CameraSession::serveCaptures(uint64_t now_ns) {
+    bool queued = false;
+    for (size_t i = 0; i < captures_.size();) {
+        const PendingCapture& c = captures_[i];
+        if (now_ns < c.until_ns + CAPTURE_SETTLE_NS) {
+            ++i;
+            continue;
+        }
+        std::vector<FramePtr> frames;
+        if (const CaptureRing* ring = pipeline_.captureRing()) {
+            frames = ring->collect(c.from_ns, c.until_ns, c.max_frames, c.interval_ns);
+        } else if (FramePtr latest = pipeline_.mjpeg().latest()) {
+            frames.push_back(latest);  // 没有回看环时只能给最近一帧
+        }
+
+        Protocol::CaptureBatchItem item{c.id, 0, uint16_t(frames.size()), 0, 0, 0};
+        if (frames.empty()) {
+            item.toNetworkOrder();
+            queueMessage(Protocol::MessageType::CAPTURE_BATCH, &item, sizeof(item));
+        }
+        for (size_t k = 0; k < frames.size(); ++k) {
+            Protocol::CaptureBatchItem wire = item;
+            wire.index = uint16_t(k);
+            wire.capture_ns = frames[k]->capture_ns;
+            wire.offset_us = int32_t((int64_t(frames[k]->capture_ns) - int64_t(c.trigger_ns)) / 1000);
+            wire.image_size = uint32_t(frames[k]->data.size());
+            wire.toNetworkOrder();
+            queueMessage(Protocol::MessageType::CAPTURE_BATCH, &wire, sizeof(wire), frames[k]);
+        }
+        LOG_I("[CameraSession] " << peer_ << " capture " << c.id << " sent " << frames.size() << " frames");
+        captures_.erase(captures_.begin() + long(i));
+        queued = true;
+    }
+    if (queued) flush();
+}
+
+void CameraSession::handleHello(const uint8_t* payload, size_t len) {
+    Protocol::Hello hello{Protocol::VERSION_2, Protocol::VERSION_2, 0, 0, 0};
+    if (len >= sizeof(hello)) {
+        std::memcpy(&hello, payload, sizeof(hello));
+        hello.toHostOrder();
+    }
+
+    uint32_t codecs = Protocol::codecBit(Protocol::StreamCodec::MJPEG);
+    if (pipeline_.hasH264()) codecs |= Protocol::codecBit(Protocol::StreamCodec::H264);
+    features_ = hello.features & SERVER_FEATURES;
+
+    // 回复协商结果：版本不在客户端支持范围内时照样回复，由客户端决定断开
+    Protocol::Hello resp{Protocol::VERSION_2, Protocol::VERSION_2, 0, codecs & hello.codecs, features_};
+    LOG_I("[CameraSession] " << peer_ << " HELLO v" << int(hello.min_version) << "-v" << int(hello.max_version)
+          << " codecs=" << resp.codecs << " features=" << resp.features);
+    // 客户端只要 H.264 时直接切过去，省一次 STREAM_SELECT
+    if (resp.codecs == Protocol::codecBit(Protocol::StreamCodec::H264)) selectStream(Protocol::StreamCodec::H264);
+    resp.toNetworkOrder();
+    queueMessage(Protocol::MessageType::HELLO, &resp, sizeof(resp));
+}
+
+void CameraSession::selectStream(Protocol::StreamCodec codec) {
+    if (codec == Protocol::StreamCodec::H264 && !pipeline_.hasH264()) {
+        LOG_W("H.264 requested but not available, staying on MJPEG.");
+        codec = Protocol::StreamCodec::MJPEG;
+    }
+    if (codec == codec_) return;
+
+    if (codec == Protocol::StreamCodec::H264) {
+        pipeline_.addH264Viewer();  // 会顺带请求一个关键帧
+        pipeline_.removeTierViewer(tier_);
+        tier_ = 0;
+        resubscribe(pipeline_.h264());
+        need_keyframe_ = true;
+    } else {
+        pipeline_.removeH264Viewer();
+        tier_ = cc_.tier();
+        pipeline_.addTierViewer(tier_);
+        resubscribe(pipeline_.tier(tier_));
+    }
+    codec_ = codec;
+    LOG_I("Stream switched to " << (codec_ == Protocol::StreamCodec::H264 ? "H.264" : "MJPEG"));
+}
+
+// 换了广播器，读位置从新流的下一帧开始；统计累计
+void CameraSession::resubscribe(FrameBroadcaster& stream) {
+    stream_ = &stream;
+    FrameBroadcaster::Cursor c = stream_->subscribe();
+    c.delivered = cursor_.delivered;
+    c.dropped = cursor_.dropped;
+    cursor_ = c;
+}
+
+void CameraSession::switchTier(int tier) {
+    pipeline_.removeTierViewer(tier_);
+    pipeline_.addTierViewer(tier);
+    resubscribe(pipeline_.tier(tier));
+    LOG_I("[CameraSession] " << peer_ << " tier " << tier_ << " -> " << tier << " (rate "
+          << int(cc_.stats().rate_bps * 8 / 1000) << " kbps, rtt " << cc_.stats().rtt_us / 1000 << " ms)");
+    tier_ = tier;
+}
+
+void CameraSession::tick(uint64_t now_ns) {
+    if (closed_) return;
+    if (version_ == 0 && now_ns - opened_ns_ > HELLO_WAIT_NS) {
+        setVersion(Protocol::VERSION_1);
+        pump();
+    }
+    if (out_head_ < out_.size() && now_ns - last_progress_ns_ > SEND_TIMEOUT_NS) {
+        close("send timeout");
+        return;
+    }
+    if (!captures_.empty()) serveCaptures(now_ns);
+    publishStats(now_ns);
+}
+
+// 约每秒把本连接的统计写进登记表一次
+void CameraSession::publishStats(uint64_t now_ns) {
+    if (now_ns - last_stats_ns_ < 1000000000ull) return;
+    last_stats_ns_ = now_ns;
+    ClientStats value;
+    value.peer = peer_;
+    value.codec = codec_ == Protocol::StreamCodec::H264 ? "h264" : "mjpeg";
+    value.cc = cc_.stats();
+    value.bytes = bytes_;
+    value.broadcaster_dropped = cursor_.dropped;
+    registry_.update(stats_, value);
+}
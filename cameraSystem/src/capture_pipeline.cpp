@@ -0,0 +1,347 @@
+#include "../include/capture_pipeline.hpp"
+#include "../include/log.hpp"
+#include <cstdio>
+#include <utility>
+#include <opencv2/imgproc.hpp>
+
+// 档位 0 的质量取构造时给的 quality；它对应原始流，这里的值不使用
+const CapturePipeline::TierSpec CapturePipeline::kTiers[CapturePipeline::TIERS] = {
+    {80, 1},
+    {55, 1},
+    {45, 2},
+};
+
+static int64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CapturePipeline::CapturePipeline(FrameBroadcaster& mjpeg, FrameBroadcaster& h264,
+                                 std::unique_ptr<JpegEncoder> jpeg_encoder, int quality)
+    : mjpeg_(mjpeg), h264_(h264), jpeg_encoder_(std::move(jpeg_encoder)), quality_(quality) {}
+
+CapturePipeline::~CapturePipeline() { stop(); }
+
+void CapturePipeline::enableH264(std::unique_ptr<V4l2H264Encoder> encoder) {
+    h264_encoder_ = std::move(encoder);
+}
+
+void CapturePipeline::enableTiers(std::unique_ptr<JpegEncoder> encoder) {
+    tier_encoder_ = std::move(encoder);
+}
+
+void CapturePipeline::enableCaptureRing(size_t max_bytes, unsigned seconds) {
+    capture_ring_ = std::make_unique<CaptureRing>(max_bytes, uint64_t(seconds) * 1000000000ull);
+}
+
+FrameBroadcaster& CapturePipeline::tier(int t) {
+    if (t <= 0 || t >= TIERS || !tier_encoder_) return mjpeg_;
+    return tier_streams_[t - 1];
+}
+
+void CapturePipeline::addTierViewer(int t) {
+    if (t > 0 && t < TIERS) tier_viewers_[t].fetch_add(1, std::memory_order_relaxed);
+}
+
+void CapturePipeline::removeTierViewer(int t) {
+    if (t > 0 && t < TIERS) tier_viewers_[t].fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool CapturePipeline::wantTiers() const {
+    if (!tier_encoder_) return false;
+    for (int t = 1; t < TIERS; ++t) {
+        if (tier_viewers_[t].load(std::memory_order_relaxed) > 0) return true;
+    }
+    return false;
+}
+
+void CapturePipeline::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    running_ = true;
+    jpeg_lane_.thread = std::thread(&CapturePipeline::jpegLoop, this);
+    if (h264_encoder_) h264_lane_.thread = std::thread(&CapturePipeline::h264Loop, this);
+    if (tier_encoder_) tier_lane_.thread = std::thread(&CapturePipeline::tierLoop, this);
+}
+
+void CapturePipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        jpeg_lane_.pending.reset();
+        h264_lane_.pending.reset();
+        tier_lane_.pending.reset();
+        tier_pending_jpeg_.reset();
+    }
+    cv_.notify_all();
+    if (jpeg_lane_.thread.joinable()) jpeg_lane_.thread.join();
+    if (h264_lane_.thread.joinable()) h264_lane_.thread.join();
+    if (tier_lane_.thread.joinable()) tier_lane_.thread.join();
+    for (FrameBroadcaster& stream : tier_streams_) stream.close();
+}
+
+void CapturePipeline::addH264Viewer() {
+    h264_viewers_.fetch_add(1, std::memory_order_relaxed);
+    requestKeyframe();
+}
+
+void CapturePipeline::removeH264Viewer() {
+    h264_viewers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CapturePipeline::requestKeyframe() {
+    if (!h264_encoder_) return;
+    int64_t now = steadyNs();
+    int64_t last = last_keyframe_request_ns_.load(std::memory_order_relaxed);
+    if (now - last < 250000000) return;
+    if (last_keyframe_request_ns_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        h264_encoder_->requestKeyframe();
+    }
+}
+
+// 按计划时刻抽帧：下一帧应在 next_keep_ns_ 附近，允许提前四分之一个间隔（采集时刻有抖动），
+// 计划按间隔往前推而不是从实际保留的帧算起，平均帧率正好是 1 / interval；落后超过一个间隔（刚开始抽帧或源卡过）就重新对齐
+bool CapturePipeline::skipFrame(uint64_t capture_ns) {
+    uint64_t interval = frame_interval_ns_.load(std::memory_order_relaxed);
+    if (interval == 0) {
+        next_keep_ns_ = 0;
+        return false;
+    }
+    if (next_keep_ns_ && capture_ns + interval / 4 < next_keep_ns_) return true;
+    bool on_schedule = next_keep_ns_ && capture_ns < next_keep_ns_ + interval;
+    next_keep_ns_ = (on_schedule ? next_keep_ns_ : capture_ns) + interval;
+    return false;
+}
+
+void CapturePipeline::onEncoded(std::shared_ptr<EncodedFrame> frame) {
+    if (skipFrame(frame->capture_ns)) return;
+    latency_.record(LatencyStats::Framing, frame->capture_ns, frame->framed_ns);
+    if (shm_ && shm_->hasReaders()) publishShm(*frame);
+    if (capture_ring_) capture_ring_->push(*frame);
+    if (wantTiers()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tier_pending_jpeg_) tier_lane_.dropped++;
+        tier_pending_jpeg_ = frame;
+        cv_.notify_all();
+    }
+    // 广播给所有连接（不等待任何消费者）
+    mjpeg_.publish(std::move(frame));
+}
+
+void CapturePipeline::onRaw(RawFrameRef frame) {
+    if (skipFrame(frame->capture_ns)) return;  // 引用在这里释放，缓冲区立刻还给相机
+    // 本地读者要全帧率：在采集线程里直接拷进共享内存（640x480 BGR 约 0.1 ms），不走只保留最新帧的编码队列
+    if (shm_ && shm_->hasReaders()) publishShm(*frame);
+
+    // 各条编码线程各持有一个引用；旧帧在锁外释放，可能触发把缓冲区还给相机
+    RawFrameRef old_jpeg, old_h264, old_tier;
+    bool want_h264 = h264_encoder_ && h264_viewers_.load(std::memory_order_relaxed) > 0;
+    bool want_tiers = wantTiers() && frame->format == RawPixelFormat::BGR888;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        old_jpeg = std::move(jpeg_lane_.pending);
+        if (old_jpeg) jpeg_lane_.dropped++;
+        if (want_h264) {
+            old_h264 = std::move(h264_lane_.pending);
+            if (old_h264) h264_lane_.dropped++;
+            h264_lane_.pending = frame;
+        }
+        if (want_tiers) {
+            old_tier = std::move(tier_lane_.pending);
+            if (old_tier) tier_lane_.dropped++;
+            tier_lane_.pending = frame;
+        }
+        jpeg_lane_.pending = std::move(frame);
+    }
+    cv_.notify_all();
+}
+
+RawFrameRef CapturePipeline::waitFrame(Lane& lane) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return !running_ || lane.pending; });
+    if (!running_) return RawFrameRef();
+    return std::move(lane.pending);
+}
+
+void CapturePipeline::jpegLoop() {
+    uint64_t encoded = 0;
+    while (RawFrameRef raw = waitFrame(jpeg_lane_)) {
+        auto frame = jpeg_pool_.acquire();
+        if (!frame) continue;  // 所有帧都还被慢连接占着，丢掉这一帧
+
+        frame->seq = raw->seq;
+        frame->capture_ns = raw->capture_ns;
+        frame->framed_ns = raw->framed_ns;
+        bool ok = jpeg_encoder_->encode(*raw, quality_, frame->data);
+        raw.reset();  // 编码完立刻归还缓冲区
+        if (!ok) continue;
+        frame->encoded_ns = uint64_t(steadyNs());
+        // 采集耗时每帧只记一次（JPEG 这一路总是在编码）
+        latency_.record(LatencyStats::Framing, frame->capture_ns, frame->framed_ns);
+        latency_.record(LatencyStats::EncodeJpeg, frame->framed_ns, frame->encoded_ns);
+        if (shm_ && shm_->hasReaders()) publishShm(*frame);
+        if (capture_ring_) capture_ring_->push(*frame);
+
+        mjpeg_.publish(std::move(frame));
+        if (++encoded % 30 == 0) {
+            LOG_I("[CapturePipeline] jpeg frames=" << encoded << " raw_dropped=" << jpeg_lane_.dropped);
+        }
+    }
+}
+
+void CapturePipeline::h264Loop() {
+    uint64_t encoded = 0;
+    while (RawFrameRef raw = waitFrame(h264_lane_)) {
+        auto frame = h264_pool_.acquire();
+        if (!frame) continue;  // 少编一帧不影响码流，编码器只是跳过这一帧输入
+
+        frame->seq = raw->seq;
+        frame->capture_ns = raw->capture_ns;
+        frame->framed_ns = raw->framed_ns;
+        frame->codec = FrameCodec::H264;
+        bool keyframe = false;
+        bool ok = h264_encoder_->encode(*raw, frame->data, keyframe);
+        raw.reset();
+        if (!ok) continue;
+        frame->encoded_ns = uint64_t(steadyNs());
+        latency_.record(LatencyStats::EncodeH264, frame->framed_ns, frame->encoded_ns);
+
+        // 关键帧自带参数集，观众从任意一个 IDR 开始都能解码
+        params_.update(frame->data.data(), frame->data.size());
+        if (keyframe) params_.completeKeyframe(frame->data);
+        frame->keyframe = keyframe;
+
+        h264_.publish(std::move(frame));
+        if (++encoded % 30 == 0) {
+            LOG_I("[CapturePipeline] h264 frames=" << encoded << " raw_dropped=" << h264_lane_.dropped
+                  << " viewers=" << h264_viewers_.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+void CapturePipeline::publishShm(const RawFrame& frame) {
+    ShmRing::FrameInfo info;
+    info.frame_seq = frame.seq;
+    info.capture_ns = frame.capture_ns;
+    info.width = frame.width;
+    info.height = frame.height;
+    info.stride = frame.planes[0].stride;
+    ShmRing::Part parts[3];
+    size_t count;
+    if (frame.format == RawPixelFormat::BGR888) {
+        info.format = ShmRing::PixelFormat::BGR888;
+        parts[0] = {frame.planes[0].data, size_t(frame.planes[0].stride) * frame.height};
+        count = 1;
+    } else {
+        info.format = ShmRing::PixelFormat::I420;
+        parts[0] = {frame.planes[0].data, size_t(frame.planes[0].stride) * frame.height};
+        parts[1] = {frame.planes[1].data, size_t(frame.planes[0].stride / 2) * (frame.height / 2)};
+        parts[2] = {frame.planes[2].data, size_t(frame.planes[0].stride / 2) * (frame.height / 2)};
+        count = 3;
+    }
+    if (!shm_->publish(ShmRing::Stream::Raw, info, parts, count) && !shm_raw_warned_) {
+        shm_raw_warned_ = true;
+        LOG_W("[CapturePipeline] raw frame " << frame.width << "x" << frame.height << " does not fit the shm ring.");
+    }
+}
+
+void CapturePipeline::publishShm(const EncodedFrame& frame) {
+    ShmRing::FrameInfo info;
+    info.frame_seq = frame.seq;
+    info.capture_ns = frame.capture_ns;
+    info.format = ShmRing::PixelFormat::Jpeg;
+    ShmRing::Part part{frame.data.data(), frame.data.size()};
+    shm_->publish(ShmRing::Stream::Jpeg, info, &part, 1);
+}
+
+void CapturePipeline::tierLoop() {
+    uint64_t encoded = 0;
+    while (true) {
+        RawFrameRef raw;
+        FramePtr jpeg;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !running_ || tier_lane_.pending || tier_pending_jpeg_; });
+            if (!running_) break;
+            raw = std::move(tier_lane_.pending);
+            jpeg = std::move(tier_pending_jpeg_);
+        }
+
+        // 原图：原始帧直接包成 Mat（不拷贝）；只有 JPEG 时解码一次（decode() 有缓存）
+        cv::Mat src;
+        uint32_t seq;
+        uint64_t capture_ns, framed_ns, decoded_ns = 0;
+        if (raw) {
+            const RawFrame::Plane& p = raw->planes[0];
+            src = cv::Mat(int(raw->height), int(raw->width), CV_8UC3, const_cast<uint8_t*>(p.data), p.stride);
+            seq = raw->seq;
+            capture_ns = raw->capture_ns;
+            framed_ns = raw->framed_ns;
+        } else {
+            src = jpeg->decode();
+            seq = jpeg->seq;
+            capture_ns = jpeg->capture_ns;
+            framed_ns = jpeg->framed_ns;
+            if (src.empty()) continue;
+            decoded_ns = uint64_t(steadyNs());
+            latency_.record(LatencyStats::Decode, framed_ns, decoded_ns);
+        }
+
+        for (int t = 1; t < TIERS; ++t) {
+            if (tier_viewers_[t].load(std::memory_order_relaxed) <= 0) continue;
+            auto frame = tier_pool_.acquire();
+            if (!frame) continue;
+
+            const cv::Mat* img = &src;
+            if (kTiers[t].divisor > 1) {
+                cv::resize(src, scaled_, cv::Size(src.cols / kTiers[t].divisor, src.rows / kTiers[t].divisor), 0, 0,
+                           cv::INTER_AREA);
+                img = &scaled_;
+            }
+            RawFrame view;
+            view.width = uint32_t(img->cols);
+            view.height = uint32_t(img->rows);
+            view.format = RawPixelFormat::BGR888;
+            view.planes[0].data = img->data;
+            view.planes[0].stride = uint32_t(img->step);
+            view.planes[0].length = img->step * img->rows;
+            view.plane_count = 1;
+
+            frame->seq = seq;
+            frame->capture_ns = capture_ns;
+            frame->framed_ns = framed_ns;
+            frame->decoded_ns = decoded_ns;
+            if (!tier_encoder_->encode(view, kTiers[t].quality, frame->data)) continue;
+            // 降级档位的编码耗时不计入 encode_jpeg，那一项只反映主码流
+            frame->encoded_ns = uint64_t(steadyNs());
+            tier_streams_[t - 1].publish(std::move(frame));
+        }
+        if (++encoded % 30 == 0) {
+            LOG_I("[CapturePipeline] tier frames=" << encoded << " dropped=" << tier_lane_.dropped);
+        }
+    }
+}
+
+std::string CapturePipeline::poolStatsJson() const {
+    const std::pair<const char*, const FramePool*> pools[] = {
+        {"jpeg", &jpeg_pool_}, {"h264", &h264_pool_}, {"tier", &tier_pool_}};
+    std::string out = "{";
+    char buf[160];
+    for (const auto& p : pools) {
+        FramePool::Stats s = p.second->stats();
+        std::snprintf(buf, sizeof(buf), "%s\"%s\":{\"frames\":%zu,\"hits\":%llu,\"misses\":%llu,\"exhausted\":%llu}",
+                      out.size() > 1 ? "," : "", p.first, s.frames, (unsigned long long)s.hits,
+                      (unsigned long long)s.misses, (unsigned long long)s.exhausted);
+        out += buf;
+    }
+    if (capture_ring_) {
+        CaptureRing::Stats s = capture_ring_->stats();
+        std::snprintf(buf, sizeof(buf),
+                      ",\"capture_ring\":{\"frames\":%zu,\"bytes\":%zu,\"span_ms\":%llu,\"evicted\":%llu}", s.frames,
+                      s.bytes, (unsigned long long)(s.span_ns / 1000000), (unsigned long long)s.evicted);
+        out += buf;
+    }
+    out += "}";
+    return out;
+}
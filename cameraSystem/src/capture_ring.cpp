@@ -0,0 +1,101 @@
+#include "../include/capture_ring.hpp"
+#include <cstring>
+
+CaptureRing::CaptureRing(size_t max_bytes, uint64_t max_age_ns, size_t max_frames)
+    : data_(max_bytes), entries_(max_frames ? max_frames : 1), max_age_ns_(max_age_ns) {}
+
+void CaptureRing::popOldest() {
+    bytes_ -= entries_[first_].length;
+    first_ = (first_ + 1) % entries_.size();
+    count_--;
+    evicted_++;
+}
+
+void CaptureRing::push(const EncodedFrame& frame) {
+    size_t len = frame.data.size();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (len == 0 || len > data_.size() / 2) {
+        rejected_++;
+        return;
+    }
+
+    // 数据区里的帧从 write_pos_ 往后（绕回开头）依次从老到新；
+    // 尾部放不下时绕回开头，尾部那段里的帧是最老的，先淘汰
+    if (write_pos_ + len > data_.size()) {
+        while (count_ > 0 && at(0).offset >= write_pos_) popOldest();
+        write_pos_ = 0;
+    }
+    while (count_ > 0) {
+        const Entry& oldest = at(0);
+        bool overlaps = oldest.offset < write_pos_ + len && oldest.offset + oldest.length > write_pos_;
+        bool too_old = frame.capture_ns > oldest.capture_ns && frame.capture_ns - oldest.capture_ns > max_age_ns_;
+        if (!overlaps && !too_old && count_ < entries_.size()) break;
+        popOldest();
+    }
+    if (count_ == 0) write_pos_ = 0;
+
+    std::memcpy(data_.data() + write_pos_, frame.data.data(), len);
+    entries_[(first_ + count_) % entries_.size()] =
+        Entry{write_pos_, len, frame.seq, frame.capture_ns, frame.framed_ns, frame.encoded_ns};
+    count_++;
+    bytes_ += len;
+    write_pos_ += len;
+}
+
+FramePtr CaptureRing::copyOut(const Entry& e) const {
+    auto frame = std::make_shared<EncodedFrame>();
+    frame->seq = e.seq;
+    frame->capture_ns = e.capture_ns;
+    frame->framed_ns = e.framed_ns;
+    frame->encoded_ns = e.encoded_ns;
+    frame->data.assign(data_.begin() + e.offset, data_.begin() + e.offset + e.length);
+    return frame;
+}
+
+std::vector<FramePtr> CaptureRing::collect(uint64_t from_ns, uint64_t until_ns, size_t max_frames,
+                                           uint64_t interval_ns) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 先挑出索引，最后再拷贝数据
+    std::vector<size_t> picked;
+    uint64_t last_ns = 0;
+    for (size_t i = 0; i < count_; ++i) {
+        const Entry& e = at(i);
+        if (e.capture_ns < from_ns) continue;
+        if (e.capture_ns > until_ns) break;
+        if (interval_ns && !picked.empty() && e.capture_ns - last_ns < interval_ns) continue;
+        picked.push_back(i);
+        last_ns = e.capture_ns;
+    }
+    if (picked.empty()) {
+        for (size_t i = count_; i-- > 0;) {
+            if (at(i).capture_ns <= until_ns) {
+                picked.push_back(i);
+                break;
+            }
+        }
+    }
+    if (max_frames && picked.size() > max_frames) {
+        // 均匀抽取，保留首尾
+        std::vector<size_t> thinned(max_frames);
+        for (size_t k = 0; k < max_frames; ++k) {
+            thinned[k] = picked[max_frames == 1 ? 0 : k * (picked.size() - 1) / (max_frames - 1)];
+        }
+        picked.swap(thinned);
+    }
+
+    std::vector<FramePtr> frames;
+    frames.reserve(picked.size());
+    for (size_t i : picked) frames.push_back(copyOut(at(i)));
+    return frames;
+}
+
+CaptureRing::Stats CaptureRing::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.frames = count_;
+    s.bytes = bytes_;
+    s.span_ns = count_ ? at(count_ - 1).capture_ns - at(0).capture_ns : 0;
+    s.evicted = evicted_;
+    s.rejected = rejected_;
+    return s;
+}
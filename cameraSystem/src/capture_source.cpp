@@ -0,0 +1,33 @@
+#include "../include/capture_source.hpp"
+#include "../include/libcamera_source.hpp"
+#include "../include/mjpeg_stream_source.hpp"
+
+// rpicam-vid 命令行：
+// -n: no preview; --codec mjpeg: 输出 MJPEG；--output -: 输出到 stdout；
+// --hflip --vflip: 画面旋转 180°（原来在服务端 cv::flip(-1)），由 ISP 完成，JPEG 可以原样转发。
+static std::string rpicamCommand(const CaptureConfig& c) {
+    std::string cmd = "rpicam-vid -n -t 0 --codec mjpeg";
+    cmd += " --width " + std::to_string(c.width);
+    cmd += " --height " + std::to_string(c.height);
+    cmd += " --framerate " + std::to_string(c.fps);
+    cmd += " --quality " + std::to_string(c.quality);
+    if (c.rotate180) cmd += " --hflip --vflip";
+    cmd += " --output -";
+    return cmd;
+}
+
+std::unique_ptr<CaptureSource> makeCaptureSource(const std::string& spec, const CaptureConfig& config) {
+    if (spec == "libcamera") {
+        return std::make_unique<LibcameraSource>(config);
+    }
+    if (spec == "rpicam") {
+        return std::make_unique<MjpegStreamSource>(MjpegStreamSource::Mode::Command, rpicamCommand(config));
+    }
+    if (spec.rfind("file:", 0) == 0) {
+        return std::make_unique<MjpegStreamSource>(MjpegStreamSource::Mode::File, spec.substr(5), config.fps);
+    }
+    if (spec.rfind("pipe:", 0) == 0) {
+        return std::make_unique<MjpegStreamSource>(MjpegStreamSource::Mode::Pipe, spec.substr(5));
+    }
+    return nullptr;
+}
@@ -0,0 +1,41 @@
+#include "../include/client_stats.hpp"
+#include <algorithm>
+#include <cstdio>
+
+std::shared_ptr<ClientStats> ClientRegistry::add(const std::string& peer) {
+    auto stats = std::make_shared<ClientStats>();
+    stats->peer = peer;
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.push_back(stats);
+    return stats;
+}
+
+void ClientRegistry::remove(const std::shared_ptr<ClientStats>& stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.erase(std::remove(clients_.begin(), clients_.end(), stats), clients_.end());
+}
+
+void ClientRegistry::update(const std::shared_ptr<ClientStats>& slot, const ClientStats& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    *slot = value;
+}
+
+std::string ClientRegistry::toJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out = "[";
+    char buf[512];
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        const ClientStats& c = *clients_[i];
+        std::snprintf(buf, sizeof(buf),
+                      "%s{\"peer\":\"%s\",\"codec\":\"%s\",\"tier\":%d,\"sent\":%llu,\"skipped\":%llu,"
+                      "\"dropped\":%llu,\"bytes\":%llu,\"rate_kbps\":%.0f,\"rtt_ms\":%.1f,\"outq\":%u,"
+                      "\"queue_ms\":%.1f,\"latency_ms\":%.1f,\"skip_ratio\":%.3f}",
+                      i ? "," : "", c.peer.c_str(), c.codec.c_str(), c.cc.tier, (unsigned long long)c.cc.sent,
+                      (unsigned long long)c.cc.skipped, (unsigned long long)c.broadcaster_dropped,
+                      (unsigned long long)c.bytes, c.cc.rate_bps * 8 / 1000, c.cc.rtt_us / 1000.0, c.cc.outq_bytes,
+                      c.cc.queue_ms, c.cc.latency_ms, c.cc.skip_ratio);
+        out += buf;
+    }
+    out += "]";
+    return out;
+}
@@ -0,0 +1,92 @@
+#include "../include/congestion.hpp"
+#include <cstddef>
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+bool probeTcp(int fd, TcpSample& sample) {
+    int outq = 0;
+    if (ioctl(fd, SIOCOUTQ, &outq) < 0) return false;
+    // 用 linux/tcp.h 的 tcp_info：glibc 的版本里没有 delivery_rate；老内核填不满的字段保持 0
+    tcp_info info{};
+    socklen_t len = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) return false;
+    sample.outq_bytes = outq > 0 ? uint32_t(outq) : 0;
+    sample.rtt_us = info.tcpi_rtt;
+    sample.delivery_rate = len > offsetof(tcp_info, tcpi_delivery_rate) ? info.tcpi_delivery_rate : 0;
+    return true;
+}
+
+CongestionController::CongestionController() : CongestionController(Config()) {}
+
+CongestionController::CongestionController(const Config& config) : config_(config) {}
+
+void CongestionController::updateRate(const TcpSample& sample, uint64_t now_ns) {
+    // 已确认字节 = 交给内核的字节 - 还在发送队列里的字节
+    uint64_t acked = bytes_sent_ > sample.outq_bytes ? bytes_sent_ - sample.outq_bytes : 0;
+    if (last_sample_ns_ == 0 || acked < last_acked_) {
+        // 第一次采样；或者计数对不上（不该发生），丢掉这次，从当前值重新开始，不让无符号减法回绕
+        last_sample_ns_ = now_ns;
+        last_acked_ = acked;
+    } else if (now_ns - last_sample_ns_ >= 50000000ull) {
+        double dt = (now_ns - last_sample_ns_) * 1e-9;
+        double rate = (acked - last_acked_) / dt;
+        // 队列空着时链路没被占满，测到的只是发送量，不能当作带宽下调估计
+        if (sample.outq_bytes > 0 || rate > own_rate_) own_rate_ = own_rate_ == 0 ? rate : 0.8 * own_rate_ + 0.2 * rate;
+        last_sample_ns_ = now_ns;
+        last_acked_ = acked;
+    }
+    double rate = sample.delivery_rate > 0 ? double(sample.delivery_rate) : own_rate_;
+    stats_.rate_bps = rate < 10000 ? 10000 : rate;  // 留个下限，刚建立连接时不至于除以 0
+    stats_.rtt_us = sample.rtt_us;
+    stats_.outq_bytes = sample.outq_bytes;
+    stats_.queue_ms = sample.outq_bytes * 1000.0 / stats_.rate_bps;
+}
+
+bool CongestionController::shouldSend(const TcpSample& sample, size_t frame_bytes, uint64_t capture_ns,
+                                      uint64_t now_ns) {
+    updateRate(sample, now_ns);
+    if (window_start_ns_ == 0) window_start_ns_ = now_ns;
+
+    // 这一帧发出去之后客户端收完它时的"年龄"：已经过去的时间 + 排队 + 自身传输 + 半个 RTT
+    double age_ms = now_ns > capture_ns ? (now_ns - capture_ns) * 1e-6 : 0;
+    double predicted = age_ms + stats_.queue_ms + frame_bytes * 1000.0 / stats_.rate_bps + stats_.rtt_us / 2000.0;
+
+    bool send = sample.outq_bytes == 0 || predicted <= config_.target_latency_ms;
+    if (send) {
+        stats_.latency_ms = stats_.latency_ms == 0 ? predicted : 0.8 * stats_.latency_ms + 0.2 * predicted;
+        window_sent_++;
+    } else {
+        stats_.skipped++;
+        window_skipped_++;
+    }
+
+    if ((now_ns - window_start_ns_) * 1e-9 >= config_.window_s) {
+        endWindow();
+        window_start_ns_ = now_ns;
+    }
+    return send;
+}
+
+void CongestionController::endWindow() {
+    uint32_t total = window_sent_ + window_skipped_;
+    stats_.skip_ratio = total ? double(window_skipped_) / total : 0;
+    window_sent_ = window_skipped_ = 0;
+
+    bool congested = stats_.skip_ratio > 0.3 || stats_.latency_ms > config_.target_latency_ms;
+    bool relaxed = stats_.skip_ratio < 0.05 && stats_.latency_ms < config_.target_latency_ms * 0.5;
+    if (congested) {
+        good_windows_ = 0;
+        if (stats_.tier + 1 < config_.tiers) stats_.tier++;
+    } else if (relaxed && stats_.tier > 0) {
+        // 升档要连续 3 个窗口都宽裕，降档一个窗口就够：宁可画质保守也不要卡顿
+        if (++good_windows_ >= 3) {
+            good_windows_ = 0;
+            stats_.tier--;
+        }
+    } else {
+        good_windows_ = 0;
+    }
+}
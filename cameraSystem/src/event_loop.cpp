@@ -0,0 +1,105 @@
+#include "../include/event_loop.hpp"
+#include "../include/log.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static uint64_t monotonicMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000ull + uint64_t(ts.tv_nsec) / 1000000ull;
+}
+
+EventLoop::EventLoop() {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ < 0 || wakefd_ < 0) {
+        LOG_E("[EventLoop] setup failed: " << strerror(errno));
+        return;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = uint64_t(uint32_t(wakefd_));
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+}
+
+EventLoop::~EventLoop() {
+    if (wakefd_ >= 0) ::close(wakefd_);
+    if (epfd_ >= 0) ::close(epfd_);
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler handler) {
+    uint32_t gen = next_gen_++;
+    if (next_gen_ == 0) next_gen_ = 1;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = (uint64_t(gen) << 32) | uint32_t(fd);
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+    handlers_[fd] = Entry{gen, std::make_shared<Handler>(std::move(handler))};
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end()) return false;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = (uint64_t(it->second.gen) << 32) | uint32_t(fd);
+    return epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    if (handlers_.erase(fd)) epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void EventLoop::wake() {
+    uint64_t one = 1;
+    ssize_t n = ::write(wakefd_, &one, sizeof(one));
+    (void)n;  // 计数器满了（EAGAIN）说明已经有一次唤醒在排队
+}
+
+void EventLoop::run(int tick_ms, const std::function<void()>& on_wake, const std::function<void()>& on_tick) {
+    running_ = true;
+    epoll_event events[64];
+    uint64_t last_tick = monotonicMs();
+    while (running_) {
+        int n = epoll_wait(epfd_, events, 64, tick_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_E("[EventLoop] epoll_wait: " << strerror(errno));
+            break;
+        }
+        bool woke = false;
+        for (int i = 0; i < n; ++i) {
+            int fd = int(uint32_t(events[i].data.u64));
+            uint32_t gen = uint32_t(events[i].data.u64 >> 32);
+            if (gen == 0 && fd == wakefd_) {
+                uint64_t count;
+                ssize_t r = ::read(wakefd_, &count, sizeof(count));
+                (void)r;
+                woke = true;
+                continue;
+            }
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end() || it->second.gen != gen) continue;
+            // 持有一份引用：处理函数可能在里面把自己 remove 掉
+            std::shared_ptr<Handler> handler = it->second.handler;
+            (*handler)(events[i].events);
+        }
+        if (woke && on_wake) on_wake();
+
+        uint64_t now = monotonicMs();
+        if (now - last_tick >= uint64_t(tick_ms)) {
+            last_tick = now;
+            if (on_tick) on_tick();
+        }
+    }
+}
+
+void EventLoop::stop() {
+    running_ = false;
+    wake();
+}
@@ -0,0 +1,26 @@
+#include "../include/frame.hpp"
+#include <opencv2/imgcodecs.hpp>
+
+cv::Mat EncodedFrame::decode() const {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    if (!decoded_valid_) {
+        // 解码进上次留下的缓冲（尺寸不变时 imdecode 不重新分配像素内存）
+        cv::imdecode(data, cv::IMREAD_COLOR, &decoded_);
+        decoded_valid_ = true;
+    }
+    return decoded_;
+}
+
+void EncodedFrame::reset() {
+    seq = 0;
+    capture_ns = 0;
+    framed_ns = 0;
+    decoded_ns = 0;
+    encoded_ns = 0;
+    codec = FrameCodec::Jpeg;
+    keyframe = true;
+    data.clear();
+    decoded_valid_ = false;
+    // 还有人拿着上次 decode() 的 Mat 时不能复用它的像素缓冲，放手让对方独占
+    if (decoded_.u && decoded_.u->refcount > 1) decoded_.release();
+}
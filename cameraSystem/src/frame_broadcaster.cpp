@@ -0,0 +1,83 @@
+#include "../include/frame_broadcaster.hpp"
+
+FrameBroadcaster::FrameBroadcaster(size_t capacity, size_t max_lag)
+    : slots_(capacity == 0 ? 1 : capacity),
+      max_lag_(max_lag < slots_.size() ? max_lag : slots_.size() - 1) {}
+
+void FrameBroadcaster::publish(FramePtr frame) {
+    FramePtr old;
+    std::shared_ptr<const Listeners> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 被覆盖的旧帧在锁外释放（可能是最后一个引用）
+        old = std::move(slots_[seq_ % slots_.size()]);
+        slots_[seq_ % slots_.size()] = std::move(frame);
+        ++seq_;
+        listeners = listeners_;
+    }
+    cv_.notify_all();
+    if (listeners) {
+        for (const auto& listener : *listeners) listener();
+    }
+}
+
+FramePtr FrameBroadcaster::next(Cursor& cursor, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [&] { return closed_ || seq_ > cursor.next_seq; })) {
+        return nullptr;
+    }
+    if (closed_) return nullptr;
+    return take(cursor);
+}
+
+FramePtr FrameBroadcaster::tryNext(Cursor& cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || seq_ <= cursor.next_seq) return nullptr;
+    return take(cursor);
+}
+
+void FrameBroadcaster::addListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto next = listeners_ ? std::make_shared<Listeners>(*listeners_) : std::make_shared<Listeners>();
+    next->push_back(std::move(listener));
+    listeners_ = std::move(next);
+}
+
+FramePtr FrameBroadcaster::take(Cursor& cursor) {
+    // 落后超过 max_lag 帧：跳到最新帧，中间的都算丢弃
+    uint64_t newest = seq_ - 1;
+    if (newest - cursor.next_seq > max_lag_) {
+        cursor.dropped += newest - cursor.next_seq;
+        cursor.next_seq = newest;
+    }
+    FramePtr frame = slots_[cursor.next_seq % slots_.size()];
+    ++cursor.next_seq;
+    ++cursor.delivered;
+    return frame;
+}
+
+FrameBroadcaster::Cursor FrameBroadcaster::subscribe() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Cursor cursor;
+    cursor.next_seq = seq_;
+    return cursor;
+}
+
+FramePtr FrameBroadcaster::latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (seq_ == 0) return nullptr;
+    return slots_[(seq_ - 1) % slots_.size()];
+}
+
+uint64_t FrameBroadcaster::published() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return seq_;
+}
+
+void FrameBroadcaster::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
@@ -0,0 +1,48 @@
+#include "../include/frame_pool.hpp"
+#include <atomic>
+
+static std::shared_ptr<EncodedFrame> makeFrame(size_t frame_bytes) {
+    auto frame = std::make_shared<EncodedFrame>();
+    frame->data.reserve(frame_bytes);
+    return frame;
+}
+
+FramePool::FramePool(size_t initial, size_t max_frames, size_t frame_bytes)
+    : max_frames_(max_frames < initial ? initial : max_frames), frame_bytes_(frame_bytes) {
+    frames_.reserve(max_frames_);
+    for (size_t i = 0; i < initial; ++i) frames_.push_back(makeFrame(frame_bytes_));
+    size_.store(frames_.size(), std::memory_order_relaxed);
+}
+
+std::shared_ptr<EncodedFrame> FramePool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t n = 0; n < frames_.size(); ++n) {
+        size_t i = (next_ + n) % frames_.size();
+        // 只有池子持有时别人不可能再拿到新引用，use_count() == 1 的判断是稳定的；
+        // acquire 栅栏保证看到上一个使用者对帧的所有读写都已结束
+        if (frames_[i].use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            next_ = (i + 1) % frames_.size();
+            frames_[i]->reset();
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return frames_[i];
+        }
+    }
+    if (frames_.size() < max_frames_) {
+        frames_.push_back(makeFrame(frame_bytes_));
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        size_.store(frames_.size(), std::memory_order_relaxed);
+        return frames_.back();
+    }
+    exhausted_.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+FramePool::Stats FramePool::stats() const {
+    Stats s;
+    s.hits = hits_.load(std::memory_order_relaxed);
+    s.misses = misses_.load(std::memory_order_relaxed);
+    s.exhausted = exhausted_.load(std::memory_order_relaxed);
+    s.frames = size_.load(std::memory_order_relaxed);
+    return s;
+}
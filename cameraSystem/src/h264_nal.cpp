@@ -0,0 +1,41 @@
+#include "../include/h264_nal.hpp"
+
+namespace H264 {
+
+bool containsPicture(const uint8_t* data, size_t len) {
+    bool found = false;
+    forEachNal(data, len, [&](const Nal& nal) {
+        uint8_t t = nal.type();
+        if (t >= NAL_SLICE && t <= NAL_IDR) found = true;
+    });
+    return found;
+}
+
+bool isKeyframe(const uint8_t* data, size_t len) {
+    bool found = false;
+    forEachNal(data, len, [&](const Nal& nal) {
+        if (nal.type() == NAL_IDR) found = true;
+    });
+    return found;
+}
+
+void ParamCache::update(const uint8_t* data, size_t len) {
+    forEachNal(data, len, [&](const Nal& nal) {
+        if (nal.type() == NAL_SPS) sps_.assign(nal.start, nal.start + nal.size);
+        if (nal.type() == NAL_PPS) pps_.assign(nal.start, nal.start + nal.size);
+    });
+}
+
+void ParamCache::completeKeyframe(std::vector<uint8_t>& au) const {
+    if (!ready()) return;
+    bool has_sps = false, has_pps = false;
+    forEachNal(au.data(), au.size(), [&](const Nal& nal) {
+        if (nal.type() == NAL_SPS) has_sps = true;
+        if (nal.type() == NAL_PPS) has_pps = true;
+    });
+    // 先插 PPS 再插 SPS，最终顺序是 SPS、PPS、图像；帧缓冲有预留容量，只是原地搬移
+    if (!has_pps) au.insert(au.begin(), pps_.begin(), pps_.end());
+    if (!has_sps) au.insert(au.begin(), sps_.begin(), sps_.end());
+}
+
+}  // namespace H264
@@ -0,0 +1,97 @@
+#include "../include/jpeg_encoder.hpp"
+#include "../include/v4l2_jpeg_encoder.hpp"
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+// ========== OpenCV（总是可用的兜底实现） ==========
+class OpenCvJpegEncoder : public JpegEncoder {
+public:
+    const char* name() const override { return "opencv"; }
+
+    bool encode(const RawFrame& frame, int quality, std::vector<uint8_t>& out) override {
+        params_[1] = quality;
+        const RawFrame::Plane& p0 = frame.planes[0];
+        if (frame.format == RawPixelFormat::BGR888) {
+            cv::Mat bgr(int(frame.height), int(frame.width), CV_8UC3, const_cast<uint8_t*>(p0.data), p0.stride);
+            return cv::imencode(".jpg", bgr, out, params_);
+        }
+        // imencode 只收 BGR：I420 先转换（要求三个平面连续且没有行填充）
+        cv::Mat yuv(int(frame.height * 3 / 2), int(frame.width), CV_8UC1, const_cast<uint8_t*>(p0.data));
+        cv::cvtColor(yuv, bgr_, cv::COLOR_YUV2BGR_I420);
+        return cv::imencode(".jpg", bgr_, out, params_);
+    }
+
+private:
+    std::vector<int> params_ = {cv::IMWRITE_JPEG_QUALITY, 80};
+    cv::Mat bgr_;
+};
+
+#ifdef HAVE_TURBOJPEG
+// ========== libjpeg-turbo ==========
+// tjhandle 只创建一次；输出缓冲区按 tjBufSize() 预分配，用 TJFLAG_NOREALLOC 让库直接写进去，每帧不分配
+class TurboJpegEncoder : public JpegEncoder {
+public:
+    TurboJpegEncoder() : handle_(tjInitCompress()) {}
+    ~TurboJpegEncoder() override {
+        if (handle_) tjDestroy(handle_);
+    }
+
+    bool ok() const { return handle_ != nullptr; }
+    const char* name() const override { return "turbojpeg"; }
+
+    bool encode(const RawFrame& frame, int quality, std::vector<uint8_t>& out) override {
+        unsigned long bound = tjBufSize(int(frame.width), int(frame.height), TJSAMP_420);
+        if (buffer_.size() < bound) buffer_.resize(bound);
+        unsigned char* dst = buffer_.data();
+        unsigned long size = bound;
+        int rc;
+        if (frame.format == RawPixelFormat::BGR888) {
+            const RawFrame::Plane& p = frame.planes[0];
+            rc = tjCompress2(handle_, p.data, int(frame.width), int(p.stride), int(frame.height), TJPF_BGR,
+                             &dst, &size, TJSAMP_420, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT);
+        } else {
+            const unsigned char* planes[3] = {frame.planes[0].data, frame.planes[1].data, frame.planes[2].data};
+            int strides[3] = {int(frame.planes[0].stride), int(frame.planes[1].stride), int(frame.planes[2].stride)};
+            rc = tjCompressFromYUVPlanes(handle_, planes, int(frame.width), strides, int(frame.height), TJSAMP_420,
+                                         &dst, &size, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT);
+        }
+        if (rc != 0) return false;
+        out.assign(dst, dst + size);
+        return true;
+    }
+
+private:
+    tjhandle handle_;
+    std::vector<unsigned char> buffer_;
+};
+#endif
+
+std::unique_ptr<JpegEncoder> makeJpegEncoder(const std::string& backend) {
+    if (backend == "v4l2" || backend == "auto") {
+        auto enc = std::make_unique<V4l2JpegEncoder>();
+        if (enc->open()) return enc;
+        if (backend == "v4l2") return nullptr;
+    }
+#ifdef HAVE_TURBOJPEG
+    if (backend == "turbojpeg" || backend == "auto") {
+        auto enc = std::make_unique<TurboJpegEncoder>();
+        if (enc->ok()) return enc;
+        if (backend == "turbojpeg") return nullptr;
+    }
+#endif
+    if (backend == "opencv" || backend == "auto") {
+        return std::make_unique<OpenCvJpegEncoder>();
+    }
+    return nullptr;
+}
+
+std::vector<std::string> availableJpegEncoders() {
+    std::vector<std::string> names;
+    for (const char* n : {"v4l2", "turbojpeg", "opencv"}) {
+        if (makeJpegEncoder(n)) names.emplace_back(n);
+    }
+    return names;
+}
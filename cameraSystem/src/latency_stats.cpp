@@ -0,0 +1,73 @@
+#include "../include/latency_stats.hpp"
+#include <cstdio>
+
+int LatencyHistogram::bucketOf(uint64_t us) {
+    if (us < uint64_t(SUB)) return int(us);
+    int exp = 63 - __builtin_clzll(us);
+    if (exp > MAX_EXP) return BUCKETS - 1;
+    int sub = int(us >> (exp - SUB_BITS)) & (SUB - 1);
+    return (exp - SUB_BITS + 1) * SUB + sub;
+}
+
+uint64_t LatencyHistogram::bucketLow(int index) {
+    if (index < SUB) return uint64_t(index);
+    int exp = index / SUB + SUB_BITS - 1;
+    return uint64_t(SUB + index % SUB) << (exp - SUB_BITS);
+}
+
+uint64_t LatencyHistogram::bucketHigh(int index) {
+    if (index < SUB) return uint64_t(index) + 1;
+    int exp = index / SUB + SUB_BITS - 1;
+    return bucketLow(index) + (uint64_t(1) << (exp - SUB_BITS));
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const {
+    // 先拷一份计数，百分位都按这份快照算
+    uint64_t counts[BUCKETS];
+    uint64_t count = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        counts[i] = counts_[i].load(std::memory_order_relaxed);
+        count += counts[i];
+    }
+    Summary s;
+    s.count = count;
+    s.max_us = max_.load(std::memory_order_relaxed);
+    if (count == 0) return s;
+    s.mean_us = double(sum_.load(std::memory_order_relaxed)) / double(total_.load(std::memory_order_relaxed));
+
+    const double quantiles[3] = {0.5, 0.9, 0.99};
+    uint64_t* out[3] = {&s.p50_us, &s.p90_us, &s.p99_us};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < BUCKETS && q < 3; ++i) {
+        seen += counts[i];
+        while (q < 3 && seen >= uint64_t(quantiles[q] * double(count) + 0.5) && seen > 0) {
+            // 取桶的中点，不超过实际最大值
+            uint64_t mid = (bucketLow(i) + bucketHigh(i)) / 2;
+            *out[q++] = mid < s.max_us ? mid : s.max_us;
+        }
+    }
+    return s;
+}
+
+const char* LatencyStats::stageName(Stage stage) {
+    static const char* const names[STAGE_COUNT] = {"framing", "decode", "encode_jpeg", "encode_h264",
+                                                   "queue", "send", "total"};
+    return names[stage];
+}
+
+std::string LatencyStats::toJson() const {
+    std::string out = "{";
+    char buf[256];
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        LatencyHistogram::Summary s = stages_[i].summary();
+        std::snprintf(buf, sizeof(buf),
+                      "%s\"%s\":{\"count\":%llu,\"mean_ms\":%.2f,\"p50_ms\":%.2f,\"p90_ms\":%.2f,\"p99_ms\":%.2f,"
+                      "\"max_ms\":%.2f}",
+                      i ? "," : "", stageName(Stage(i)), (unsigned long long)s.count, s.mean_us / 1000.0,
+                      s.p50_us / 1000.0, s.p90_us / 1000.0, s.p99_us / 1000.0, s.max_us / 1000.0);
+        out += buf;
+    }
+    out += "}";
+    return out;
+}
@@ -0,0 +1,241 @@
+#include "../include/libcamera_source.hpp"
+#include "../include/log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <ctime>
+#include <sys/mman.h>
+
+using namespace libcamera;
+
+LibcameraSource::LibcameraSource(const CaptureConfig& config) : config_(config) {}
+
+LibcameraSource::~LibcameraSource() { stop(); }
+
+bool LibcameraSource::start(FrameSink& sink) {
+    if (running_) return true;
+    sink_ = &sink;
+    if (!setup()) {
+        teardown();
+        return false;
+    }
+    running_ = true;
+
+    // 帧率固定：最短、最长帧间隔都设成 1/fps
+    ControlList controls;
+    int64_t frame_us = 1000000 / (config_.fps ? config_.fps : 20);
+    controls.set(controls::FrameDurationLimits, Span<const int64_t, 2>({frame_us, frame_us}));
+    if (camera_->start(&controls) < 0) {
+        LOG_E("[libcamera] failed to start camera.");
+        running_ = false;
+        teardown();
+        return false;
+    }
+    started_ = true;
+
+    for (auto& slot : slots_) {
+        if (camera_->queueRequest(slot->request.get()) < 0) {
+            LOG_E("[libcamera] failed to queue request.");
+            stop();
+            return false;
+        }
+    }
+    LOG_I("[libcamera] streaming " << camera_config_->at(0).toString() << " from " << camera_->id());
+    return true;
+}
+
+bool LibcameraSource::setup() {
+    manager_ = std::make_unique<CameraManager>();
+    if (manager_->start()) {
+        LOG_E("[libcamera] camera manager failed to start.");
+        manager_.reset();
+        return false;
+    }
+    auto cameras = manager_->cameras();
+    if (cameras.empty()) {
+        LOG_E("[libcamera] no cameras found.");
+        return false;
+    }
+    camera_ = cameras[0];
+    if (camera_->acquire()) {
+        LOG_E("[libcamera] failed to acquire camera.");
+        return false;
+    }
+    acquired_ = true;
+
+    camera_config_ = camera_->generateConfiguration({StreamRole::VideoRecording});
+    if (!camera_config_) {
+        LOG_E("[libcamera] failed to generate configuration.");
+        return false;
+    }
+    StreamConfiguration& sc = camera_config_->at(0);
+    sc.pixelFormat = formats::RGB888;
+    sc.size.width = config_.width;
+    sc.size.height = config_.height;
+    sc.bufferCount = 6;
+    if (config_.rotate180) camera_config_->orientation = Orientation::Rotate180;
+
+    CameraConfiguration::Status status = camera_config_->validate();
+    if (status == CameraConfiguration::Invalid || sc.pixelFormat != formats::RGB888) {
+        LOG_E("[libcamera] RGB888 " << config_.width << "x" << config_.height << " not supported.");
+        return false;
+    }
+    if (status == CameraConfiguration::Adjusted) {
+        LOG_W("[libcamera] configuration adjusted to " << sc.toString());
+    }
+    if (camera_->configure(camera_config_.get()) < 0) {
+        LOG_E("[libcamera] failed to configure camera.");
+        return false;
+    }
+    stream_ = sc.stream();
+
+    allocator_ = std::make_unique<FrameBufferAllocator>(camera_);
+    if (allocator_->allocate(stream_) < 0) {
+        LOG_E("[libcamera] failed to allocate buffers.");
+        return false;
+    }
+    if (!mapBuffers()) return false;
+
+    camera_->requestCompleted.connect(this, &LibcameraSource::requestComplete);
+    return true;
+}
+
+bool LibcameraSource::mapBuffers() {
+    const StreamConfiguration& sc = camera_config_->at(0);
+    const auto& buffers = allocator_->buffers(stream_);
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        FrameBuffer* buffer = buffers[i].get();
+
+        // 同一个 dmabuf 上可能有多个平面：每个 fd 只映射一次，长度覆盖所有平面
+        std::map<int, size_t> lengths;
+        for (const FrameBuffer::Plane& plane : buffer->planes()) {
+            size_t end = size_t(plane.offset) + plane.length;
+            size_t& len = lengths[plane.fd.get()];
+            if (end > len) len = end;
+        }
+        std::map<int, const uint8_t*> bases;
+        for (const auto& [fd, len] : lengths) {
+            void* p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                LOG_E("[libcamera] mmap failed.");
+                return false;
+            }
+            mappings_.emplace_back(p, len);
+            bases[fd] = static_cast<const uint8_t*>(p);
+        }
+
+        auto slot = std::make_unique<Slot>();
+        slot->buffer = buffer;
+        slot->request = camera_->createRequest(i);
+        if (!slot->request || slot->request->addBuffer(stream_, buffer) < 0) {
+            LOG_E("[libcamera] failed to create request.");
+            return false;
+        }
+
+        RawFrame& f = slot->frame;
+        f.width = sc.size.width;
+        f.height = sc.size.height;
+        f.format = RawPixelFormat::BGR888;
+        f.plane_count = unsigned(std::min<size_t>(buffer->planes().size(), 3));
+        for (unsigned p = 0; p < f.plane_count; ++p) {
+            const FrameBuffer::Plane& plane = buffer->planes()[p];
+            f.planes[p].data = bases[plane.fd.get()] + plane.offset;
+            f.planes[p].stride = sc.stride;
+        }
+        f.owner = this;
+        f.cookie = slot.get();
+        slots_.push_back(std::move(slot));
+    }
+    return true;
+}
+
+void LibcameraSource::requestComplete(Request* request) {
+    if (request->status() == Request::RequestCancelled || !running_) return;
+
+    Slot* slot = slots_[request->cookie()].get();
+    const FrameMetadata& meta = slot->buffer->metadata();
+    if (meta.status != FrameMetadata::FrameSuccess) {
+        // 坏帧不交给 sink，直接重新排队
+        requeue(request);
+        return;
+    }
+
+    RawFrame& f = slot->frame;
+    f.seq = meta.sequence;
+    f.capture_ns = meta.timestamp;
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    f.framed_ns = uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    unsigned p = 0;
+    for (const FrameMetadata::Plane& mp : meta.planes()) {
+        if (p >= f.plane_count) break;
+        f.planes[p++].length = mp.bytesused;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_++;
+    }
+    // sink 可能直接丢掉引用，此时 recycle() 会在这里同步执行
+    sink_->onRaw(RawFrameRef(&f));
+}
+
+void LibcameraSource::recycle(RawFrame* frame) {
+    Slot* slot = static_cast<Slot*>(frame->cookie);
+    if (running_) requeue(slot->request.get());
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--outstanding_ == 0) idle_cv_.notify_all();
+}
+
+void LibcameraSource::requeue(Request* request) {
+    request->reuse(Request::ReuseBuffers);
+    // 帧率变化跟着下一个排队的 Request 下发，之后的 Request 不带控制项，相机保持新帧率
+    int64_t frame_us = pending_frame_us_.exchange(0);
+    if (frame_us) request->controls().set(controls::FrameDurationLimits, Span<const int64_t, 2>({frame_us, frame_us}));
+    camera_->queueRequest(request);
+}
+
+bool LibcameraSource::setFrameRate(unsigned fps) {
+    if (!running_ || fps == 0) return false;
+    pending_frame_us_ = 1000000 / fps;
+    return true;
+}
+
+void LibcameraSource::stop() {
+    if (!running_ && !acquired_ && !manager_) return;
+    running_ = false;
+    if (started_) {
+        camera_->stop();  // 等待在途的 Request 完成（以 RequestCancelled 返回）
+        started_ = false;
+    }
+    {
+        // 消费者手里的帧还指向映射区，等它们都释放后再拆
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!idle_cv_.wait_for(lock, std::chrono::seconds(2), [this] { return outstanding_ == 0; })) {
+            LOG_W("[libcamera] waiting for " << outstanding_ << " frames still held by consumers...");
+            idle_cv_.wait(lock, [this] { return outstanding_ == 0; });
+        }
+    }
+    teardown();
+}
+
+void LibcameraSource::teardown() {
+    if (camera_) camera_->requestCompleted.disconnect(this);
+    slots_.clear();
+    for (auto& [p, len] : mappings_) munmap(p, len);
+    mappings_.clear();
+    if (allocator_ && stream_) allocator_->free(stream_);
+    allocator_.reset();
+    stream_ = nullptr;
+    camera_config_.reset();
+    if (acquired_) {
+        camera_->release();
+        acquired_ = false;
+    }
+    camera_.reset();
+    if (manager_) {
+        manager_->stop();
+        manager_.reset();
+    }
+}
@@ -0,0 +1,312 @@
+// MJPEG 切帧回放/压测工具：离线读入一段 MJPEG 码流，按管道读取的块大小喂给切帧器，
+// 校验每帧的 SOI/EOI，并和旧的 std::search + erase 切帧方式对比吞吐。
+// 最后按服务端的路径（切帧器 -> 缓冲池 -> 广播器 -> 连接取帧）再跑一遍，统计稳态下每帧的堆分配次数，
+// 加 decode 参数时每帧再解码一次（EncodedFrame::decode，像素缓冲随帧复用）。
+// 分配预算（超出时退出码为 3）：不解码时稳态每帧 0 次分配（kMaxAllocsPerFrame）；
+// 解码时 OpenCV/libjpeg 每次调用都会分配自己的解码器状态，次数不归我们管，只要求像素缓冲不重新分配：
+// 每帧申请的字节数低于一帧解码图像的一半。
+//
+// 每次运行先做一遍确定性的切帧自检（不需要输入文件）：合成一段含干扰的码流，按随机块大小喂给切帧器，
+// 输出的帧数和每帧字节必须和预期完全一致，否则退出码为 2。
+//
+// 生成测试码流：
+//   ffmpeg -i test1.mp4 -c:v mjpeg -q:v 5 -f mjpeg test1.mjpeg
+// 运行：
+//   ./mjpeg_bench                 # 只做切帧自检
+//   ./mjpeg_bench test1.mjpeg [chunk_bytes=65536] [repeat=20] [decode]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include "../include/alloc_counter.hpp"
+#include "../include/frame_broadcaster.hpp"
+#include "../include/frame_pool.hpp"
+#include "../include/mjpeg_framer.hpp"
+
+static const double kMaxAllocsPerFrame = 0;  // 服务端路径（切帧器 -> 缓冲池 -> 广播器 -> 连接取帧）稳态预算
+
+static const uint8_t kSOI[2] = {0xFF, 0xD8};
+static const uint8_t kEOI[2] = {0xFF, 0xD9};
+
+// 原来 RpiCamMjpegReader 里的切帧逻辑（4KB fread + 每次从头 std::search + erase + 整帧拷贝）
+static size_t legacySplit(const std::vector<uint8_t>& data, size_t& bytes_out) {
+    const size_t CHUNK = 4096;
+    std::vector<uint8_t> buffer;
+    buffer.reserve(1 << 20);
+    size_t frames = 0;
+    for (size_t off = 0; off < data.size(); off += CHUNK) {
+        size_t n = std::min(CHUNK, data.size() - off);
+        buffer.insert(buffer.end(), data.begin() + off, data.begin() + off + n);
+        size_t searchStart = 0;
+        while (true) {
+            auto itSOI = std::search(buffer.begin() + searchStart, buffer.end(), kSOI, kSOI + 2);
+            if (itSOI == buffer.end()) {
+                if (buffer.size() > 2 * CHUNK) buffer.erase(buffer.begin(), buffer.end() - 2 * CHUNK);
+                break;
+            }
+            auto itEOI = std::search(itSOI + 2, buffer.end(), kEOI, kEOI + 2);
+            if (itEOI == buffer.end()) {
+                searchStart = std::distance(buffer.begin(), itSOI);
+                break;
+            }
+            itEOI += 2;
+            std::vector<uint8_t> frame(itSOI, itEOI);
+            bytes_out += frame.size();
+            buffer.erase(buffer.begin(), itEOI);
+            frames++;
+            searchStart = 0;
+        }
+    }
+    return frames;
+}
+
+// ========== 切帧自检 ==========
+// 合成码流覆盖的情况：
+//   - APP1 段里带 FFD8/FFD9（EXIF 缩略图），熵编码数据里有 FF00 填充、RST 标记和 FFFF 填充；
+//   - 帧之间有垃圾字节（不含 FFD8，可以含单独的 0xFF）；
+//   - 超过单帧容量的帧（应丢弃并计入 oversize_drops）；
+//   - 熵编码数据中途截断、紧跟下一帧的 SOI（截断的帧应丢弃）；
+//   - 码流末尾截断的帧（不应输出）。
+// 块大小随机（1 字节到几 KB），标记码、段长度都会被切在两次 feed 之间。
+static const size_t kCheckFrameBytes = 64 * 1024;
+
+struct SyntheticStream {
+    std::vector<uint8_t> bytes;
+    std::vector<std::vector<uint8_t>> expected;  // 应当原样输出的帧
+    uint64_t oversize = 0;
+};
+
+static void appendSegment(std::vector<uint8_t>& out, uint8_t marker, const std::vector<uint8_t>& payload) {
+    out.push_back(0xFF);
+    out.push_back(marker);
+    out.push_back(uint8_t((payload.size() + 2) >> 8));
+    out.push_back(uint8_t(payload.size() + 2));
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// 一帧合成 JPEG；truncate 为 true 时在熵编码数据中途截断（没有 EOI）
+static std::vector<uint8_t> syntheticJpeg(std::mt19937& rng, size_t entropy_bytes, bool truncate) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> f = {0xFF, 0xD8};
+
+    std::vector<uint8_t> app1(64 + rng() % 256);
+    for (uint8_t& b : app1) b = uint8_t(byte(rng));
+    const uint8_t thumb[] = {0xFF, 0xD8, 0x12, 0xFF, 0xD9, 0xFF, 0x00};
+    std::copy(thumb, thumb + sizeof(thumb), app1.begin() + 8);
+    appendSegment(f, 0xE1, app1);
+
+    std::vector<uint8_t> dqt(65);
+    for (uint8_t& b : dqt) b = uint8_t(byte(rng));
+    appendSegment(f, 0xDB, dqt);
+    appendSegment(f, 0xDA, {0x01, 0x01, 0x00, 0x00, 0x3F, 0x00});
+
+    size_t entropy_end = truncate ? entropy_bytes / 2 : entropy_bytes;
+    for (size_t n = 0; n < entropy_end; ++n) {
+        uint32_t r = rng();
+        if (r % 997 == 0) {  // RST 标记
+            f.push_back(0xFF);
+            f.push_back(uint8_t(0xD0 + (r >> 8) % 8));
+        } else if (r % 1009 == 0) {  // 标记前的 FFFF 填充
+            f.push_back(0xFF);
+            f.push_back(0xFF);
+            f.push_back(0xD0);
+        } else {
+            uint8_t b = uint8_t(byte(rng));
+            f.push_back(b);
+            if (b == 0xFF) f.push_back(0x00);
+        }
+    }
+    if (!truncate) {
+        f.push_back(0xFF);
+        f.push_back(0xD9);
+    }
+    return f;
+}
+
+static SyntheticStream makeSyntheticStream(uint32_t seed) {
+    std::mt19937 rng(seed);
+    SyntheticStream s;
+    bool after_truncated = false;
+    for (int i = 0; i < 40; ++i) {
+        // 帧间垃圾：不含 FFD8。截断的帧后面不能有垃圾（切帧器仍把它当熵编码数据），只能紧跟下一帧的 SOI
+        size_t junk = after_truncated ? 0 : rng() % 64;
+        for (size_t j = 0; j < junk; ++j) {
+            uint8_t b = uint8_t(rng());
+            if (b == 0xD8 && !s.bytes.empty() && s.bytes.back() == 0xFF) b = 0xD7;
+            s.bytes.push_back(b);
+        }
+        uint32_t kind = rng() % 10;
+        after_truncated = kind == 1;
+        if (kind == 0) {  // 超长帧
+            std::vector<uint8_t> f = syntheticJpeg(rng, kCheckFrameBytes + 4096, false);
+            s.bytes.insert(s.bytes.end(), f.begin(), f.end());
+            s.oversize++;
+        } else if (kind == 1) {  // 中途截断，紧跟下一帧
+            std::vector<uint8_t> f = syntheticJpeg(rng, 2000, true);
+            s.bytes.insert(s.bytes.end(), f.begin(), f.end());
+        } else {
+            std::vector<uint8_t> f = syntheticJpeg(rng, 500 + rng() % 20000, false);
+            s.bytes.insert(s.bytes.end(), f.begin(), f.end());
+            s.expected.push_back(std::move(f));
+        }
+    }
+    // 末尾截断的帧（前面一帧是截断的也没关系：两帧都不输出）
+    std::vector<uint8_t> tail = syntheticJpeg(rng, 3000, true);
+    s.bytes.insert(s.bytes.end(), tail.begin(), tail.end());
+    return s;
+}
+
+// 返回不一致的次数；max_chunk 为 1 时逐字节喂
+static size_t checkFramer(const SyntheticStream& s, uint32_t seed, size_t max_chunk) {
+    std::mt19937 rng(seed);
+    FramePool pool(2, 4, kCheckFrameBytes);
+    size_t index = 0, mismatches = 0;
+    MjpegFramer framer(pool, [&](std::shared_ptr<EncodedFrame> f) {
+        if (index >= s.expected.size() || f->data != s.expected[index]) {
+            if (mismatches++ == 0) {
+                std::fprintf(stderr, "self-check: frame %zu mismatch (%zu bytes, seed=%u, max_chunk=%zu)\n",
+                             index, f->data.size(), seed, max_chunk);
+            }
+        }
+        index++;
+    });
+    for (size_t off = 0; off < s.bytes.size();) {
+        size_t n = std::min<size_t>(1 + rng() % max_chunk, s.bytes.size() - off);
+        framer.feed(s.bytes.data() + off, n);
+        off += n;
+    }
+    const MjpegFramer::Stats& st = framer.stats();
+    if (index != s.expected.size() || st.frames != s.expected.size() || st.oversize_drops != s.oversize) {
+        std::fprintf(stderr, "self-check: frames=%zu expected=%zu oversize=%llu expected=%llu (seed=%u, max_chunk=%zu)\n",
+                     index, s.expected.size(), (unsigned long long)st.oversize_drops,
+                     (unsigned long long)s.oversize, seed, max_chunk);
+        mismatches++;
+    }
+    return mismatches;
+}
+
+static bool selfCheck() {
+    size_t failures = 0, frames = 0;
+    for (uint32_t seed = 1; seed <= 16; ++seed) {
+        SyntheticStream s = makeSyntheticStream(seed);
+        frames += s.expected.size();
+        for (size_t max_chunk : {size_t(1), size_t(7), size_t(300), size_t(8192)}) {
+            failures += checkFramer(s, seed * 31 + uint32_t(max_chunk), max_chunk);
+        }
+    }
+    std::printf("check  : %s (%zu synthetic frames x 4 chunkings)\n", failures ? "FAILED" : "ok", frames);
+    return failures == 0;
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    bool check_ok = selfCheck();
+    if (argc < 2) {
+        if (check_ok) std::printf("usage: %s [file.mjpeg] [chunk_bytes=65536] [repeat=20] [decode]\n", argv[0]);
+        return check_ok ? 0 : 2;
+    }
+    size_t chunk_bytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64 * 1024;
+    int repeat = argc > 3 ? std::atoi(argv[3]) : 20;
+    if (chunk_bytes == 0) chunk_bytes = 64 * 1024;
+    if (repeat <= 0) repeat = 1;
+    bool decode = argc > 4 && !std::strcmp(argv[4], "decode");
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const double mb = double(data.size()) * repeat / (1 << 20);
+    std::printf("input: %zu bytes, chunk=%zu, repeat=%d\n", data.size(), chunk_bytes, repeat);
+
+    // 新切帧器：校验每帧首尾，回调里立即放手，帧回到池子里复用
+    FramePool pool(4, 8, 4 << 20);
+    size_t bad = 0, bytes_out = 0;
+    MjpegFramer framer(pool, [&](std::shared_ptr<EncodedFrame> f) {
+        const std::vector<uint8_t>& j = f->data;
+        if (j.size() < 4 || j[0] != 0xFF || j[1] != 0xD8 || j[j.size() - 2] != 0xFF || j[j.size() - 1] != 0xD9) bad++;
+        bytes_out += j.size();
+    });
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+        for (size_t off = 0; off < data.size(); off += chunk_bytes) {
+            framer.feed(data.data() + off, std::min(chunk_bytes, data.size() - off));
+        }
+    }
+    double t_new = seconds(t0);
+    const MjpegFramer::Stats& st = framer.stats();
+    std::printf("framer : frames=%llu bad=%zu skipped=%llu oversize=%llu pool_drops=%llu  %.1f frames/s  %.1f MB/s\n",
+                (unsigned long long)st.frames, bad, (unsigned long long)st.skipped_bytes,
+                (unsigned long long)st.oversize_drops, (unsigned long long)st.pool_drops,
+                st.frames / t_new, mb / t_new);
+
+    size_t legacy_frames = 0, legacy_bytes = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) legacy_frames += legacySplit(data, legacy_bytes);
+    double t_old = seconds(t0);
+    std::printf("legacy : frames=%zu  %.1f frames/s  %.1f MB/s\n", legacy_frames, legacy_frames / t_old, mb / t_old);
+    std::printf("speedup: %.2fx\n", t_old / t_new);
+
+    // 服务端路径的稳态分配：第一遍预热（缓冲池长到够用、各 vector 长到最大帧），之后每帧应当是 0 次分配
+    FramePool server_pool(16, 32, 4 << 20);
+    FrameBroadcaster broadcaster;
+    FrameBroadcaster::Cursor cursor = broadcaster.subscribe();
+    uint64_t decoded = 0;
+    size_t decoded_bytes = 0;  // 最大一帧解码图像的字节数
+    MjpegFramer server_framer(server_pool, [&](std::shared_ptr<EncodedFrame> f) {
+        broadcaster.publish(std::move(f));
+        while (FramePtr frame = broadcaster.tryNext(cursor)) {
+            if (!decode) continue;
+            cv::Mat image = frame->decode();
+            if (image.empty()) continue;
+            decoded++;
+            decoded_bytes = std::max(decoded_bytes, image.total() * image.elemSize());
+        }
+    });
+    AllocCounter::Snapshot warm;
+    uint64_t warm_frames = 0;
+    for (int r = 0; r < repeat + 1; ++r) {
+        if (r == 1) {
+            warm = AllocCounter::now();
+            warm_frames = server_framer.stats().frames;
+        }
+        for (size_t off = 0; off < data.size(); off += chunk_bytes) {
+            server_framer.feed(data.data() + off, std::min(chunk_bytes, data.size() - off));
+        }
+    }
+    AllocCounter::Snapshot allocs = AllocCounter::since(warm);
+    uint64_t frames = server_framer.stats().frames - warm_frames;
+    FramePool::Stats ps = server_pool.stats();
+    double allocs_per_frame = frames ? double(allocs.allocs) / frames : 0.0;
+    double bytes_per_frame = frames ? double(allocs.bytes) / frames : 0.0;
+    std::printf("allocs : %.2f allocs/frame  %.0f bytes/frame%s  pool frames=%zu hits=%llu misses=%llu exhausted=%llu\n",
+                allocs_per_frame, bytes_per_frame,
+                decode ? " (with decode)" : "", ps.frames, (unsigned long long)ps.hits,
+                (unsigned long long)ps.misses, (unsigned long long)ps.exhausted);
+    if (decode && decoded == 0) std::printf("decode : no frame decoded\n");
+
+    bool over_budget = decode ? decoded_bytes > 0 && bytes_per_frame >= decoded_bytes / 2.0
+                              : allocs_per_frame > kMaxAllocsPerFrame;
+    if (over_budget) {
+        if (decode) {
+            std::printf("budget : FAILED, %.0f bytes/frame allocated, pixel buffer (%zu bytes) is not being reused\n",
+                        bytes_per_frame, decoded_bytes);
+        } else {
+            std::printf("budget : FAILED, %.2f allocs/frame > %.2f on the streaming path\n", allocs_per_frame,
+                        kMaxAllocsPerFrame);
+        }
+    }
+
+    if (bad != 0 || !check_ok) return 2;
+    return over_budget ? 3 : 0;
+}
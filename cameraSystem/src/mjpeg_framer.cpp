@@ -0,0 +1,177 @@
+#include "../include/mjpeg_framer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+MjpegFramer::MjpegFramer(FramePool& pool, FrameCallback on_frame)
+    : pool_(pool), on_frame_(std::move(on_frame)) {}
+
+void MjpegFramer::reset() {
+    dropFrame();
+    state_ = State::SeekSoiFF;
+}
+
+void MjpegFramer::beginFrame() {
+    current_ = pool_.acquire();
+    discarding_ = !current_;
+    if (discarding_) {
+        stats_.pool_drops++;
+        return;
+    }
+    current_->seq = next_seq_;
+    current_->capture_ns = monotonicNs();
+    static const uint8_t kSOI[2] = {0xFF, 0xD8};
+    append(kSOI, 2);
+}
+
+void MjpegFramer::append(const uint8_t* p, size_t n) {
+    if (discarding_ || n == 0) return;
+    std::vector<uint8_t>& buf = current_->data;
+    // 只用预留的容量，超长的帧直接丢弃（多半是数据流错位），避免扩容分配
+    if (buf.size() + n > pool_.frameBytes()) {
+        stats_.oversize_drops++;
+        discarding_ = true;
+        current_.reset();
+        return;
+    }
+    buf.insert(buf.end(), p, p + n);
+}
+
+void MjpegFramer::finishFrame() {
+    if (!discarding_ && current_) {
+        // 转发的 MJPEG 不再编码，切帧完成就是编码完成
+        current_->framed_ns = current_->encoded_ns = monotonicNs();
+        next_seq_++;
+        stats_.frames++;
+        on_frame_(std::move(current_));
+    }
+    current_.reset();
+    discarding_ = false;
+}
+
+void MjpegFramer::dropFrame() {
+    current_.reset();
+    discarding_ = false;
+}
+
+void MjpegFramer::feed(const uint8_t* data, size_t len) {
+    // span：本次数据里属于当前帧、还没追加进帧缓冲的起点；NONE 表示不在帧内
+    static constexpr size_t NONE = SIZE_MAX;
+    size_t span = (state_ == State::SeekSoiFF || state_ == State::SeekSoiD8) ? NONE : 0;
+    size_t i = 0;
+
+    // 帧结构错误：丢掉当前帧，从下一个字节开始重新找 SOI
+    auto resync = [&]() {
+        dropFrame();
+        span = NONE;
+        state_ = State::SeekSoiFF;
+    };
+
+    // 处理段结构里的一个标记码（i 指向标记码字节）
+    auto onMarker = [&](uint8_t code) {
+        if (code == 0xD9) {// EOI：帧结束
+            append(data + span, i + 1 - span);
+            finishFrame();
+            span = NONE;
+            state_ = State::SeekSoiFF;
+        } else if (code == 0xD8) {// 帧内又出现 SOI：上一帧不完整，从这里重新开始
+            dropFrame();
+            beginFrame();
+            span = i + 1;
+            state_ = State::MarkerFF;
+        } else if ((code >= 0xD0 && code <= 0xD7) || code == 0x01) {// 没有长度字段的标记
+            state_ = State::MarkerFF;
+        } else if (code == 0x00) {
+            resync();
+        } else {
+            after_sos_ = (code == 0xDA);
+            state_ = State::LengthHi;
+        }
+    };
+
+    while (i < len) {
+        uint8_t c = data[i];
+        switch (state_) {
+        case State::SeekSoiFF: {
+            const void* ff = std::memchr(data + i, 0xFF, len - i);
+            size_t pos = ff ? size_t(static_cast<const uint8_t*>(ff) - data) : len;
+            stats_.skipped_bytes += pos - i;
+            i = pos;
+            if (ff) {
+                state_ = State::SeekSoiD8;
+                i++;
+            }
+            continue;
+        }
+        case State::SeekSoiD8:
+            if (c == 0xD8) {
+                beginFrame();
+                span = i + 1;
+                state_ = State::MarkerFF;
+            } else if (c != 0xFF) {
+                stats_.skipped_bytes += 2;
+                state_ = State::SeekSoiFF;
+            } else {
+                stats_.skipped_bytes++;
+            }
+            break;
+        case State::MarkerFF:
+            if (c == 0xFF) state_ = State::MarkerCode;
+            else resync();
+            break;
+        case State::MarkerCode:
+            if (c != 0xFF) onMarker(c);// 连续的 0xFF 是填充
+            break;
+        case State::LengthHi:
+            seg_len_ = uint16_t(c) << 8;
+            state_ = State::LengthLo;
+            break;
+        case State::LengthLo:
+            seg_len_ |= c;
+            if (seg_len_ < 2) {
+                resync();
+                break;
+            }
+            seg_remaining_ = seg_len_ - 2;
+            if (seg_remaining_ == 0) {
+                state_ = after_sos_ ? State::Entropy : State::MarkerFF;
+            } else {
+                state_ = State::SkipSegment;
+            }
+            break;
+        case State::SkipSegment: {
+            size_t n = std::min<size_t>(seg_remaining_, len - i);
+            seg_remaining_ -= uint32_t(n);
+            i += n;
+            if (seg_remaining_ == 0) state_ = after_sos_ ? State::Entropy : State::MarkerFF;
+            continue;
+        }
+        case State::Entropy: {
+            const void* ff = std::memchr(data + i, 0xFF, len - i);
+            if (!ff) {
+                i = len;
+                continue;
+            }
+            i = size_t(static_cast<const uint8_t*>(ff) - data) + 1;
+            state_ = State::EntropyFF;
+            continue;
+        }
+        case State::EntropyFF:
+            if (c == 0x00 || (c >= 0xD0 && c <= 0xD7)) {
+                state_ = State::Entropy;// 填充字节或 RST，仍在熵编码数据里
+            } else if (c != 0xFF) {
+                onMarker(c);// 扫描结束：EOI，或渐进式 JPEG 的下一个段
+            }
+            break;
+        }
+        i++;
+    }
+
+    if (span != NONE && span < len) append(data + span, len - span);
+}
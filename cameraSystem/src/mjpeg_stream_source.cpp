@@ -0,0 +1,148 @@
+#include "../include/mjpeg_stream_source.hpp"
+#include "../include/log.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+
+MjpegStreamSource::MjpegStreamSource(Mode mode, std::string target, unsigned fps)
+    : mode_(mode), target_(std::move(target)), fps_(fps) {}
+
+MjpegStreamSource::~MjpegStreamSource() { stop(); }
+
+const char* MjpegStreamSource::name() const {
+    switch (mode_) {
+    case Mode::Command: return "mjpeg-command";
+    case Mode::File: return "mjpeg-file";
+    case Mode::Pipe: return "mjpeg-pipe";
+    }
+    return "mjpeg";
+}
+
+bool MjpegStreamSource::start(FrameSink& sink) {
+    if (running_) return true;
+    // 文件要先确认能打开，打不开就让调用方换采集源；命令和管道在线程里反复重试
+    if (mode_ == Mode::File && access(target_.c_str(), R_OK) != 0) {
+        LOG_E("[" << name() << "] cannot open " << target_ << ": " << strerror(errno));
+        return false;
+    }
+    sink_ = &sink;
+    FramePool* pool = sink.jpegPool();
+    if (!pool) {
+        if (!own_pool_) own_pool_ = std::make_unique<FramePool>(16, 32, 1 << 20);
+        pool = own_pool_.get();
+    }
+    framer_ = std::make_unique<MjpegFramer>(*pool, [this](std::shared_ptr<EncodedFrame> frame) {
+        onFrame(std::move(frame));
+    });
+    running_ = true;
+    worker_ = std::thread(&MjpegStreamSource::run, this);
+    return true;
+}
+
+void MjpegStreamSource::stop() {
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+}
+
+bool MjpegStreamSource::open() {
+    switch (mode_) {
+    case Mode::Command:
+        LOG_I("Spawning: " << target_);
+        proc_ = popen(target_.c_str(), "r");
+        if (!proc_) return false;
+        fd_ = fileno(proc_);
+        return true;
+    case Mode::File:
+    case Mode::Pipe:
+        fd_ = target_ == "-" ? dup(STDIN_FILENO) : ::open(target_.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd_ >= 0;
+    }
+    return false;
+}
+
+void MjpegStreamSource::close() {
+    if (proc_) {
+        int rc = pclose(proc_);
+        LOG_W("[" << name() << "] process exited with code " << rc);
+        proc_ = nullptr;
+    } else if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+}
+
+void MjpegStreamSource::run() {
+    // 读缓冲只分配一次
+    const size_t CHUNK = 64 * 1024;
+    std::vector<uint8_t> chunk(CHUNK);
+
+    while (running_) {
+        if (!open()) {
+            LOG_E("[" << name() << "] cannot open " << target_ << ": " << strerror(errno) << ". Retry in 2s.");
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            continue;
+        }
+        framer_->reset();
+        next_due_ = std::chrono::steady_clock::now();
+
+        while (running_) {
+            pollfd pfd{fd_, POLLIN, 0};
+            int pr = poll(&pfd, 1, 200);
+            if (pr == 0) continue;
+            if (pr < 0) {
+                if (errno == EINTR) continue;
+                LOG_E("[" << name() << "] poll error: " << strerror(errno));
+                break;
+            }
+            ssize_t n = read(fd_, chunk.data(), CHUNK);
+            if (n == 0) break;  // EOF
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                LOG_E("[" << name() << "] read error: " << strerror(errno));
+                break;
+            }
+            framer_->feed(chunk.data(), size_t(n));
+        }
+
+        const MjpegFramer::Stats& st = framer_->stats();
+        LOG_I("[" << name() << "] frames=" << st.frames << " skipped_bytes=" << st.skipped_bytes
+              << " oversize_drops=" << st.oversize_drops << " pool_drops=" << st.pool_drops);
+        close();
+
+        // 文件回放：直接从头再来；命令和管道：稍等再重启/重新打开
+        if (running_ && mode_ != Mode::File) {
+            LOG_W("[" << name() << "] stream ended. Restarting in 1s...");
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+bool MjpegStreamSource::setFrameRate(unsigned fps) {
+    if (mode_ != Mode::File || fps == 0) return false;
+    fps_ = fps;
+    return true;
+}
+
+void MjpegStreamSource::onFrame(std::shared_ptr<EncodedFrame> frame) {
+    // 文件回放按 fps 限速，模拟相机的出帧节奏
+    unsigned fps = fps_.load(std::memory_order_relaxed);
+    if (mode_ == Mode::File && fps > 0) {
+        next_due_ += std::chrono::nanoseconds(1000000000ull / fps);
+        auto now = std::chrono::steady_clock::now();
+        if (next_due_ > now) {
+            std::this_thread::sleep_until(next_due_);
+        } else if (now - next_due_ > std::chrono::seconds(1)) {
+            next_due_ = now;  // 落后太多（比如被挂起过）就重新对齐，不连发补帧
+        }
+        frame->capture_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        frame->framed_ns = frame->encoded_ns = frame->capture_ns;
+    }
+    sink_->onEncoded(std::move(frame));
+    if (++frames_ % 30 == 0) {
+        LOG_I("[" << name() << "] received frames=" << frames_);
+    }
+}
@@ -2,15 +2,137 @@
 #include <cstring>
 
 namespace Protocol {
-    std::vector<uint8_t> serializeHeader(const MessageHeader& header) {
-        std::vector<uint8_t> buf(sizeof(MessageHeader));
-        std::memcpy(buf.data(), &header, sizeof(MessageHeader));
-        return buf;
+    // 按字节读写大端整数：不依赖对齐，也不需要临时缓冲
+    static uint16_t load16(const uint8_t* p) { return uint16_t(p[0] << 8 | p[1]); }
+    static uint32_t load32(const uint8_t* p) {
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
     }
+    static uint64_t load64(const uint8_t* p) { return uint64_t(load32(p)) << 32 | load32(p + 4); }
 
-    bool parseHeader(const std::vector<uint8_t>& data, MessageHeader& header) {
-        if (data.size() < sizeof(MessageHeader)) return false;
-        std::memcpy(&header, data.data(), sizeof(MessageHeader));
+    static void store16(uint8_t* p, uint16_t v) {
+        p[0] = uint8_t(v >> 8);
+        p[1] = uint8_t(v);
+    }
+    static void store32(uint8_t* p, uint32_t v) {
+        p[0] = uint8_t(v >> 24);
+        p[1] = uint8_t(v >> 16);
+        p[2] = uint8_t(v >> 8);
+        p[3] = uint8_t(v);
+    }
+    static void store64(uint8_t* p, uint64_t v) {
+        store32(p, uint32_t(v >> 32));
+        store32(p + 4, uint32_t(v));
+    }
+
+    static_assert(offsetof(MessageHeader, type) == 4 && offsetof(MessageHeader, payload_length) == 5 &&
+                  offsetof(MessageHeader, timestamp) == 9 && sizeof(MessageHeader) == 13, "v1 wire layout");
+    static_assert(offsetof(MessageHeaderV2, version) == 4 && offsetof(MessageHeaderV2, flags) == 6 &&
+                  offsetof(MessageHeaderV2, message_id) == 8 && offsetof(MessageHeaderV2, payload_length) == 12 &&
+                  offsetof(MessageHeaderV2, timestamp_ns) == 16 && offsetof(MessageHeaderV2, payload_crc) == 24 &&
+                  offsetof(MessageHeaderV2, header_crc) == 28, "v2 wire layout");
+
+    struct Crc32Table {
+        uint32_t v[256];
+        constexpr Crc32Table() : v() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                v[i] = c;
+            }
+        }
+    };
+    static constexpr Crc32Table CRC_TABLE;
+
+    uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc) {
+        crc = ~crc;
+        for (size_t i = 0; i < len; ++i) crc = CRC_TABLE.v[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint8_t detectVersion(const uint8_t* data, size_t len) {
+        if (len < 4) return 0;
+        return load32(data) == MAGIC_V2 ? VERSION_2 : VERSION_1;
+    }
+
+    ParseResult parseHeader(const uint8_t* data, size_t len, uint8_t version, Header& header) {
+        if (version == VERSION_2) {
+            if (len < sizeof(MessageHeaderV2)) return ParseResult::NeedMore;
+            if (load32(data) != MAGIC_V2 || data[4] != VERSION_2) return ParseResult::Invalid;
+            if (crc32(data, offsetof(MessageHeaderV2, header_crc)) != load32(data + 28)) return ParseResult::Invalid;
+            header.version = VERSION_2;
+            header.type = MessageType(data[5]);
+            header.flags = load16(data + 6);
+            header.message_id = load32(data + 8);
+            header.payload_length = load32(data + 12);
+            header.timestamp_ns = load64(data + 16);
+            header.payload_crc = load32(data + 24);
+            return ParseResult::Ok;
+        }
+        if (len < sizeof(MessageHeader)) return ParseResult::NeedMore;
+        header.version = VERSION_1;
+        header.type = MessageType(data[4]);
+        header.flags = 0;
+        header.message_id = load32(data);
+        header.payload_length = load32(data + 5);
+        header.timestamp_ns = uint64_t(load32(data + 9)) * 1000000000ull;
+        header.payload_crc = 0;
+        return ParseResult::Ok;
+    }
+
+    size_t writeHeader(const Header& header, uint8_t* out) {
+        if (header.version == VERSION_2) {
+            store32(out, MAGIC_V2);
+            out[4] = VERSION_2;
+            out[5] = uint8_t(header.type);
+            store16(out + 6, header.flags);
+            store32(out + 8, header.message_id);
+            store32(out + 12, header.payload_length);
+            store64(out + 16, header.timestamp_ns);
+            store32(out + 24, header.payload_crc);
+            store32(out + 28, crc32(out, offsetof(MessageHeaderV2, header_crc)));
+            return sizeof(MessageHeaderV2);
+        }
+        store32(out, header.message_id);
+        out[4] = uint8_t(header.type);
+        store32(out + 5, header.payload_length);
+        store32(out + 9, uint32_t(header.timestamp_ns / 1000000000ull));
+        return sizeof(MessageHeader);
+    }
+
+    MessageReader::MessageReader(size_t max_payload) : max_payload_(max_payload) {}
+
+    void MessageReader::feed(const uint8_t* data, size_t len) {
+        // 先把已经取走的部分丢掉，缓冲区里只留半条消息（容量保留，稳定后不再分配）
+        if (pos_ > 0) {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+            pos_ = 0;
+        }
+        buffer_.insert(buffer_.end(), data, data + len);
+    }
+
+    bool MessageReader::next(Header& header, const uint8_t*& payload) {
+        if (failed_) return false;
+        const uint8_t* data = buffer_.data() + pos_;
+        size_t avail = buffer_.size() - pos_;
+        if (version_ == 0) {
+            version_ = detectVersion(data, avail);
+            if (version_ == 0) return false;
+        }
+
+        ParseResult r = parseHeader(data, avail, version_, header);
+        if (r == ParseResult::NeedMore) return false;
+        if (r == ParseResult::Invalid || header.payload_length > max_payload_) {
+            failed_ = true;
+            return false;
+        }
+        size_t total = headerSize(version_) + header.payload_length;
+        if (avail < total) return false;
+        payload = data + headerSize(version_);
+        if ((header.flags & FLAG_PAYLOAD_CRC) && crc32(payload, header.payload_length) != header.payload_crc) {
+            failed_ = true;
+            return false;
+        }
+        pos_ += total;
         return true;
     }
 }
@@ -0,0 +1,238 @@
+// 协议解析随机回放：生成 v1/v2 消息流，随机变异（改字节、插入、删除）和截断，
+// 再按随机大小切块喂给 Protocol::MessageReader，和一个独立写的参考解码（整段一次性顺序解析，
+// 用打包结构体 + ntohl 和逐位 CRC，不共用 protocol.cpp 的任何代码）逐条比较。
+// 同时检查 writeHeader/parseHeader 往返、writeHeader 和参考编码逐字节一致。
+// 任何不一致都打印出来，退出码为 1；ASan/UBSan 下编译还能查越界读。
+//
+// 运行：
+//   ./protocol_fuzz [iterations=20000] [seed=1]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../include/protocol.hpp"
+
+using namespace Protocol;
+
+static const size_t kMaxPayload = 4096;
+
+// ========== 参考实现 ==========
+static uint32_t refCrc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; ++k) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+    }
+    return ~crc;
+}
+
+struct RefMessage {
+    Header header;
+    std::vector<uint8_t> payload;
+};
+
+struct RefResult {
+    uint8_t version = 0;
+    bool failed = false;
+    std::vector<RefMessage> messages;
+};
+
+static void refEncode(const Header& h, const uint8_t* payload, std::vector<uint8_t>& out) {
+    if (h.version == VERSION_2) {
+        MessageHeaderV2 v2;
+        v2.magic = htonl(MAGIC_V2);
+        v2.version = VERSION_2;
+        v2.type = h.type;
+        v2.flags = htons(h.flags);
+        v2.message_id = htonl(h.message_id);
+        v2.payload_length = htonl(h.payload_length);
+        v2.timestamp_ns = htobe64(h.timestamp_ns);
+        v2.payload_crc = htonl(h.payload_crc);
+        v2.header_crc = htonl(refCrc32(reinterpret_cast<const uint8_t*>(&v2), offsetof(MessageHeaderV2, header_crc)));
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v2);
+        out.insert(out.end(), p, p + sizeof(v2));
+    } else {
+        MessageHeader v1;
+        v1.message_id = h.message_id;
+        v1.type = h.type;
+        v1.payload_length = h.payload_length;
+        v1.timestamp = uint32_t(h.timestamp_ns / 1000000000ull);
+        v1.toNetworkOrder();
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v1);
+        out.insert(out.end(), p, p + sizeof(v1));
+    }
+    out.insert(out.end(), payload, payload + h.payload_length);
+}
+
+// 整段数据一次性顺序解析：第一条消息的开头决定版本，遇到坏消息头、超长负载或负载 CRC 不对就停在失败状态
+static RefResult refDecode(const std::vector<uint8_t>& data, size_t max_payload) {
+    RefResult r;
+    size_t pos = 0;
+    if (data.size() < 4) return r;
+    uint32_t magic;
+    std::memcpy(&magic, data.data(), 4);
+    r.version = ntohl(magic) == MAGIC_V2 ? VERSION_2 : VERSION_1;
+    while (true) {
+        size_t avail = data.size() - pos;
+        RefMessage m;
+        size_t head;
+        if (r.version == VERSION_2) {
+            head = sizeof(MessageHeaderV2);
+            if (avail < head) return r;
+            MessageHeaderV2 v2;
+            std::memcpy(&v2, data.data() + pos, head);
+            if (ntohl(v2.magic) != MAGIC_V2 || v2.version != VERSION_2 ||
+                refCrc32(data.data() + pos, offsetof(MessageHeaderV2, header_crc)) != ntohl(v2.header_crc)) {
+                r.failed = true;
+                return r;
+            }
+            m.header.version = VERSION_2;
+            m.header.type = v2.type;
+            m.header.flags = ntohs(v2.flags);
+            m.header.message_id = ntohl(v2.message_id);
+            m.header.payload_length = ntohl(v2.payload_length);
+            m.header.timestamp_ns = be64toh(v2.timestamp_ns);
+            m.header.payload_crc = ntohl(v2.payload_crc);
+        } else {
+            head = sizeof(MessageHeader);
+            if (avail < head) return r;
+            MessageHeader v1;
+            std::memcpy(&v1, data.data() + pos, head);
+            v1.toHostOrder();
+            m.header.version = VERSION_1;
+            m.header.type = v1.type;
+            m.header.message_id = v1.message_id;
+            m.header.payload_length = v1.payload_length;
+            m.header.timestamp_ns = uint64_t(v1.timestamp) * 1000000000ull;
+        }
+        if (m.header.payload_length > max_payload) {
+            r.failed = true;
+            return r;
+        }
+        if (avail < head + m.header.payload_length) return r;
+        const uint8_t* payload = data.data() + pos + head;
+        if ((m.header.flags & FLAG_PAYLOAD_CRC) && refCrc32(payload, m.header.payload_length) != m.header.payload_crc) {
+            r.failed = true;
+            return r;
+        }
+        m.payload.assign(payload, payload + m.header.payload_length);
+        pos += head + m.header.payload_length;
+        r.messages.push_back(std::move(m));
+    }
+}
+
+// ========== 随机流 ==========
+static Header randomHeader(std::mt19937& rng, uint8_t version, uint32_t payload_length) {
+    Header h;
+    h.version = version;
+    h.type = MessageType(1 + rng() % 0x0B);
+    h.message_id = rng();
+    h.payload_length = payload_length;
+    h.timestamp_ns = (uint64_t(rng()) << 32 | rng());
+    if (version == VERSION_1) {
+        h.timestamp_ns = h.timestamp_ns % (uint64_t(UINT32_MAX) * 1000000000ull) / 1000000000ull * 1000000000ull;
+    } else {
+        h.flags = uint16_t(rng() & (FLAG_KEYFRAME | FLAG_TIMING));
+    }
+    return h;
+}
+
+static std::vector<uint8_t> randomStream(std::mt19937& rng, uint8_t version, size_t& mismatches) {
+    std::vector<uint8_t> out, payload;
+    int count = 1 + int(rng() % 12);
+    for (int i = 0; i < count; ++i) {
+        // 偶尔正好落在负载上限附近（上限 -1 / 上限 / 上限 +1），边界判断错一个字节也能查出来
+        uint32_t size_kind = rng() % 16;
+        payload.resize(size_kind == 0 ? kMaxPayload - 1 + rng() % 3 : size_kind < 4 ? 0 : rng() % 600);
+        for (uint8_t& b : payload) b = uint8_t(rng());
+        Header h = randomHeader(rng, version, uint32_t(payload.size()));
+        if (version == VERSION_2 && rng() % 2) {
+            h.flags |= FLAG_PAYLOAD_CRC;
+            h.payload_crc = refCrc32(payload.data(), payload.size());
+        }
+
+        // writeHeader 必须和参考编码逐字节一致，parseHeader 必须原样读回
+        std::vector<uint8_t> ref;
+        refEncode(h, payload.data(), ref);
+        uint8_t head[MAX_HEADER_SIZE];
+        size_t n = writeHeader(h, head);
+        Header back;
+        if (n != headerSize(version) || std::memcmp(head, ref.data(), n) != 0 ||
+            parseHeader(head, n, version, back) != ParseResult::Ok || back.type != h.type ||
+            back.flags != h.flags || back.message_id != h.message_id || back.payload_length != h.payload_length ||
+            back.timestamp_ns != h.timestamp_ns || back.payload_crc != h.payload_crc) {
+            if (mismatches++ < 5) std::fprintf(stderr, "header round-trip mismatch (v%d, id=%u)\n", version, h.message_id);
+        }
+        out.insert(out.end(), ref.begin(), ref.end());
+    }
+    return out;
+}
+
+static void mutate(std::mt19937& rng, std::vector<uint8_t>& data) {
+    int edits = int(rng() % 4);
+    for (int e = 0; e < edits && !data.empty(); ++e) {
+        size_t at = rng() % data.size();
+        switch (rng() % 4) {
+        case 0: data[at] ^= uint8_t(1u << (rng() % 8)); break;
+        case 1: data[at] = uint8_t(rng()); break;
+        case 2: data.insert(data.begin() + at, uint8_t(rng())); break;
+        case 3: data.erase(data.begin() + at); break;
+        }
+    }
+    if (rng() % 3 == 0 && !data.empty()) data.resize(rng() % data.size());
+}
+
+static bool sameMessage(const Header& h, const uint8_t* payload, const RefMessage& m) {
+    return h.version == m.header.version && h.type == m.header.type && h.flags == m.header.flags &&
+           h.message_id == m.header.message_id && h.payload_length == m.header.payload_length &&
+           h.timestamp_ns == m.header.timestamp_ns && h.payload_crc == m.header.payload_crc &&
+           std::equal(m.payload.begin(), m.payload.end(), payload);
+}
+
+// 把 data 随机切块喂给 MessageReader，和参考结果比较；返回是否一致
+static bool replay(std::mt19937& rng, const std::vector<uint8_t>& data, const RefResult& ref) {
+    MessageReader reader(kMaxPayload);
+    size_t index = 0, off = 0;
+    bool ok = true;
+    Header h;
+    const uint8_t* payload = nullptr;
+    while (off < data.size()) {
+        size_t n = std::min<size_t>(1 + rng() % (rng() % 2 ? 8 : 700), data.size() - off);
+        reader.feed(data.data() + off, n);
+        off += n;
+        while (reader.next(h, payload)) {
+            if (index >= ref.messages.size() || !sameMessage(h, payload, ref.messages[index])) ok = false;
+            index++;
+        }
+    }
+    return ok && index == ref.messages.size() && reader.failed() == ref.failed &&
+           (data.size() < 4 || reader.version() == ref.version);
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 20000;
+    uint32_t seed = argc > 2 ? uint32_t(std::strtoul(argv[2], nullptr, 10)) : 1;
+    std::mt19937 rng(seed);
+
+    size_t mismatches = 0, messages = 0, failed_streams = 0;
+    for (long i = 0; i < iterations; ++i) {
+        uint8_t version = rng() % 2 ? VERSION_2 : VERSION_1;
+        std::vector<uint8_t> data = randomStream(rng, version, mismatches);
+        bool mutated = i % 4 != 0;  // 每 4 条留 1 条原样，确认没变异的流一条不丢
+        if (mutated) mutate(rng, data);
+        RefResult ref = refDecode(data, kMaxPayload);
+        messages += ref.messages.size();
+        if (ref.failed) failed_streams++;
+        if (!replay(rng, data, ref)) {
+            if (mismatches++ < 5) {
+                std::fprintf(stderr, "reader mismatch: iteration %ld (v%d, %zu bytes, %s)\n", i, version, data.size(),
+                             mutated ? "mutated" : "clean");
+            }
+        }
+    }
+    std::printf("%ld streams, %zu messages, %zu rejected as corrupt, %zu mismatches\n", iterations, messages,
+                failed_streams, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -3,337 +3,116 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
-#include <queue>
-#include <condition_variable>
 #include <cstdio>
 #include <vector>
 #include <cstring>
 #include <filesystem>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <ctime>
 
-#include <Poco/Net/TCPServer.h>
-#include <Poco/Net/TCPServerConnection.h>
-#include <Poco/Net/TCPServerConnectionFactory.h>
-#include <Poco/Net/TCPServerParams.h>
+#include <Poco/Exception.h>
+#include <Poco/Net/ServerSocket.h>
 #include <Poco/Net/StreamSocket.h>
 #include <Poco/Net/SocketAddress.h>
 #include <Poco/Util/ServerApplication.h>
 
 #include <opencv2/opencv.hpp>
 #include "../include/protocol.hpp"
+#include "../include/frame.hpp"
+#include "../include/frame_broadcaster.hpp"
+#include "../include/capture_source.hpp"
+#include "../include/capture_pipeline.hpp"
+#include "../include/camera_session.hpp"
+#include "../include/client_stats.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/shm_ring.hpp"
+#include "../include/activity_gate.hpp"
+#include "../include/log.hpp"
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
 
-// ========== 工具：安全日志辅助 ==========
-#define LOG_I(msg) std::cout << "[INFO] " << msg << std::endl
-#define LOG_W(msg) std::cerr << "[WARN] " << msg << std::endl
-#define LOG_E(msg) std::cerr << "[ERR ] " << msg << std::endl
-
-// ========== 全局配置：rpicam-vid 命令行 ==========
-// -n: no preview; --codec mjpeg: 输出 MJPEG；--output -: 输出到 stdout；
-// 可调整分辨率/帧率/质量等参数。
-static const char* RPICAM_CMD =
-    "rpicam-vid -n --codec mjpeg --width 640 --height 480 --framerate 20 --quality 80 --output -";
-
-// ========== 从 stdout 解析 MJPEG 的帧抓取器 ==========
-class RpiCamMjpegReader {
+// ========== 网络：单线程事件循环服务所有连接 ==========
+// 监听 socket 和所有客户端 socket 都挂在一个 epoll 上；广播器发布新帧时通过 eventfd 唤醒循环，
+// 循环再让每个连接尽量取帧发送。编码都在采集流水线的线程里，这个线程只做非阻塞收发。
+class CameraReactor {
 public:
-    RpiCamMjpegReader(std::queue<cv::Mat>& q, std::mutex& m, std::condition_variable& cv)
-        : q_(q), m_(m), cv_(cv), running_(false) {}
-
-    ~RpiCamMjpegReader() { stop(); }
+    static constexpr size_t MAX_CLIENTS = 64;
+
+    CameraReactor(unsigned short port, CapturePipeline& pipeline, ClientRegistry& registry)
+        : server_socket_(port), pipeline_(pipeline), registry_(registry) {}
+
+    bool start() {
+        if (!loop_.valid()) return false;
+        server_socket_.setBlocking(false);
+        if (!loop_.add(server_socket_.impl()->sockfd(), EPOLLIN, [this](uint32_t) { accept(); })) return false;
+
+        // 每路流（MJPEG、H.264、各降级档位）发布新帧都唤醒循环
+        std::vector<FrameBroadcaster*> streams = {&pipeline_.mjpeg(), &pipeline_.h264()};
+        for (int t = 1; t < CapturePipeline::TIERS; ++t) streams.push_back(&pipeline_.tier(t));
+        for (size_t i = 0; i < streams.size(); ++i) {
+            bool seen = false;
+            for (size_t j = 0; j < i; ++j) seen = seen || streams[j] == streams[i];
+            if (!seen) streams[i]->addListener([this] { loop_.wake(); });
+        }
 
-    void start() {
-        if (running_) return;
-        running_ = true;
-        worker_ = std::thread(&RpiCamMjpegReader::run, this);
+        thread_ = std::thread([this] {
+            loop_.run(100, [this] { pumpAll(); }, [this] { tickAll(); });
+            sessions_.clear();  // 在循环线程里关闭剩下的连接
+        });
+        return true;
     }
 
     void stop() {
-        running_ = false;
-        if (proc_) {
-            LOG_I("Stopping rpicam-vid process...");
-            pclose(proc_);
-            proc_ = nullptr;
-        }
-        if (worker_.joinable()) worker_.join();
+        loop_.stop();
+        if (thread_.joinable()) thread_.join();
     }
 
 private:
-    void run() {
-        while (running_) {
-            LOG_I("Spawning rpicam-vid: " << RPICAM_CMD);
-            proc_ = popen(RPICAM_CMD, "r");
-            if (!proc_) {
-                LOG_E("popen failed! Will retry in 2s.");
-                std::this_thread::sleep_for(std::chrono::seconds(2));
-                continue;
-            }
-
-            // 读取 stdout，并以 JPEG SOI/EOI 边界切帧
-            std::vector<uint8_t> buffer;
-            buffer.reserve(1 << 20); // 预留 1MB
-            const size_t CHUNK = 4096;
-            std::vector<uint8_t> chunk(CHUNK);
-
-            bool ok = true;
-            while (running_) {
-                size_t n = fread(chunk.data(), 1, CHUNK, proc_);
-                if (n == 0) {
-                    if (feof(proc_)) {
-                        LOG_W("rpicam-vid EOF.");
-                        ok = false;
-                        break;
-                    }
-                    if (ferror(proc_)) {
-                        LOG_E("fread error from rpicam-vid.");
-                        ok = false;
-                        break;
-                    }
-                    continue;
-                }
-                buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + n);
-
-                // 解析 JPEG 帧：FFD8 ... FFD9
-                // 简单起见：一次最多解析多个完整帧
-                size_t searchStart = 0;
-                while (true) {
-                    // 找 SOI
-                    auto itSOI = std::search(buffer.begin() + searchStart, buffer.end(),
-                                             kSOI, kSOI + 2);
-                    if (itSOI == buffer.end()) {
-                        // 没有 SOI，丢弃前面的无用数据
-                        if (buffer.size() > 2 * CHUNK) {
-                            // 保留末尾少量数据避免截断 SOI
-                            buffer.erase(buffer.begin(), buffer.end() - 2 * CHUNK);
-                        }
-                        break;
-                    }
-                    // 找 EOI（从 SOI 后面找）
-                    auto itEOI = std::search(itSOI + 2, buffer.end(),
-                                             kEOI, kEOI + 2);
-                    if (itEOI == buffer.end()) {
-                        // 还没读到完整帧
-                        // 下次从 SOI 前一个位置继续搜索，避免重复扫描太多
-                        searchStart = std::distance(buffer.begin(), itSOI);
-                        break;
-                    }
-
-                    // 取出 [SOI, EOI] 的完整 JPEG
-                    itEOI += 2; // 包含 EOI
-                    std::vector<uint8_t> jpeg(itSOI, itEOI);
-
-                    // 从缓冲区移除已消费部分
-                    buffer.erase(buffer.begin(), itEOI);
-
-                    // 解码为 BGR Mat
-                    cv::Mat mat = cv::imdecode(jpeg, cv::IMREAD_COLOR);
-                    if (!mat.empty()) {
-                        // 入队（限制队列长度）
-                        {
-                            std::lock_guard<std::mutex> lk(m_);
-                            if (!q_.empty()) q_.pop();// 丢弃旧帧
-                            q_.push(std::move(mat));// 入队最新帧
-                        }
-                        cv_.notify_one();
-                        frames_++;
-                        if (frames_ % 30 == 0) {
-                            LOG_I("[RpiCamMjpegReader] received frames=" << frames_);
-                        }
-                    } else {
-                        LOG_W("imdecode failed for one JPEG.");
-                    }
-
-                    // 本轮继续从缓冲区起始处找下一帧
-                    searchStart = 0;
-                }
-            }
-
-            // 退出或崩溃，清理并重启
-            int rc = pclose(proc_);
-            proc_ = nullptr;
-            LOG_W("rpicam-vid exited with code " << rc << ". Restarting in 1s...");
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
-    }
-
-    static constexpr uint8_t kSOI[2] = {0xFF, 0xD8};
-    static constexpr uint8_t kEOI[2] = {0xFF, 0xD9};
-
-    std::queue<cv::Mat>& q_;
-    std::mutex& m_;
-    std::condition_variable& cv_;
-    std::atomic<bool> running_;
-    std::thread worker_;
-    FILE* proc_ = nullptr;
-    size_t frames_ = 0;
-};
-
-// ========== 网络连接：保持你的协议 & 逻辑 ==========
-class CameraConnection : public Poco::Net::TCPServerConnection {
-public:
-    CameraConnection(const Poco::Net::StreamSocket& socket,
-                     std::queue<cv::Mat>& frame_queue,
-                     std::mutex& frame_mutex,
-                     std::condition_variable& frame_cv)
-        : Poco::Net::TCPServerConnection(socket),
-          frame_queue_(frame_queue),
-          frame_mutex_(frame_mutex),
-          frame_cv_(frame_cv),
-          running_(false),
-          next_message_id_(0) {}
-
-    void run() override {
-        Poco::Net::StreamSocket& socket = this->socket();
-        LOG_I("=== CameraConnection started for " << socket.peerAddress().toString() << " ===");
-
-        running_ = true;
-        int frame_count = 0;
-
-        auto sendAll = [&](const void* data, size_t len) {
-            const char* p = static_cast<const char*>(data);
-            size_t sent = 0;
-            while (sent < len) {
-                int n = socket.sendBytes(p + sent, int(len - sent));
-                if (n <= 0) throw std::runtime_error("send failed");
-                sent += size_t(n);
-            }
-        };
-
+    void accept() {
+        Poco::Net::StreamSocket socket;
         try {
-            while (running_) {
-                // 客户端命令
-                if (socket.available() > 0) {
-                    handleClientCommand(socket, sendAll);
-                }
-
-                // 取帧
-                cv::Mat frame;
-                {
-                    std::unique_lock<std::mutex> lock(frame_mutex_);
-                    if (!frame_cv_.wait_for(lock, std::chrono::milliseconds(200),
-                        [&]{ return !frame_queue_.empty(); })) {
-                        // 没帧，继续等
-                        continue;
-                    }
-
-                    frame = frame_queue_.front();
-                    frame_queue_.pop();
-                }
-
-                if (frame.empty()) {
-                    LOG_W("[run] got empty frame.");
-                    continue;
-                }
-                
-                // 翻转画面（水平+垂直翻转）
-                cv::flip(frame, frame, -1);
-
-                // 编码 JPEG（你客户端就是收 JPEG）
-                std::vector<uint8_t> frame_data;
-                bool ok = cv::imencode(".jpg", frame, frame_data, {cv::IMWRITE_JPEG_QUALITY, 80});
-                if (!ok || frame_data.empty()) {
-                    LOG_W("[run] JPEG encode failed.");
-                    continue;
-                }
-
-                Protocol::MessageHeader header;
-                header.message_id = next_message_id_++;
-                header.type = Protocol::MessageType::VIDEO_FRAME;
-                header.payload_length = static_cast<uint32_t>(frame_data.size());
-                header.timestamp = static_cast<uint32_t>(std::time(nullptr));
-                header.toNetworkOrder();
-
-                sendAll(&header, sizeof(header));
-                sendAll(frame_data.data(), frame_data.size());
-
-                frame_count++;
-                if (frame_count % 30 == 0) {
-                    LOG_I("[run] sent frames=" << frame_count);
-                }
-            }
-        } catch (const std::exception& e) {
-            LOG_E("[CameraConnection] exception: " << e.what());
+            socket = server_socket_.acceptConnection();
+        } catch (const Poco::Exception& e) {
+            LOG_W("[CameraReactor] accept failed: " << e.displayText());
+            return;
         }
-        LOG_I("=== CameraConnection closed for " << socket.peerAddress().toString() << " ===");
-    }
-
-    void stop() { running_ = false; }
-
-private:
-    template <typename SendAllFn>
-    void handleClientCommand(Poco::Net::StreamSocket& socket, SendAllFn sendAll) {
-        char buffer[1024];
-        int bytes_received = socket.receiveBytes(buffer, sizeof(buffer));
-        if (bytes_received < (int)sizeof(Protocol::MessageHeader)) return;
-
-        Protocol::MessageHeader header;
-        std::memcpy(&header, buffer, sizeof(header));
-        header.toHostOrder();
-
-        if (header.type == Protocol::MessageType::CAPTURE_COMMAND) {
-            LOG_I("Received capture command");
-            // 取最近一帧并返回
-            cv::Mat photo;
-            {
-                std::unique_lock<std::mutex> lock(frame_mutex_);
-                if (!frame_queue_.empty()) {
-                    photo = frame_queue_.back(); // 最近一帧
-                    cv::flip(photo, photo, -1);  // 翻转抓拍图
-                }
-            }
-            if (photo.empty()) {
-                LOG_W("No frame to capture.");
-                return;
-            }
-
-            std::vector<uint8_t> photo_data;
-            cv::imencode(".jpg", photo, photo_data, {cv::IMWRITE_JPEG_QUALITY, 95});
-
-            Protocol::MessageHeader respHeader;
-            respHeader.message_id = next_message_id_++;
-            respHeader.type = Protocol::MessageType::CAPTURE_RESPONSE;
-            respHeader.payload_length = static_cast<uint32_t>(sizeof(Protocol::CaptureResponse) + photo_data.size());
-            respHeader.timestamp = static_cast<uint32_t>(std::time(nullptr));
-            respHeader.toNetworkOrder();
-            sendAll(&respHeader, sizeof(respHeader));
-
-            Protocol::CaptureResponse response;
-            response.capture_id = header.message_id;
-            response.image_size = static_cast<uint32_t>(photo_data.size());
-            std::snprintf(response.filename, sizeof(response.filename), "capture_%u.jpg", header.message_id);
-            response.toNetworkOrder();
-            sendAll(&response, sizeof(response));
-
-            if (!photo_data.empty()) {
-                sendAll(photo_data.data(), photo_data.size());
-            }
-            LOG_I("Photo captured and sent: " << response.filename);
+        if (sessions_.size() >= MAX_CLIENTS) {
+            LOG_W("[CameraReactor] too many clients, rejecting " << socket.peerAddress().toString());
+            return;
         }
+        auto session = std::make_unique<CameraSession>(socket, loop_, pipeline_, registry_);
+        if (session->open()) sessions_.push_back(std::move(session));
     }
 
-    std::queue<cv::Mat>& frame_queue_;
-    std::mutex& frame_mutex_;
-    std::condition_variable& frame_cv_;
-    std::atomic<bool> running_;
-    std::atomic<uint32_t> next_message_id_;
-};
+    void pumpAll() {
+        for (auto& session : sessions_) session->pump();
+        sweep();
+    }
 
-// ========== 连接工厂 ==========
-class CameraConnectionFactory : public Poco::Net::TCPServerConnectionFactory {
-public:
-    CameraConnectionFactory(std::queue<cv::Mat>& frame_queue,
-                            std::mutex& frame_mutex,
-                            std::condition_variable& frame_cv)
-        : frame_queue_(frame_queue),
-          frame_mutex_(frame_mutex),
-          frame_cv_(frame_cv) {}
+    void tickAll() {
+        uint64_t now = monotonicNs();
+        for (auto& session : sessions_) session->tick(now);
+        sweep();
+    }
 
-    Poco::Net::TCPServerConnection* createConnection(const Poco::Net::StreamSocket& socket) override {
-        return new CameraConnection(socket, frame_queue_, frame_mutex_, frame_cv_);
+    // 释放已经关闭的连接（连接不能在自己的回调里删除自己）
+    void sweep() {
+        sessions_.erase(std::remove_if(sessions_.begin(), sessions_.end(),
+                                       [](const std::unique_ptr<CameraSession>& s) { return s->closed(); }),
+                        sessions_.end());
     }
 
-private:
-    std::queue<cv::Mat>& frame_queue_;
-    std::mutex& frame_mutex_;
-    std::condition_variable& frame_cv_;
+    Poco::Net::ServerSocket server_socket_;
+    CapturePipeline& pipeline_;
+    ClientRegistry& registry_;
+    EventLoop loop_;
+    std::vector<std::unique_ptr<CameraSession>> sessions_;  // 只在循环线程里访问
+    std::thread thread_;
 };
 
 // ========== 主服务 ==========
@@ -345,32 +124,120 @@ protected:
     int main(const std::vector<std::string>& args) override {
         unsigned short port = 8888;
         if (!args.empty()) port = static_cast<unsigned short>(std::stoi(args[0]));
-        LOG_I("=== 启动相机服务器（rpicam-vid MJPEG）=== 端口: " << port);
-
-        // 启动 rpicam 采集线程
-        reader_ = std::make_unique<RpiCamMjpegReader>(frame_queue_, frame_mutex_, frame_cv_);
-        reader_->start();
+        // 第二个参数选择采集源（见 makeCaptureSource），默认进程内 libcamera，打不开时退回 rpicam-vid 管道；
+        // 第三个参数选择 JPEG 编码后端（见 makeJpegEncoder），默认 auto；
+        // 第四个参数 "wake" 或 "wake:<空闲帧率>" 启用按需唤醒（见 activity_gate.hpp），不给时一直满帧率
+        std::string spec = args.size() > 1 ? args[1] : "libcamera";
+        std::string backend = args.size() > 2 ? args[2] : "auto";
+        std::string wake = args.size() > 3 ? args[3] : "";
+        LOG_I("=== 启动相机服务器（" << spec << "）=== 端口: " << port);
+
+        CaptureConfig config;
+        auto encoder = makeJpegEncoder(backend);
+        if (!encoder) {
+            LOG_E("JPEG encoder unavailable: " << backend);
+            return Poco::Util::Application::EXIT_USAGE;
+        }
+        LOG_I("JPEG encoder: " << encoder->name());
+        pipeline_ = std::make_unique<CapturePipeline>(mjpeg_, h264_, std::move(encoder), config.quality);
+        // 降级档位用单独的编码器实例（硬件编码器一个实例只能同时编一种尺寸）
+        if (auto tier_encoder = makeJpegEncoder(backend)) pipeline_->enableTiers(std::move(tier_encoder));
+        // 抓拍回看环：最近 10 秒（640x480 的 MJPEG 大约 1MB/s），最多 16MB
+        pipeline_->enableCaptureRing(16 << 20, 10);
+
+        // 本机视觉程序走共享内存环（ShmRing::Reader），不经过 TCP 和 JPEG 解码；
+        // 原始帧槽位按行多留一点，libcamera 的行跨度可能比 width * 3 大
+        ShmRing::Server::RingConfig rings[ShmRing::STREAM_COUNT] = {
+            {4, size_t(config.width * 3 + 256) * config.height},
+            {8, 1 << 20},
+        };
+        if (shm_.start(ShmRing::DEFAULT_SOCKET, rings)) {
+            pipeline_->setShmServer(&shm_);
+        } else {
+            LOG_W("Shared-memory frame ring unavailable, TCP only.");
+        }
+        source_ = makeCaptureSource(spec, config);
+        if (!source_) {
+            LOG_E("Unknown capture source: " << spec);
+            return Poco::Util::Application::EXIT_USAGE;
+        }
+        // H.264 需要原始帧：只有 libcamera 采集源时才开一个硬件编码器，所有 H.264 观众共用。
+        // 必须在采集源开始送帧之前设置：采集线程在 onRaw 里不加锁读编码器
+        if (source_->producesRaw()) {
+            V4l2H264Encoder::Settings h264;
+            h264.fps = config.fps;
+            h264.idr_period = config.fps * 3;
+            auto h264_encoder = std::make_unique<V4l2H264Encoder>(h264);
+            if (h264_encoder->open()) {
+                pipeline_->enableH264(std::move(h264_encoder));
+            } else {
+                LOG_W("H.264 encoder unavailable, MJPEG only.");
+            }
+        }
+        if (!source_->start(*pipeline_)) {
+            if (spec != "libcamera") return Poco::Util::Application::EXIT_IOERR;
+            LOG_W("libcamera capture unavailable, falling back to rpicam-vid.");
+            // start 失败时 libcamera 已经停下，rpicam-vid 只出 JPEG，这时撤掉 H.264 不会和采集线程竞争
+            pipeline_->enableH264(nullptr);
+            source_ = makeCaptureSource("rpicam", config);
+            if (!source_->start(*pipeline_)) {
+                LOG_E("rpicam-vid capture unavailable too, no capture source.");
+                return Poco::Util::Application::EXIT_IOERR;
+            }
+        }
+        LOG_I("Capture source: " << source_->name());
+
+        pipeline_->start();
+
+        if (wake.rfind("wake", 0) == 0) {
+            ActivityGate::Config gate;
+            gate.active_fps = config.fps;
+            if (wake.size() > 5 && wake[4] == ':') gate.idle_fps = unsigned(std::stoi(wake.substr(5)));
+            gate.idle_fps = std::max(1u, std::min(gate.idle_fps, config.fps));
+            unsigned full_fps = config.fps;
+            if (!gate_.start(CameraWake::DEFAULT_SOCKET, gate, [this, full_fps](unsigned fps) {
+                    // 采集源能改帧率就从源头降（传感器和 ISP 也省下来），不能就在流水线里抽帧
+                    if (source_->setFrameRate(fps)) {
+                        pipeline_->setFrameInterval(0);
+                    } else {
+                        pipeline_->setFrameInterval(fps >= full_fps ? 0 : 1000000000ull / fps);
+                    }
+                })) {
+                LOG_W("Wake socket unavailable, staying at full frame rate.");
+            }
+        }
 
-        // TCP 服务器
-        Poco::Net::ServerSocket server_socket(port);
-        CameraConnectionFactory factory(frame_queue_, frame_mutex_, frame_cv_);
-        Poco::Net::TCPServer server(&factory, server_socket);
-        server.start();
+        // TCP 服务器：一个事件循环线程服务所有连接
+        CameraReactor reactor(port, *pipeline_, registry_);
+        if (!reactor.start()) {
+            LOG_E("Failed to start event loop.");
+            source_->stop();
+            pipeline_->stop();
+            return Poco::Util::Application::EXIT_OSERR;
+        }
         LOG_I("TCP server started on port " << port);
 
         waitForTerminationRequest();
 
-        server.stop();
-        reader_->stop();
+        gate_.stop();
+        reactor.stop();
+        mjpeg_.close();
+        h264_.close();
+        source_->stop();
+        pipeline_->stop();
+        shm_.stop();
         LOG_I("Server stopped.");
         return 0;
     }
 
 private:
-    std::unique_ptr<RpiCamMjpegReader> reader_;
-    std::queue<cv::Mat> frame_queue_;
-    std::mutex frame_mutex_;
-    std::condition_variable frame_cv_;
+    FrameBroadcaster mjpeg_;
+    FrameBroadcaster h264_;
+    std::unique_ptr<CapturePipeline> pipeline_;
+    std::unique_ptr<CaptureSource> source_;
+    ClientRegistry registry_;
+    ShmRing::Server shm_;
+    ActivityGate gate_;
 };
 
 // ========== 入口 ==========
@@ -0,0 +1,128 @@
+// 共享内存帧环的读者延迟压测：
+//   ./shm_bench                     连到正在运行的 camera_server，统计 10 秒
+//   ./shm_bench <socket> <秒>
+//   ./shm_bench --self [fps] [读者数]  自己发布合成的 640x480 BGR 帧，fork 出几个读者进程，不需要相机
+// 输出每个读者从帧写进环到被唤醒的延迟（wake）、采集到被唤醒的延迟（age）、读完整帧的时间（touch），以及被覆盖的次数。
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../include/latency_stats.hpp"
+#include "../include/shm_ring.hpp"
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+static void print(const char* name, const LatencyHistogram& h) {
+    LatencyHistogram::Summary s = h.summary();
+    std::printf("  %-6s n=%-6llu p50=%7.3f ms  p99=%7.3f ms  max=%7.3f ms\n", name, (unsigned long long)s.count,
+                s.p50_us / 1000.0, s.p99_us / 1000.0, s.max_us / 1000.0);
+}
+
+// 读者：每次被唤醒取两路流的最新帧，把数据完整读一遍
+static int runReader(const std::string& socket_path, double seconds, int id) {
+    ShmRing::Reader reader;
+    for (int i = 0; i < 50 && !reader.connect(socket_path); ++i) usleep(20000);
+    if (reader.eventFd() < 0) {
+        std::fprintf(stderr, "reader %d: cannot connect to %s\n", id, socket_path.c_str());
+        return 1;
+    }
+
+    LatencyHistogram wake, age, touch;
+    uint64_t frames = 0, torn = 0, last_seq[ShmRing::STREAM_COUNT] = {};
+    volatile uint64_t sink = 0;
+    uint64_t end = monotonicNs() + uint64_t(seconds * 1e9);
+    while (monotonicNs() < end) {
+        if (!reader.wait(200)) continue;
+        uint64_t woke = monotonicNs();
+        for (int s = 0; s < ShmRing::STREAM_COUNT; ++s) {
+            ShmRing::FrameView view;
+            if (!reader.latest(ShmRing::Stream(s), view) || view.ring_seq + 1 == last_seq[s]) continue;
+            last_seq[s] = view.ring_seq + 1;
+            wake.record((woke - view.published_ns) / 1000);
+            if (view.capture_ns) age.record((woke - view.capture_ns) / 1000);
+
+            uint64_t t0 = monotonicNs();
+            uint64_t sum = 0;
+            for (size_t i = 0; i < view.bytes; i += 64) sum += view.data[i];
+            sink = sink + sum;
+            touch.record((monotonicNs() - t0) / 1000);
+            if (reader.valid(view)) {
+                frames++;
+            } else {
+                torn++;
+            }
+        }
+    }
+    std::printf("reader %d: frames=%llu overwritten=%llu\n", id, (unsigned long long)frames,
+                (unsigned long long)torn);
+    print("wake", wake);
+    print("age", age);
+    print("touch", touch);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--self") == 0) {
+        unsigned fps = argc > 2 ? unsigned(std::atoi(argv[2])) : 30;
+        int readers = argc > 3 ? std::atoi(argv[3]) : 2;
+        double seconds = 5;
+        std::string path = "@shm_bench/" + std::to_string(getpid());
+
+        const unsigned w = 640, h = 480;
+        // 先 fork 读者（它们会重试连接），再起服务端线程
+        std::vector<pid_t> children;
+        for (int i = 0; i < readers; ++i) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int rc = runReader(path, seconds, i);
+                std::fflush(stdout);
+                _exit(rc);
+            }
+            children.push_back(pid);
+        }
+        ShmRing::Server server;
+        ShmRing::Server::RingConfig rings[ShmRing::STREAM_COUNT] = {{4, w * h * 3}, {8, 256 << 10}};
+        if (!server.start(path, rings)) return 1;
+
+        // 合成帧：BGR 原始帧 + 一段假的 JPEG
+        std::vector<uint8_t> bgr(w * h * 3), jpeg(40 << 10);
+        auto period = std::chrono::nanoseconds(1000000000ull / fps);
+        auto next = std::chrono::steady_clock::now();
+        uint64_t end = monotonicNs() + uint64_t((seconds + 1) * 1e9);
+        for (uint32_t seq = 0; monotonicNs() < end; ++seq) {
+            std::memset(bgr.data(), int(seq), bgr.size());
+            ShmRing::FrameInfo info;
+            info.frame_seq = seq;
+            info.capture_ns = monotonicNs();
+            info.format = ShmRing::PixelFormat::BGR888;
+            info.width = w;
+            info.height = h;
+            info.stride = w * 3;
+            ShmRing::Part raw{bgr.data(), bgr.size()};
+            server.publish(ShmRing::Stream::Raw, info, &raw, 1);
+            info.format = ShmRing::PixelFormat::Jpeg;
+            info.stride = 0;
+            ShmRing::Part enc{jpeg.data(), jpeg.size()};
+            server.publish(ShmRing::Stream::Jpeg, info, &enc, 1);
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        for (pid_t pid : children) waitpid(pid, nullptr, 0);
+        server.stop();
+        return 0;
+    }
+
+    std::string path = argc > 1 ? argv[1] : ShmRing::DEFAULT_SOCKET;
+    double seconds = argc > 2 ? std::atof(argv[2]) : 10;
+    return runReader(path, seconds, 0);
+}
@@ -0,0 +1,364 @@
+#include "../include/shm_ring.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ShmRing {
+
+// 连接建立时服务端发给读者的消息，随附 SCM_RIGHTS：[eventfd, 各个环的 memfd]
+struct Handshake {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_count;
+};
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+static size_t align64(size_t n) { return (n + 63) & ~size_t(63); }
+
+// "@name" 为抽象命名空间，否则为文件路径
+static socklen_t makeAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    size_t n = std::min(path.size(), sizeof(addr.sun_path) - 1);
+    std::memcpy(addr.sun_path, path.data(), n);
+    if (path[0] == '@') addr.sun_path[0] = '\0';
+    return socklen_t(offsetof(sockaddr_un, sun_path) + n + (path[0] == '@' ? 0 : 1));
+}
+
+static const SlotHeader* slotAt(const uint8_t* base, uint64_t index) {
+    const RingHeader* ring = reinterpret_cast<const RingHeader*>(base);
+    return reinterpret_cast<const SlotHeader*>(base + sizeof(RingHeader) + index * ring->slot_stride);
+}
+
+// ========== Writer ==========
+
+Writer::~Writer() {
+    if (base_) munmap(base_, size_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool Writer::create(const char* name, uint32_t slot_count, size_t slot_bytes) {
+    size_t stride = sizeof(SlotHeader) + align64(slot_bytes);
+    size_ = sizeof(RingHeader) + stride * slot_count;
+    fd_ = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd_ < 0 || ftruncate(fd_, off_t(size_)) < 0) return false;
+    void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) return false;
+    base_ = static_cast<uint8_t*>(p);
+
+    // 之后谁也不能改大小，读者也拿不到可写映射（老内核不支持 F_SEAL_FUTURE_WRITE 时只封大小）
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#ifdef F_SEAL_FUTURE_WRITE
+    if (fcntl(fd_, F_ADD_SEALS, seals | F_SEAL_FUTURE_WRITE) < 0) fcntl(fd_, F_ADD_SEALS, seals);
+#else
+    fcntl(fd_, F_ADD_SEALS, seals);
+#endif
+
+    RingHeader* ring = new (base_) RingHeader();
+    ring->magic = MAGIC;
+    ring->version = VERSION;
+    ring->slot_count = slot_count;
+    ring->slot_bytes = slot_bytes;
+    ring->slot_stride = stride;
+    ring->write_seq.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        new (base_ + sizeof(RingHeader) + i * stride) SlotHeader();
+    }
+    return true;
+}
+
+bool Writer::publish(const FrameInfo& info, const Part* parts, size_t part_count) {
+    RingHeader* ring = reinterpret_cast<RingHeader*>(base_);
+    size_t total = 0;
+    for (size_t i = 0; i < part_count; ++i) total += parts[i].len;
+    if (!base_ || total > ring->slot_bytes) return false;
+
+    uint64_t seq = ring->write_seq.load(std::memory_order_relaxed);
+    SlotHeader* slot = const_cast<SlotHeader*>(slotAt(base_, seq % ring->slot_count));
+    uint64_t lock = slot->lock.load(std::memory_order_relaxed);
+
+    // 锁变成奇数之后才能动数据：读者看到奇数或前后不一致就知道这个槽位正在被改写
+    slot->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(slot) + sizeof(SlotHeader);
+    for (size_t i = 0; i < part_count; ++i) {
+        std::memcpy(dst, parts[i].data, parts[i].len);
+        dst += parts[i].len;
+    }
+    slot->ring_seq = seq;
+    slot->capture_ns = info.capture_ns;
+    slot->published_ns = monotonicNs();
+    slot->frame_seq = info.frame_seq;
+    slot->format = info.format;
+    slot->width = info.width;
+    slot->height = info.height;
+    slot->stride = info.stride;
+    slot->bytes = uint32_t(total);
+
+    slot->lock.store(lock + 2, std::memory_order_release);
+    ring->write_seq.store(seq + 1, std::memory_order_release);
+    return true;
+}
+
+// ========== Server ==========
+
+Server::~Server() {
+    stop();
+}
+
+bool Server::start(const std::string& socket_path, const RingConfig (&rings)[STREAM_COUNT]) {
+    static const char* const names[STREAM_COUNT] = {"camera-raw", "camera-jpeg"};
+    for (int i = 0; i < STREAM_COUNT; ++i) {
+        if (!rings_[i].create(names[i], rings[i].slot_count, rings[i].slot_bytes)) {
+            std::fprintf(stderr, "[ShmRing] memfd for %s: %s\n", names[i], strerror(errno));
+            return false;
+        }
+    }
+
+    sockaddr_un addr;
+    socklen_t len = makeAddress(socket_path, addr);
+    if (socket_path[0] != '@') ::unlink(socket_path.c_str());
+    listen_fd_ = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (listen_fd_ < 0 || stop_fd_ < 0 || ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) < 0 ||
+        ::listen(listen_fd_, 8) < 0) {
+        std::fprintf(stderr, "[ShmRing] listen on %s: %s\n", socket_path.c_str(), strerror(errno));
+        return false;
+    }
+    thread_ = std::thread(&Server::run, this);
+    return true;
+}
+
+void Server::stop() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t n = ::write(stop_fd_, &one, sizeof(one));
+        (void)n;
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!clients_.empty()) drop(clients_.size() - 1);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    if (stop_fd_ >= 0) ::close(stop_fd_);
+    listen_fd_ = stop_fd_ = -1;
+}
+
+void Server::run() {
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({stop_fd_, POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const Client& c : clients_) fds.push_back({c.sock, POLLIN, 0});
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) break;
+        if (fds[1].revents & POLLIN) accept();
+
+        // 读者只会在退出时关闭连接（不发任何数据）：可读或挂断都当作断开
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = fds.size(); i-- > 2;) {
+            if (!fds[i].revents) continue;
+            for (size_t k = 0; k < clients_.size(); ++k) {
+                if (clients_[k].sock == fds[i].fd) {
+                    drop(k);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Server::accept() {
+    int sock = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) return;
+    int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd < 0) {
+        ::close(sock);
+        return;
+    }
+
+    Handshake hs{MAGIC, VERSION, STREAM_COUNT};
+    iovec iov{&hs, sizeof(hs)};
+    int fds[1 + STREAM_COUNT] = {efd};
+    for (int i = 0; i < STREAM_COUNT; ++i) fds[1 + i] = rings_[i].fd();
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    if (::sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+        ::close(efd);
+        ::close(sock);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.push_back({sock, efd});
+    readers_.store(int(clients_.size()), std::memory_order_relaxed);
+    std::fprintf(stderr, "[ShmRing] reader connected (%zu total)\n", clients_.size());
+}
+
+void Server::drop(size_t index) {
+    ::close(clients_[index].sock);
+    ::close(clients_[index].event_fd);
+    clients_.erase(clients_.begin() + long(index));
+    readers_.store(int(clients_.size()), std::memory_order_relaxed);
+}
+
+bool Server::publish(Stream stream, const FrameInfo& info, const Part* parts, size_t part_count) {
+    if (!rings_[int(stream)].publish(info, parts, part_count)) return false;
+    uint64_t one = 1;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Client& c : clients_) {
+        ssize_t n = ::write(c.event_fd, &one, sizeof(one));
+        (void)n;  // 读者很久没取时计数器会满（EAGAIN），反正它醒来只看最新帧
+    }
+    return true;
+}
+
+// ========== Reader ==========
+
+Reader::~Reader() {
+    close();
+}
+
+bool Reader::connect(const std::string& socket_path) {
+    close();
+    sockaddr_un addr;
+    socklen_t len = makeAddress(socket_path, addr);
+    sock_ = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock_ < 0 || ::connect(sock_, reinterpret_cast<sockaddr*>(&addr), len) < 0) {
+        close();
+        return false;
+    }
+
+    Handshake hs{};
+    iovec iov{&hs, sizeof(hs)};
+    int fds[1 + STREAM_COUNT];
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = ::recvmsg(sock_, &msg, MSG_CMSG_CLOEXEC);
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    if (n != ssize_t(sizeof(hs)) || hs.magic != MAGIC || hs.version != VERSION || !cm ||
+        cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        close();
+        return false;
+    }
+    std::memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    event_fd_ = fds[0];
+
+    bool ok = true;
+    for (int i = 0; i < STREAM_COUNT; ++i) {
+        // 只读映射，映射之后 memfd 本身就不需要了
+        off_t size = lseek(fds[1 + i], 0, SEEK_END);
+        void* p = size > 0 ? mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fds[1 + i], 0) : MAP_FAILED;
+        ::close(fds[1 + i]);
+        if (p == MAP_FAILED) {
+            ok = false;
+            continue;
+        }
+        rings_[i] = static_cast<const uint8_t*>(p);
+        sizes_[i] = size_t(size);
+        ok = ok && reinterpret_cast<const RingHeader*>(p)->magic == MAGIC;
+    }
+    if (!ok) close();
+    return ok;
+}
+
+void Reader::close() {
+    for (int i = 0; i < STREAM_COUNT; ++i) {
+        if (rings_[i]) munmap(const_cast<uint8_t*>(rings_[i]), sizes_[i]);
+        rings_[i] = nullptr;
+        sizes_[i] = 0;
+    }
+    if (event_fd_ >= 0) ::close(event_fd_);
+    if (sock_ >= 0) ::close(sock_);
+    event_fd_ = sock_ = -1;
+}
+
+bool Reader::wait(int timeout_ms) {
+    pollfd pfd{event_fd_, POLLIN, 0};
+    if (::poll(&pfd, 1, timeout_ms) <= 0) return false;
+    uint64_t count;
+    return ::read(event_fd_, &count, sizeof(count)) == ssize_t(sizeof(count));
+}
+
+bool Reader::latest(Stream stream, FrameView& view) const {
+    const uint8_t* base = rings_[int(stream)];
+    if (!base) return false;
+    const RingHeader* ring = reinterpret_cast<const RingHeader*>(base);
+    // 最新的槽位正在被改写时退回前一个
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        uint64_t written = ring->write_seq.load(std::memory_order_acquire);
+        if (written <= uint64_t(attempt)) return false;
+        const SlotHeader* slot = slotAt(base, (written - 1 - attempt) % ring->slot_count);
+        uint64_t lock = slot->lock.load(std::memory_order_acquire);
+        if (lock & 1) continue;
+
+        view.slot_ = slot;
+        view.lock_ = lock;
+        view.data = reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader);
+        view.bytes = slot->bytes;
+        view.ring_seq = slot->ring_seq;
+        view.capture_ns = slot->capture_ns;
+        view.published_ns = slot->published_ns;
+        view.frame_seq = slot->frame_seq;
+        view.format = slot->format;
+        view.width = slot->width;
+        view.height = slot->height;
+        view.stride = slot->stride;
+        if (view.bytes <= ring->slot_bytes && valid(view)) return true;
+    }
+    return false;
+}
+
+bool Reader::valid(const FrameView& view) const {
+    if (!view.slot_) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot_->lock.load(std::memory_order_relaxed) == view.lock_;
+}
+
+bool Reader::copyLatest(Stream stream, std::vector<uint8_t>& out, FrameView& info) const {
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        if (!latest(stream, info)) return false;
+        out.assign(info.data, info.data + info.bytes);
+        if (valid(info)) {
+            info.data = out.data();
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace ShmRing
@@ -0,0 +1,45 @@
+#include "../include/v4l2_h264_encoder.hpp"
+#include "../include/h264_nal.hpp"
+#include "../include/log.hpp"
+
+V4l2H264Encoder::V4l2H264Encoder(const Settings& settings, std::string device)
+    : settings_(settings), dev_(std::move(device)) {}
+
+bool V4l2H264Encoder::open() {
+    return dev_.open(V4L2_PIX_FMT_H264);
+}
+
+bool V4l2H264Encoder::configure(const RawFrame& frame) {
+    // 输出端多给几个缓冲区：设备可能把参数集单独放一个缓冲区吐出来
+    if (!dev_.configure(frame, V4L2_PIX_FMT_H264, frame.width * frame.height * 3 / 2, 4)) return false;
+
+    // 低延迟直播：Baseline（无 B 帧）、每个 IDR 前都重复 SPS/PPS、固定码率
+    dev_.setControl(V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_CONSTRAINED_BASELINE);
+    dev_.setControl(V4L2_CID_MPEG_VIDEO_H264_LEVEL, V4L2_MPEG_VIDEO_H264_LEVEL_4_0);
+    dev_.setControl(V4L2_CID_MPEG_VIDEO_BITRATE_MODE, V4L2_MPEG_VIDEO_BITRATE_MODE_CBR);
+    dev_.setControl(V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, 1);
+    if (!dev_.setControl(V4L2_CID_MPEG_VIDEO_BITRATE, int32_t(settings_.bitrate)) ||
+        !dev_.setControl(V4L2_CID_MPEG_VIDEO_H264_I_PERIOD, int32_t(settings_.idr_period))) {
+        LOG_W("[h264] " << dev_.device() << " rejected bitrate/I-period controls, using driver defaults.");
+    }
+    if (!dev_.start()) return false;
+    LOG_I("[h264] encoding " << frame.width << "x" << frame.height << " @" << settings_.bitrate / 1000 << " kbit/s");
+    // 新配置的流从 IDR 开始
+    keyframe_requested_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool V4l2H264Encoder::encode(const RawFrame& frame, std::vector<uint8_t>& out, bool& keyframe) {
+    if (!dev_.isOpen()) return false;
+    if (!dev_.matches(frame) && !configure(frame)) return false;
+
+    if (keyframe_requested_.exchange(false, std::memory_order_relaxed)) {
+        dev_.setControl(V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 1);
+    }
+    uint32_t flags = 0;
+    bool ok = dev_.process(frame, out, flags, [](const std::vector<uint8_t>& au) {
+        return H264::containsPicture(au.data(), au.size());
+    });
+    keyframe = ok && ((flags & V4L2_BUF_FLAG_KEYFRAME) || H264::isKeyframe(out.data(), out.size()));
+    return ok;
+}
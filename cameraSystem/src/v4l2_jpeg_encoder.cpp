@@ -0,0 +1,24 @@
+#include "../include/v4l2_jpeg_encoder.hpp"
+
+V4l2JpegEncoder::V4l2JpegEncoder(std::string device) : dev_(std::move(device)) {}
+
+bool V4l2JpegEncoder::open() {
+    return dev_.open(V4L2_PIX_FMT_JPEG);
+}
+
+bool V4l2JpegEncoder::encode(const RawFrame& frame, int quality, std::vector<uint8_t>& out) {
+    if (!dev_.isOpen()) return false;
+    if (!dev_.matches(frame)) {
+        // 一进一出，输出端一个缓冲区就够；JPEG 不会超过原始 I420 的大小
+        if (!dev_.configure(frame, V4L2_PIX_FMT_JPEG, frame.width * frame.height * 3 / 2, 1) || !dev_.start()) {
+            return false;
+        }
+        quality_ = -1;
+    }
+    if (quality != quality_) {
+        if (!dev_.setControl(V4L2_CID_JPEG_COMPRESSION_QUALITY, quality)) return false;
+        quality_ = quality;
+    }
+    uint32_t flags = 0;
+    return dev_.process(frame, out, flags, [](const std::vector<uint8_t>&) { return true; });
+}
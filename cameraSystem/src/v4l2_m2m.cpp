@@ -0,0 +1,260 @@
+#include "../include/v4l2_m2m.hpp"
+#include "../include/log.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr uint32_t OUT_TYPE = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;   // 送进设备的原始帧
+static constexpr uint32_t CAP_TYPE = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;  // 设备吐出的码流
+
+V4l2M2m::V4l2M2m(std::string device) : device_(std::move(device)) {}
+
+V4l2M2m::~V4l2M2m() {
+    release();
+    if (fd_ >= 0) ::close(fd_);
+}
+
+int V4l2M2m::xioctl(unsigned long request, void* arg) {
+    int rc;
+    do {
+        rc = ioctl(fd_, request, arg);
+    } while (rc < 0 && errno == EINTR);
+    return rc;
+}
+
+bool V4l2M2m::open(uint32_t capture_fourcc) {
+    fd_ = ::open(device_.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) return false;
+
+    v4l2_capability cap{};
+    bool ok = xioctl(VIDIOC_QUERYCAP, &cap) == 0;
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    ok = ok && (caps & V4L2_CAP_VIDEO_M2M_MPLANE) && (caps & V4L2_CAP_STREAMING);
+
+    bool found = false;
+    for (uint32_t i = 0; ok && !found; ++i) {
+        v4l2_fmtdesc desc{};
+        desc.index = i;
+        desc.type = CAP_TYPE;
+        if (xioctl(VIDIOC_ENUM_FMT, &desc) < 0) break;
+        found = desc.pixelformat == capture_fourcc;
+    }
+    if (!ok || !found) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    LOG_I("[v4l2] " << device_ << " (" << reinterpret_cast<const char*>(cap.card) << ")");
+    return true;
+}
+
+bool V4l2M2m::matches(const RawFrame& frame) const {
+    return !out_maps_.empty() && frame.width == width_ && frame.height == height_ && frame.format == format_;
+}
+
+void V4l2M2m::release() {
+    if (fd_ < 0) return;
+    if (streaming_) {
+        uint32_t type = OUT_TYPE;
+        xioctl(VIDIOC_STREAMOFF, &type);
+        type = CAP_TYPE;
+        xioctl(VIDIOC_STREAMOFF, &type);
+        streaming_ = false;
+    }
+    for (const Mapping& m : out_maps_) munmap(m.ptr, m.length);
+    for (const Mapping& m : cap_maps_) munmap(m.ptr, m.length);
+    out_maps_.clear();
+    cap_maps_.clear();
+
+    v4l2_requestbuffers req{};
+    req.memory = V4L2_MEMORY_MMAP;
+    req.count = 0;
+    req.type = OUT_TYPE;
+    xioctl(VIDIOC_REQBUFS, &req);
+    req.type = CAP_TYPE;
+    xioctl(VIDIOC_REQBUFS, &req);
+    width_ = height_ = 0;
+}
+
+bool V4l2M2m::requestBuffers(uint32_t type, unsigned count, std::vector<Mapping>& maps) {
+    v4l2_requestbuffers req{};
+    req.count = count;
+    req.type = type;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count < 1) return false;
+
+    for (uint32_t i = 0; i < req.count; ++i) {
+        v4l2_plane plane{};
+        v4l2_buffer buf{};
+        buf.type = type;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        buf.m.planes = &plane;
+        buf.length = 1;
+        if (xioctl(VIDIOC_QUERYBUF, &buf) < 0) return false;
+        void* ptr = mmap(nullptr, plane.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, plane.m.mem_offset);
+        if (ptr == MAP_FAILED) return false;
+        maps.push_back({ptr, plane.length});
+    }
+    return true;
+}
+
+bool V4l2M2m::configure(const RawFrame& frame, uint32_t capture_fourcc, uint32_t capture_size, unsigned capture_buffers) {
+    release();
+
+    v4l2_format fmt{};
+    fmt.type = OUT_TYPE;
+    fmt.fmt.pix_mp.width = frame.width;
+    fmt.fmt.pix_mp.height = frame.height;
+    fmt.fmt.pix_mp.pixelformat = frame.format == RawPixelFormat::BGR888 ? V4L2_PIX_FMT_BGR24 : V4L2_PIX_FMT_YUV420;
+    fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+    fmt.fmt.pix_mp.num_planes = 1;
+    if (xioctl(VIDIOC_S_FMT, &fmt) < 0 || fmt.fmt.pix_mp.width != frame.width || fmt.fmt.pix_mp.height < frame.height) {
+        LOG_E("[v4l2] " << device_ << " input format " << frame.width << "x" << frame.height << " rejected.");
+        return false;
+    }
+    out_stride_ = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    out_height_ = fmt.fmt.pix_mp.height;
+    out_size_ = fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
+
+    v4l2_format cfmt{};
+    cfmt.type = CAP_TYPE;
+    cfmt.fmt.pix_mp.width = frame.width;
+    cfmt.fmt.pix_mp.height = frame.height;
+    cfmt.fmt.pix_mp.pixelformat = capture_fourcc;
+    cfmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+    cfmt.fmt.pix_mp.num_planes = 1;
+    cfmt.fmt.pix_mp.plane_fmt[0].sizeimage = capture_size;
+    if (xioctl(VIDIOC_S_FMT, &cfmt) < 0) {
+        LOG_E("[v4l2] " << device_ << " output format rejected.");
+        return false;
+    }
+
+    if (!requestBuffers(OUT_TYPE, 1, out_maps_) || !requestBuffers(CAP_TYPE, capture_buffers, cap_maps_)) {
+        LOG_E("[v4l2] " << device_ << " buffer setup failed: " << strerror(errno));
+        release();
+        return false;
+    }
+    width_ = frame.width;
+    height_ = frame.height;
+    format_ = frame.format;
+    return true;
+}
+
+bool V4l2M2m::setControl(uint32_t id, int32_t value) {
+    v4l2_control ctrl{};
+    ctrl.id = id;
+    ctrl.value = value;
+    return xioctl(VIDIOC_S_CTRL, &ctrl) == 0;
+}
+
+bool V4l2M2m::queueCapture(uint32_t index) {
+    v4l2_plane plane{};
+    plane.length = uint32_t(cap_maps_[index].length);
+    v4l2_buffer buf{};
+    buf.type = CAP_TYPE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    buf.m.planes = &plane;
+    buf.length = 1;
+    return xioctl(VIDIOC_QBUF, &buf) == 0;
+}
+
+bool V4l2M2m::start() {
+    for (uint32_t i = 0; i < cap_maps_.size(); ++i) {
+        if (!queueCapture(i)) {
+            release();
+            return false;
+        }
+    }
+    uint32_t type = OUT_TYPE;
+    bool ok = xioctl(VIDIOC_STREAMON, &type) == 0;
+    type = CAP_TYPE;
+    ok = ok && xioctl(VIDIOC_STREAMON, &type) == 0;
+    streaming_ = true;
+    if (!ok) {
+        LOG_E("[v4l2] " << device_ << " STREAMON failed: " << strerror(errno));
+        release();
+    }
+    return ok;
+}
+
+void V4l2M2m::copyInput(const RawFrame& frame) {
+    // 按设备的行跨度拷进输入缓冲区
+    uint8_t* dst = static_cast<uint8_t*>(out_maps_[0].ptr);
+    if (frame.format == RawPixelFormat::BGR888) {
+        const RawFrame::Plane& src = frame.planes[0];
+        size_t row = size_t(frame.width) * 3;
+        for (uint32_t y = 0; y < frame.height; ++y) {
+            std::memcpy(dst + size_t(y) * out_stride_, src.data + size_t(y) * src.stride, row);
+        }
+        return;
+    }
+    // I420：Y 平面之后依次是 U、V，色度的跨度和高度都是亮度的一半
+    const uint32_t widths[3] = {frame.width, frame.width / 2, frame.width / 2};
+    const uint32_t heights[3] = {frame.height, frame.height / 2, frame.height / 2};
+    const uint32_t strides[3] = {out_stride_, out_stride_ / 2, out_stride_ / 2};
+    const size_t offsets[3] = {0, size_t(out_stride_) * out_height_, size_t(out_stride_) * out_height_ * 5 / 4};
+    for (unsigned p = 0; p < 3 && p < frame.plane_count; ++p) {
+        const RawFrame::Plane& src = frame.planes[p];
+        for (uint32_t y = 0; y < heights[p]; ++y) {
+            std::memcpy(dst + offsets[p] + size_t(y) * strides[p], src.data + size_t(y) * src.stride, widths[p]);
+        }
+    }
+}
+
+bool V4l2M2m::process(const RawFrame& frame, std::vector<uint8_t>& out, uint32_t& flags,
+                      const std::function<bool(const std::vector<uint8_t>&)>& done) {
+    out.clear();
+    flags = 0;
+    copyInput(frame);
+
+    v4l2_plane oplane{};
+    oplane.bytesused = out_size_;
+    oplane.length = uint32_t(out_maps_[0].length);
+    v4l2_buffer obuf{};
+    obuf.type = OUT_TYPE;
+    obuf.memory = V4L2_MEMORY_MMAP;
+    obuf.index = 0;
+    obuf.m.planes = &oplane;
+    obuf.length = 1;
+    if (xioctl(VIDIOC_QBUF, &obuf) < 0) {
+        LOG_E("[v4l2] " << device_ << " QBUF failed: " << strerror(errno));
+        release();  // 下一帧重新配置
+        return false;
+    }
+
+    // 收集输出：有的设备会把参数集和图像分成几个缓冲区吐出来
+    bool ok = false;
+    while (!ok) {
+        pollfd pfd{fd_, POLLIN, 0};
+        v4l2_plane cplane{};
+        v4l2_buffer cbuf{};
+        cbuf.type = CAP_TYPE;
+        cbuf.memory = V4L2_MEMORY_MMAP;
+        cbuf.m.planes = &cplane;
+        cbuf.length = 1;
+        if (poll(&pfd, 1, 1000) <= 0 || xioctl(VIDIOC_DQBUF, &cbuf) < 0) {
+            LOG_E("[v4l2] " << device_ << " timed out.");
+            release();
+            return false;
+        }
+        const uint8_t* p = static_cast<const uint8_t*>(cap_maps_[cbuf.index].ptr) + cplane.data_offset;
+        out.insert(out.end(), p, p + (cplane.bytesused - cplane.data_offset));
+        flags |= cbuf.flags;
+        queueCapture(cbuf.index);
+        if (cbuf.flags & V4L2_BUF_FLAG_ERROR) break;
+        ok = done(out);
+    }
+
+    // 取回输入缓冲区，下一帧继续用
+    while (xioctl(VIDIOC_DQBUF, &obuf) < 0 && errno == EAGAIN) {
+        pollfd opfd{fd_, POLLOUT, 0};
+        if (poll(&opfd, 1, 100) <= 0) break;
+    }
+    return ok && !out.empty();
+}
@@ -0,0 +1,48 @@
+#include "cameratrigger.hpp"
+#include "ringlog.hpp"
+#include <algorithm>
+
+CameraTrigger::CameraTrigger(const Config& config) : config_(config), sender_(config.socketPath) {}
+
+CameraTrigger::Event CameraTrigger::update(const RangeSample& sample, const RangeReading& reading) {
+    uint64_t now = sample.timestampNs;
+    bool valid = sample.status == RangeSample::Status::Ok || sample.status == RangeSample::Status::OutOfRange;
+    if (valid) lastValidNs_ = now;
+
+    // 窗口还没攒够（刚启动或超时清空过）时不改变状态
+    if (reading.windowSize >= 3 && valid) {
+        float projected = reading.smoothedCm + std::min(reading.velocityCmS, 0.0f) * config_.leadSec;
+        bool wantEnter = reading.medianCm <= config_.enterCm || projected <= config_.enterCm;
+        bool wantLeave = reading.medianCm > config_.leaveCm && projected > config_.leaveCm;
+        bool toggling = present_ ? wantLeave : wantEnter;
+        streak_ = toggling ? streak_ + 1 : 0;
+        if (streak_ >= config_.confirm) {
+            streak_ = 0;
+            present_ = !present_;
+            send(present_ ? CameraWake::Event::Enter : CameraWake::Event::Leave, reading.medianCm, now);
+            return present_ ? Event::Enter : Event::Leave;
+        }
+    }
+
+    // 续租：只在最近 holdMs 内有有效读数时续，传感器掉线就让服务端的租约自己过期
+    uint64_t holdNs = uint64_t(config_.holdMs) * 1000000ULL;
+    if (present_ && now - lastSentNs_ >= holdNs / 2 && now - lastValidNs_ < holdNs) {
+        send(CameraWake::Event::Hold, reading.medianCm, now);
+        return Event::Hold;
+    }
+    return Event::None;
+}
+
+void CameraTrigger::send(CameraWake::Event event, float cm, uint64_t nowNs) {
+    CameraWake::Message msg;
+    msg.event = event;
+    msg.source = config_.source;
+    msg.hold_ms = config_.holdMs;
+    msg.distance_cm = cm;
+    msg.timestamp_ns = nowNs;
+    lastSentNs_ = nowNs;
+    if (!sender_.send(msg) && sendFailures_++ == 0) {
+        RLOG_W("[CameraTrigger] camera_server 没有在 %s 上监听（启动参数加 wake），消息被丢弃",
+               config_.socketPath.c_str());
+    }
+}
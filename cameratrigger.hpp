@@ -0,0 +1,47 @@
+#pragma once
+#include "ranger.hpp"
+#include "cameraSystem/include/camera_wake.hpp"
+#include <cstdint>
+#include <string>
+
+// ==================== 障碍物触发相机 ====================
+// 把测距读数变成 camera_server 的唤醒消息（cameraSystem/include/camera_wake.hpp）：
+//   - 带回差的门限：中值 <= enterCm 连续 confirm 次才算进入，> leaveCm 连续 confirm 次才算离开，
+//     在门限附近抖动不会让相机反复开关；
+//   - 提前量：卡尔曼平滑的距离按当前接近速度外推 leadSec 秒后会进入门限，也提前唤醒（相机切帧率要几帧时间）；
+//   - 进入发 Enter，障碍物还在时每 holdMs/2 发一次 Hold 续租，离开发 Leave。
+//     传感器程序退出或传感器掉线（holdMs 内没有有效读数就不再续租）时，服务端的租约自己过期，相机照样回到空闲。
+// 消息是非阻塞的 Unix 数据报，服务端没在运行时直接丢掉，不影响测距循环。
+class CameraTrigger {
+public:
+    struct Config {
+        float enterCm{150.0f};
+        float leaveCm{180.0f};   // 必须大于 enterCm
+        float leadSec{0.5f};     // 按接近速度提前这么久唤醒，0 表示不外推
+        uint32_t confirm{2};     // 连续几次读数满足条件才切换状态
+        uint32_t holdMs{1000};   // 租约长度
+        uint8_t source{0};       // 传感器编号（多个传感器各自一份租约）
+        std::string socketPath{CameraWake::DEFAULT_SOCKET};
+    };
+
+    enum class Event { None, Enter, Hold, Leave };
+
+    explicit CameraTrigger(const Config& config);
+
+    // 每个读数调用一次（测距线程）；返回这次发出的消息类型
+    Event update(const RangeSample& sample, const RangeReading& reading);
+
+    bool present() const { return present_; }
+    uint64_t sendFailures() const { return sendFailures_; }
+
+private:
+    void send(CameraWake::Event event, float cm, uint64_t nowNs);
+
+    Config config_;
+    CameraWake::Sender sender_;
+    bool present_{false};
+    uint32_t streak_{0};        // 连续满足切换条件的次数
+    uint64_t lastSentNs_{0};
+    uint64_t lastValidNs_{0};
+    uint64_t sendFailures_{0};
+};
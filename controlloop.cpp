@@ -0,0 +1,172 @@
+#include "controlloop.hpp"
+#include "ringlog.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <cerrno>
+#include <cstring>
+
+static constexpr int64_t NSEC_PER_SEC = 1000000000LL;
+
+static void addNs(timespec& ts, int64_t ns) {
+    ts.tv_nsec += ns;
+    while (ts.tv_nsec >= NSEC_PER_SEC) {
+        ts.tv_nsec -= NSEC_PER_SEC;
+        ts.tv_sec++;
+    }
+}
+
+static int64_t diffNs(const timespec& a, const timespec& b) {
+    return (int64_t)(a.tv_sec - b.tv_sec) * NSEC_PER_SEC + (a.tv_nsec - b.tv_nsec);
+}
+
+ControlLoop::ControlLoop(LOBOROBOT& robot, double rateHz, int cpu, int priority)
+    : robot_(robot), periodNs_(1e9 / rateHz), cpu_(cpu), priority_(priority) {
+    for (auto& a : servoAngle_) a.store(0, std::memory_order_relaxed);
+}
+
+ControlLoop::~ControlLoop() {
+    stop();
+}
+
+void ControlLoop::start() {
+    if (running_) return;
+    running_ = true;
+    worker_ = std::thread(&ControlLoop::run, this);
+}
+
+void ControlLoop::stop() {
+    running_ = false;
+    if (worker_.joinable()) worker_.join();
+}
+
+void ControlLoop::setupThread() {
+    // 绑核：避免被调度到别的核上引起缓存失效和唤醒抖动
+    if (cpu_ >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) RLOG_W("[ControlLoop] 绑定 CPU%d 失败: %s", cpu_, strerror(rc));
+    }
+    // SCHED_FIFO 需要 root 或 CAP_SYS_NICE，失败时退回普通调度继续运行
+    if (priority_ > 0) {
+        sched_param sp{};
+        sp.sched_priority = priority_;
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (rc != 0) RLOG_W("[ControlLoop] 切换 SCHED_FIFO 失败: %s，使用普通调度", strerror(rc));
+    }
+}
+
+void ControlLoop::run() {
+    setupThread();
+
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    const double dt = periodNs_ / 1e9;
+    uint32_t ticks = 0, worstUs = 0;
+
+    while (true) {
+        bool last = !running_.load(std::memory_order_acquire);
+
+        // 本周期所有改动只进影子寄存器，最后一次连续写
+        robot_.beginBatch();
+        ControlCommand cmd;
+        while (queue_.pop(cmd)) apply(cmd);
+        if (!last) {
+            tickSweep(dt);
+            robot_.updateRamps((float)dt);
+        } else {
+            robot_.settleRamps();
+        }
+        robot_.endBatch();
+
+        if (last) break;//stop() 之后再处理一遍队列，保证退出前的指令（比如舵机复位）都执行了
+
+        addNs(next, (int64_t)periodNs_);
+        int rc;
+        do {
+            rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        } while (rc == EINTR);
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t late = diffNs(now, next);
+        if (late > (int64_t)periodNs_) {
+            // 落后超过一个周期（比如被挂起过），从当前时刻重新对齐，不补跑错过的周期
+            next = now;
+        }
+        uint32_t lateUs = late > 0 ? (uint32_t)(late / 1000) : 0;
+        if (lateUs > worstUs) worstUs = lateUs;
+        // 大约每秒发布一次统计
+        if (++ticks * dt >= 1.0) {
+            maxJitterUs_.store(worstUs, std::memory_order_relaxed);
+            ticks = 0;
+            worstUs = 0;
+        }
+    }
+}
+
+void ControlLoop::apply(const ControlCommand& cmd) {
+    switch (cmd.type) {
+    case ControlCommand::Type::Motion:
+        robot_.commitRamped(cmd.frame);
+        break;
+    case ControlCommand::Type::Drive:
+        robot_.driveRamped(cmd.vx, cmd.vy, cmd.omega);
+        break;
+    case ControlCommand::Type::ServoSet:
+        // servoAngle_ 只有 16 个槽位，越界的通道号不能截断成别的通道
+        if (cmd.ch >= PCA9685::CHANNELS) {
+            RLOG_W("[ControlLoop] 舵机通道越界: %d，忽略", cmd.ch);
+            break;
+        }
+        if (sweeping_ && cmd.ch == sweepCh_) sweeping_ = false;//手动控制优先
+        robot_.setServoAngleRamped(cmd.ch, cmd.angle);
+        servoAngle_[cmd.ch].store(cmd.angle, std::memory_order_relaxed);
+        break;
+    case ControlCommand::Type::SweepStart:
+        // tickSweep 直接用 sweepCh_ 下标访问 servoAngle_，越界的命令在这里就丢掉
+        if (cmd.ch >= PCA9685::CHANNELS) {
+            RLOG_W("[ControlLoop] 扫描通道越界: %d，忽略", cmd.ch);
+            break;
+        }
+        sweeping_ = true;
+        sweepCh_ = cmd.ch;
+        sweepStep_ = cmd.step;
+        sweepInterval_ = cmd.interval;
+        sweepMin_ = cmd.minAngle;
+        sweepMax_ = cmd.maxAngle;
+        sweepElapsed_ = 0;
+        break;
+    case ControlCommand::Type::SweepStop:
+        sweeping_ = false;
+        break;
+    }
+}
+
+void ControlLoop::tickSweep(double dt) {
+    if (!sweeping_) return;
+    sweepElapsed_ += dt;
+    if (sweepElapsed_ < sweepInterval_) return;
+    sweepElapsed_ = 0;
+
+    float angle = servoAngle_[sweepCh_].load(std::memory_order_relaxed);
+    if (sweepUp_) {
+        angle += sweepStep_;
+        if (angle >= sweepMax_) {
+            angle = sweepMax_;
+            sweepUp_ = false;
+            RLOG_I("[自动] 到达边界 %.0f 度, 反转", angle);
+        }
+    } else {
+        angle -= sweepStep_;
+        if (angle <= sweepMin_) {
+            angle = sweepMin_;
+            sweepUp_ = true;
+            RLOG_I("[自动] 到达边界 %.0f 度, 反转", angle);
+        }
+    }
+    robot_.setServoAngleRamped(sweepCh_, angle);
+    servoAngle_[sweepCh_].store(angle, std::memory_order_relaxed);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "loborobot.hpp"
+#include "spscqueue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// ==================== 控制线程的指令 ====================
+struct ControlCommand {
+    enum class Type : uint8_t {
+        Motion,     // 下发一帧 MotionFrame
+        Drive,      // drive(vx, vy, omega)
+        ServoSet,   // 舵机 ch 转到 angle
+        SweepStart, // 舵机 ch 在 [minAngle, maxAngle] 间往返，每 interval 秒走 step 度
+        SweepStop,  // 停止自动往返
+    };
+
+    Type type{Type::Motion};
+    uint8_t ch{0};
+    MotionFrame frame;
+    float vx{0}, vy{0}, omega{0};
+    float angle{0};
+    float step{0}, interval{0}, minAngle{0}, maxAngle{0};
+
+    static ControlCommand motion(const MotionFrame& f) {
+        ControlCommand c;
+        c.type = Type::Motion;
+        c.frame = f;
+        return c;
+    }
+
+    static ControlCommand drive(float vx, float vy, float omega) {
+        ControlCommand c;
+        c.type = Type::Drive;
+        c.vx = vx;
+        c.vy = vy;
+        c.omega = omega;
+        return c;
+    }
+
+    static ControlCommand servo(uint8_t ch, float angle) {
+        ControlCommand c;
+        c.type = Type::ServoSet;
+        c.ch = ch;
+        c.angle = angle;
+        return c;
+    }
+
+    static ControlCommand sweepStart(uint8_t ch, float step, float interval, float minAngle, float maxAngle) {
+        ControlCommand c;
+        c.type = Type::SweepStart;
+        c.ch = ch;
+        c.step = step;
+        c.interval = interval;
+        c.minAngle = minAngle;
+        c.maxAngle = maxAngle;
+        return c;
+    }
+
+    static ControlCommand sweepStop() {
+        ControlCommand c;
+        c.type = Type::SweepStop;
+        return c;
+    }
+};
+
+// ==================== 实时控制线程 ====================
+// 启动后只有这个线程访问 PCA9685 和电机 GPIO：
+// 按固定频率（clock_nanosleep + TIMER_ABSTIME，不会累计漂移）醒来，
+// 取出队列里的所有指令，推进加减速斜坡（电机、舵机都不会瞬间跳到目标），把本周期的改动攒成一次 PCA9685 连续写。
+// 其它线程（键盘输入等）只通过 post() 投递指令；队列是单生产者的，只能由一个线程 post。
+class ControlLoop {
+public:
+    // rateHz：控制频率；cpu：绑定的 CPU 核（-1 不绑定）；priority：SCHED_FIFO 优先级（1~99，0 表示不切实时调度）
+    ControlLoop(LOBOROBOT& robot, double rateHz = 100.0, int cpu = -1, int priority = 50);
+    ~ControlLoop();
+
+    void start();
+
+    // 处理完队列里剩下的指令后退出线程
+    void stop();
+
+    // 投递一条指令，队列满时返回 false
+    bool post(const ControlCommand& cmd) { return queue_.push(cmd); }
+
+    // 舵机的目标角度（控制线程更新，任意线程可读；实际角度由斜坡逐步逼近）
+    float servoAngle(uint8_t ch) const { return servoAngle_[ch & 0x0F].load(std::memory_order_relaxed); }
+
+    // 最近一次统计周期内唤醒时间相对计划时刻的最大延迟（微秒）
+    uint32_t maxJitterUs() const { return maxJitterUs_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void setupThread();
+    void apply(const ControlCommand& cmd);
+    void tickSweep(double dt);
+
+    LOBOROBOT& robot_;
+    double periodNs_;
+    int cpu_;
+    int priority_;
+
+    SpscQueue<ControlCommand, 64> queue_;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+
+    std::atomic<float> servoAngle_[16];
+    std::atomic<uint32_t> maxJitterUs_{0};
+
+    // 自动往返状态，只在控制线程里访问
+    bool sweeping_{false};
+    uint8_t sweepCh_{0};
+    float sweepStep_{0}, sweepInterval_{0}, sweepMin_{0}, sweepMax_{0};
+    bool sweepUp_{true};
+    double sweepElapsed_{0};
+};
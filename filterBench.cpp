@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "filters.hpp"
+
+// ==================== 滤波器微基准 ====================
+// 对比原来 ultrasonic.cpp 主循环的做法（每个窗口新建 vector、sort、去掉最小最大、accumulate）
+// 和 filters.hpp 里的流式滤波器，输出每个样本的平均耗时。顺便把各个中值实现和排序结果逐个比对。
+// 编译：g++ -std=c++17 -O2 -o filterBench filterBench.cpp
+
+static constexpr size_t SAMPLES = 1000000;
+
+// 模拟超声波读数：100cm 附近的噪声 + 5% 的离群点（误触发/多径）
+static std::vector<float> makeInput() {
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 1.5f);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<float> v(SAMPLES);
+    for (size_t i = 0; i < SAMPLES; ++i) {
+        float x = 100.0f + 20.0f * std::sin(i * 1e-4f) + noise(rng);
+        if (u(rng) < 0.05f) x = u(rng) < 0.5f ? 2.5f : 400.0f;
+        v[i] = x;
+    }
+    return v;
+}
+
+template <typename F>
+static void bench(const char* name, const std::vector<float>& input, F&& step) {
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (float x : input) sink = sink + step(x);
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / double(input.size());
+    std::printf("  %-44s %8.1f ns/样本\n", name, ns);
+}
+
+// 原来的做法：攒满 5 个样本后新建 vector、排序、去头去尾、求平均（每 5 个样本出一个结果）
+static float legacyWindow(float x) {
+    static std::vector<double> pending;
+    pending.push_back(x);
+    if (pending.size() < 5) return 0;
+    std::vector<double> results(pending.begin(), pending.end());
+    pending.clear();
+    std::sort(results.begin(), results.end());
+    results.erase(results.begin());
+    results.pop_back();
+    return float(std::accumulate(results.begin(), results.end(), 0.0) / results.size());
+}
+
+// 同样的做法改成每个样本都出结果：每次把窗口拷出来排序
+template <size_t N>
+struct SortEverySample {
+    FixedRing<float, N> ring;
+    std::vector<float> scratch;
+    float operator()(float x) {
+        bool evicted;
+        ring.push(x, evicted);
+        scratch.assign(ring.size(), 0.0f);
+        for (size_t i = 0; i < ring.size(); ++i) scratch[i] = ring[i];
+        std::sort(scratch.begin(), scratch.end());
+        size_t n = scratch.size();
+        return n % 2 ? scratch[n / 2] : (scratch[n / 2 - 1] + scratch[n / 2]) / 2;
+    }
+};
+
+template <size_t N>
+static void benchWindow(const std::vector<float>& input) {
+    std::printf("窗口 N=%zu\n", N);
+    SortEverySample<N> sorted;
+    bench("每个样本拷贝 + std::sort 求中值", input, [&](float x) { return sorted(x); });
+    SortedWindow<float, N> window;
+    bench("SortedWindow 中值", input, [&](float x) { window.push(x); return window.median(); });
+    SortedWindow<float, N> trimmed;
+    bench("SortedWindow 截尾均值（各去 1 个）", input, [&](float x) { trimmed.push(x); return trimmed.trimmedMean(1); });
+    SlidingMedian<float, N> heaps;
+    bench("SlidingMedian（双堆）中值", input, [&](float x) { heaps.push(x); return heaps.median(); });
+    HampelFilter<float, N> hampel(3.0f, 2.0f);
+    bench("HampelFilter", input, [&](float x) { return hampel.update(x).value; });
+
+    // 逐个比对三种中值实现
+    SortEverySample<N> ref;
+    SortedWindow<float, N> a;
+    SlidingMedian<float, N> b;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < 200000; ++i) {
+        float expect = ref(input[i]);
+        a.push(input[i]);
+        b.push(input[i]);
+        mismatches += a.median() != expect || b.median() != expect;
+    }
+    std::printf("  中值比对：%zu 处不一致\n", mismatches);
+}
+
+int main() {
+    std::vector<float> input = makeInput();
+    std::printf("%zu 个样本\n", input.size());
+
+    std::printf("原来的做法\n");
+    bench("5 个一组：new vector + sort + 去头尾 + 平均", input, legacyWindow);
+
+    benchWindow<5>(input);
+    benchWindow<31>(input);
+    benchWindow<201>(input);
+
+    std::printf("平滑\n");
+    ExpSmoother ema(0.3f);
+    bench("ExpSmoother", input, [&](float x) { return ema.update(x); });
+    KalmanCV kalman(50.0f, 2.25f);
+    bench("KalmanCV（dt = 20ms）", input, [&](float x) { return kalman.update(x, 0.02f); });
+    HampelFilter<float, 5> hampel(3.0f, 2.0f);
+    KalmanCV cleaned(50.0f, 2.25f);
+    bench("HampelFilter<5> -> KalmanCV", input, [&](float x) { return cleaned.update(hampel.update(x).value, 0.02f); });
+    return 0;
+}
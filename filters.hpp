@@ -0,0 +1,386 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// ==================== 传感器流滤波器（只有头文件） ====================
+// 超声波、编码器、IMU 等一个值一个值到来的传感器流用。所有窗口都是固定容量的环形缓冲，
+// 对象里不做任何堆分配，可以放在告警回调/控制回路里逐个样本调用。
+//   FixedRing       ：固定容量环形缓冲，满了覆盖最老的
+//   SortedWindow    ：滑动窗口 + 有序副本，二分插入/删除，O(N) 移动；中值、截尾均值、分位数都是现成的。
+//                     小窗口（几个到几十个）最快
+//   SlidingMedian   ：双堆滑动中值，O(log N)；大窗口用
+//   HampelFilter    ：窗口中值 ± k 倍 MAD 之外的样本当作离群点，替换成中值
+//   ExpSmoother     ：一阶指数平滑，可以按采样间隔换算系数
+//   KalmanCV        ：匀速模型的一维卡尔曼（位置 + 速度），采样间隔可变
+
+// ==================== 固定容量环形缓冲 ====================
+template <typename T, size_t N>
+class FixedRing {
+    static_assert(N >= 1, "FixedRing 容量至少为 1");
+
+public:
+    // 放入新值；满了返回被挤掉的最老的值（evicted 置 true）
+    T push(T v, bool& evicted) {
+        evicted = count_ == N;
+        T old = buf_[head_];
+        buf_[head_] = v;
+        head_ = (head_ + 1) % N;
+        if (!evicted) count_++;
+        return old;
+    }
+
+    void clear() { head_ = count_ = 0; }
+    size_t size() const { return count_; }
+    bool full() const { return count_ == N; }
+    static constexpr size_t capacity() { return N; }
+
+    // 0 是最老的，size()-1 是最新的
+    const T& operator[](size_t i) const { return buf_[(head_ + N - count_ + i) % N]; }
+    const T& newest() const { return buf_[(head_ + N - 1) % N]; }
+
+private:
+    T buf_[N]{};
+    size_t head_{0};  // 下一个写入位置
+    size_t count_{0};
+};
+
+// ==================== 有序滑动窗口 ====================
+// 按到达顺序的环形缓冲之外，维护一份始终有序的副本：二分查找到最老值的位置，新值顶替它后挪到有序位置，
+// 每个样本最多 O(N) 次移动（连续内存，N 小时比堆快），不需要每个窗口重新排序。
+template <typename T, size_t N>
+class SortedWindow {
+    static_assert(N >= 1 && N <= 256, "窗口太大时请用 SlidingMedian");
+
+public:
+    void push(T v) {
+        bool evicted;
+        T old = ring_.push(v, evicted);
+        if (evicted) {
+            // 窗口满：新值直接顶替最老值的位置，再向左或向右挪到有序的位置，只移动两者之间的元素
+            size_t i = lowerBound(old);
+            while (i > 0 && v < sorted_[i - 1]) {
+                sorted_[i] = sorted_[i - 1];
+                --i;
+            }
+            while (i + 1 < count_ && sorted_[i + 1] < v) {
+                sorted_[i] = sorted_[i + 1];
+                ++i;
+            }
+            sorted_[i] = v;
+            sum_ += double(v) - double(old);
+            return;
+        }
+        size_t pos = lowerBound(v);
+        std::copy_backward(sorted_ + pos, sorted_ + count_, sorted_ + count_ + 1);
+        sorted_[pos] = v;
+        count_++;
+        sum_ += v;
+    }
+
+    void clear() {
+        ring_.clear();
+        count_ = 0;
+        sum_ = 0;
+    }
+
+    size_t size() const { return count_; }
+    bool full() const { return count_ == N; }
+
+    // 第 i 小的值（0 <= i < size()）
+    T sorted(size_t i) const { return sorted_[i]; }
+    const FixedRing<T, N>& ring() const { return ring_; }
+
+    T median() const {
+        if (count_ == 0) return T{};
+        return count_ % 2 ? sorted_[count_ / 2] : T((sorted_[count_ / 2 - 1] + sorted_[count_ / 2]) / 2);
+    }
+
+    // 去掉最小和最大各 trim 个后的均值（样本不够时退化为中值）
+    T trimmedMean(size_t trim) const {
+        if (count_ <= 2 * trim) return median();
+        double s = 0;
+        for (size_t i = trim; i < count_ - trim; ++i) s += sorted_[i];
+        return T(s / double(count_ - 2 * trim));
+    }
+
+    // 最近邻分位数，q 在 [0, 1]
+    T quantile(double q) const {
+        if (count_ == 0) return T{};
+        size_t i = size_t(std::clamp(q, 0.0, 1.0) * double(count_ - 1) + 0.5);
+        return sorted_[i];
+    }
+
+    T mean() const { return count_ ? T(sum_ / double(count_)) : T{}; }
+
+private:
+    size_t lowerBound(T v) const { return size_t(std::lower_bound(sorted_, sorted_ + count_, v) - sorted_); }
+
+    FixedRing<T, N> ring_;
+    T sorted_[N]{};
+    size_t count_{0};
+    double sum_{0};
+};
+
+// ==================== 双堆滑动中值 ====================
+// 较小的一半放大顶堆、较大的一半放小顶堆，中值就是堆顶。窗口里每个样本占一个固定槽位，
+// 记录它在哪个堆的哪个位置，最老的样本出窗口时可以直接从堆中间删除（和堆尾交换后上浮/下沉），
+// 每个样本 O(log N)，不需要惰性删除用的哈希表。
+template <typename T, size_t N>
+class SlidingMedian {
+    static_assert(N >= 1 && N <= 65535, "槽位编号是 16 位");
+    using Slot = uint16_t;
+
+public:
+    void push(T v) {
+        Slot slot = Slot(head_);
+        if (count_ == N) {
+            erase(slot);  // head_ 就是最老的槽位
+        } else {
+            count_++;
+        }
+        values_[slot] = v;
+        if (lo_.size == 0 || !(top(lo_) < v)) {
+            heapPush(lo_, slot);
+        } else {
+            heapPush(hi_, slot);
+        }
+        rebalance();
+        head_ = (head_ + 1) % N;
+    }
+
+    void clear() {
+        lo_.size = hi_.size = 0;
+        head_ = count_ = 0;
+    }
+
+    size_t size() const { return count_; }
+    bool full() const { return count_ == N; }
+
+    T median() const {
+        if (count_ == 0) return T{};
+        if (lo_.size > hi_.size) return top(lo_);
+        return T((top(lo_) + top(hi_)) / 2);
+    }
+
+private:
+    struct Heap {
+        bool isMax;
+        Slot ids[N];
+        size_t size;
+    };
+
+    T top(const Heap& h) const { return values_[h.ids[0]]; }
+
+    // a 是否应该在 b 上面
+    bool above(const Heap& h, Slot a, Slot b) const {
+        return h.isMax ? values_[b] < values_[a] : values_[a] < values_[b];
+    }
+
+    void place(Heap& h, size_t i, Slot slot) {
+        h.ids[i] = slot;
+        where_[slot] = Pos{&h == &hi_, Slot(i)};
+    }
+
+    void siftUp(Heap& h, size_t i) {
+        Slot slot = h.ids[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!above(h, slot, h.ids[parent])) break;
+            place(h, i, h.ids[parent]);
+            i = parent;
+        }
+        place(h, i, slot);
+    }
+
+    void siftDown(Heap& h, size_t i) {
+        Slot slot = h.ids[i];
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= h.size) break;
+            if (child + 1 < h.size && above(h, h.ids[child + 1], h.ids[child])) child++;
+            if (!above(h, h.ids[child], slot)) break;
+            place(h, i, h.ids[child]);
+            i = child;
+        }
+        place(h, i, slot);
+    }
+
+    void heapPush(Heap& h, Slot slot) {
+        h.ids[h.size] = slot;
+        siftUp(h, h.size++);
+    }
+
+    Slot heapPop(Heap& h) {
+        Slot slot = h.ids[0];
+        removeAt(h, 0);
+        return slot;
+    }
+
+    void removeAt(Heap& h, size_t i) {
+        h.size--;
+        if (i == h.size) return;
+        Slot moved = h.ids[h.size];
+        place(h, i, moved);
+        siftUp(h, i);
+        siftDown(h, where_[moved].index);
+    }
+
+    void erase(Slot slot) {
+        Pos p = where_[slot];
+        removeAt(p.upper ? hi_ : lo_, p.index);
+        rebalance();
+    }
+
+    // 保持 lo_.size == hi_.size 或 lo_.size == hi_.size + 1
+    void rebalance() {
+        if (lo_.size > hi_.size + 1) {
+            heapPush(hi_, heapPop(lo_));
+        } else if (hi_.size > lo_.size) {
+            heapPush(lo_, heapPop(hi_));
+        }
+    }
+
+    struct Pos {
+        bool upper;  // 在 hi_ 里
+        Slot index;
+    };
+
+    T values_[N]{};
+    Pos where_[N]{};
+    Heap lo_{true, {}, 0};
+    Heap hi_{false, {}, 0};
+    size_t head_{0};
+    size_t count_{0};
+};
+
+// ==================== Hampel 离群点滤波 ====================
+// 新样本和窗口（含新样本）的中值相差超过 k × 1.4826 × MAD（中位数绝对偏差，1.4826 换算成正态分布的标准差），
+// 就当作离群点，输出中值；否则原样输出。样本不到 minSamples 个时不判断。
+// 传感器读数有量化（同一距离总是同一个值）时 MAD 常常是 0，minDeviation 给门限一个下限，
+// 免得一点点抖动都被当成离群点。
+template <typename T, size_t N>
+class HampelFilter {
+public:
+    struct Result {
+        T value;
+        bool outlier;
+    };
+
+    explicit HampelFilter(T k = T(3), T minDeviation = T(0), size_t minSamples = 3)
+        : k_(k), minDeviation_(minDeviation), minSamples_(minSamples) {}
+
+    Result update(T x) {
+        window_.push(x);
+        size_t n = window_.size();
+        if (n < minSamples_) return {x, false};
+        T m = window_.median();
+        for (size_t i = 0; i < n; ++i) {
+            T d = window_.sorted(i) - m;
+            deviations_[i] = d < 0 ? -d : d;
+        }
+        // 偏差的中值：nth_element 在固定数组上原地做，不分配
+        std::nth_element(deviations_, deviations_ + n / 2, deviations_ + n);
+        T mad = deviations_[n / 2];
+        if (n % 2 == 0) mad = T((mad + *std::max_element(deviations_, deviations_ + n / 2)) / 2);
+        T d = x - m;
+        if ((d < 0 ? -d : d) > std::max(k_ * T(1.4826) * mad, minDeviation_)) return {m, true};
+        return {x, false};
+    }
+
+    void clear() { window_.clear(); }
+    const SortedWindow<T, N>& window() const { return window_; }
+
+private:
+    T k_;
+    T minDeviation_;
+    size_t minSamples_;
+    SortedWindow<T, N> window_;
+    T deviations_[N]{};
+};
+
+// ==================== 一阶指数平滑 ====================
+class ExpSmoother {
+public:
+    explicit ExpSmoother(float alpha = 0.3f) : alpha_(alpha) {}
+
+    // 固定采样间隔：y += alpha * (x - y)
+    float update(float x) { return blend(x, alpha_); }
+
+    // 可变采样间隔：按时间常数 tau 换算，alpha = 1 - exp(-dt / tau)
+    float update(float x, float dtSec, float tauSec) {
+        return blend(x, tauSec > 0 ? 1.0f - std::exp(-dtSec / tauSec) : 1.0f);
+    }
+
+    void reset() { primed_ = false; }
+    float value() const { return y_; }
+
+private:
+    float blend(float x, float alpha) {
+        if (!primed_) {
+            y_ = x;
+            primed_ = true;
+        } else {
+            y_ += alpha * (x - y_);
+        }
+        return y_;
+    }
+
+    float alpha_;
+    float y_{0};
+    bool primed_{false};
+};
+
+// ==================== 匀速模型卡尔曼（位置 + 速度） ====================
+// 状态 [x, v]，过程噪声按白噪声加速度建模（accelVar，单位²/s⁴），测量噪声 measVar（单位²）。
+// 距离传感器用时 v 就是接近/远离的速度，负数表示在靠近。
+class KalmanCV {
+public:
+    KalmanCV(float accelVar, float measVar) : q_(accelVar), r_(measVar) {}
+
+    // dtSec：离上一次测量的时间；第一次调用只初始化
+    float update(float z, float dtSec) {
+        if (!primed_) {
+            x_ = z;
+            v_ = 0;
+            p00_ = r_;
+            p01_ = 0;
+            p11_ = 1e4f;  // 速度一开始完全不知道
+            primed_ = true;
+            return x_;
+        }
+        predict(dtSec);
+        float s = p00_ + r_;
+        float k0 = p00_ / s;
+        float k1 = p01_ / s;
+        float y = z - x_;
+        x_ += k0 * y;
+        v_ += k1 * y;
+        float p00 = p00_, p01 = p01_;
+        p00_ -= k0 * p00;
+        p01_ -= k0 * p01;
+        p11_ -= k1 * p01;
+        return x_;
+    }
+
+    // 没有测量时只往前推（比如这次回波无效）
+    void predict(float dtSec) {
+        float dt = dtSec, dt2 = dt * dt;
+        x_ += v_ * dt;
+        p00_ += dt * (2 * p01_ + dt * p11_) + q_ * dt2 * dt2 / 4;
+        p01_ += dt * p11_ + q_ * dt2 * dt / 2;
+        p11_ += q_ * dt2;
+    }
+
+    void reset() { primed_ = false; }
+    bool primed() const { return primed_; }
+    float position() const { return x_; }
+    float velocity() const { return v_; }
+
+private:
+    float q_, r_;
+    float x_{0}, v_{0};
+    float p00_{0}, p01_{0}, p11_{0};  // 协方差（对称，只存上三角）
+    bool primed_{false};
+};
@@ -1,7 +1,8 @@
 #include "loborobot.hpp"
+#include "ringlog.hpp"
 #include <wiringPi.h>
-#include <iostream>
 #include <cmath>
+#include <algorithm>
 
 LOBOROBOT::LOBOROBOT(bool debug) : pwm(1, 0x40, debug) {
     //初始化PCA9685：I2C总线1（树莓派默认）、地址0x40（PCA9685默认）、调试模式
@@ -9,159 +10,261 @@ LOBOROBOT::LOBOROBOT(bool debug) : pwm(1, 0x40, debug) {
     //初始化树莓派GPIO（仅用于电机的方向控制，因DIN1/DIN2是GPIO引脚，非PCA9685通道）
     wiringPiSetupGpio();//初始化 WiringPi 库，并使用 BCM GPIO 编号方式（即 GPIOxx 编号）
     //配置 DIN1/DIN2 为输出并默认拉低（D电机用到了树莓派的两个方向脚）。
-    pinMode(DIN1, OUTPUT);// BCM GPIO18
-    pinMode(DIN2, OUTPUT);// BCM GPIO21
+    pinMode(MOTORS[3].revPin, OUTPUT);// DIN1: BCM GPIO25
+    pinMode(MOTORS[3].fwdPin, OUTPUT);// DIN2: BCM GPIO24
+
+    //轮子斜坡固定占用 0~3 号，默认 0.25s 内可从静止到满速
+    for (int motor = 0; motor < 4; ++motor) {
+        ramps.add(0, 400.0f, 1600.0f, motor);
+    }
+    for (auto& id : servoRamp) id = -1;
+}
+
+static float signedDuty(MotorDir dir, float speed) {
+    if (dir == MotorDir::Forward) return speed;
+    if (dir == MotorDir::Backward) return -speed;
+    return 0;
 }
 
-void LOBOROBOT::MotorRun(int motor, std::string index, float speed) {
-    std::cout << "[MotorRun] motor=" << motor << ", dir=" << index << ", speed=" << speed << std::endl;
+void LOBOROBOT::writeGpio(int idx, uint8_t pin, int level) {
+    if (gpioLevel[idx] == level) return;
+    digitalWrite(pin, level);
+    gpioLevel[idx] = level;
+}
 
+void LOBOROBOT::stageMotor(int motor, MotorDir dir, float speed) {
+    if (motor < 0 || motor > 3) return;
+    const MotorChannels& ch = MOTORS[motor];
     if (speed > 100) speed = 100;
-    if (motor == 0) {// 电机A（左前）
-        pwm.setDutyCycle(PWMA, speed);//设置占空比，调整速度
-        if (index == "forward") {
-            pwm.setLevel(AIN1, LOW);
-            pwm.setLevel(AIN2, HIGH);
-            std::cout << "[GPIO] AIN1=LOW, AIN2=HIGH\n";
-        } else if(index == "backward"){
-            pwm.setLevel(AIN1, HIGH);
-            pwm.setLevel(AIN2, LOW);
-            std::cout << "[GPIO] AIN1=HIGH, AIN2=LOW\n";
-        }
-    } else if (motor == 1) {//电机B（右前）
-        pwm.setDutyCycle(PWMB, speed);
-        if (index == "forward") {
-            pwm.setLevel(BIN1, HIGH);
-            pwm.setLevel(BIN2, LOW);
-            std::cout << "[GPIO] BIN1=HIGH, BIN2=LOW\n";
-        } else if(index == "backward"){
-            pwm.setLevel(BIN1, LOW);
-            pwm.setLevel(BIN2, HIGH);
-            std::cout << "[GPIO] BIN1=LOW, BIN2=HIGH\n";
-        }
-    } else if (motor == 2) {//电机C（左后）
-        pwm.setDutyCycle(PWMC, speed);
-        if (index == "forward") {
-            pwm.setLevel(CIN1, HIGH);
-            pwm.setLevel(CIN2, LOW);
-            std::cout << "[GPIO] CIN1=HIGH, CIN2=LOW\n";
-        } else if(index == "backward"){
-            pwm.setLevel(CIN1, LOW);
-            pwm.setLevel(CIN2, HIGH);
-            std::cout << "[GPIO] CIN1=LOW, CIN2=HIGH\n";
-        }
-    } else if (motor == 3) {
-        pwm.setDutyCycle(PWMD, speed);
-        if (index == "forward") {
-            digitalWrite(DIN1, LOW);
-            digitalWrite(DIN2, HIGH);
-            std::cout << "[GPIO] DIN1=LOW, DIN2=HIGH\n";
-        } else if(index == "backward"){
-            digitalWrite(DIN1, HIGH);
-            digitalWrite(DIN2, LOW);
-            std::cout << "[GPIO] DIN1=HIGH, DIN2=LOW\n";
-        }
+    if (dir == MotorDir::Stop) speed = 0;
+    pwm.setDutyCycle(ch.pwm, speed);//设置占空比，调整速度
+    if (dir == MotorDir::Stop) return;//停止只切断占空比，方向脚保持不变
+
+    int fwd = (dir == MotorDir::Forward) ? HIGH : LOW;
+    int rev = (dir == MotorDir::Forward) ? LOW : HIGH;
+    if (ch.dirOnGpio) {
+        writeGpio(0, ch.fwdPin, fwd);
+        writeGpio(1, ch.revPin, rev);
+    } else {
+        pwm.setLevel(ch.fwdPin, fwd);
+        pwm.setLevel(ch.revPin, rev);
+    }
+}
+
+void LOBOROBOT::beginBatch() {
+    if (batchDepth++ == 0) pwm.setAutoFlush(false);
+}
+
+void LOBOROBOT::endBatch() {
+    if (batchDepth == 0) return;
+    if (--batchDepth == 0) {
+        pwm.flush(true);
+        pwm.setAutoFlush(true);
     }
 }
 
+void LOBOROBOT::commit(const MotionFrame& frame) {
+    for (int motor = 0; motor < 4; ++motor) {
+        ramps.reset(motor, signedDuty(frame.dir[motor], frame.speed[motor]));
+    }
+    applyFrame(frame);
+}
+
+void LOBOROBOT::applyFrame(const MotionFrame& frame) {
+    // PCA9685 默认在 I2C STOP 时统一更新输出（MODE2.OCH=0），
+    // 所以把 4 个轮子的通道攒成一次连续写，A/B/C 的方向和 4 个轮子的占空比同时生效。
+    // D 电机的方向脚在树莓派 GPIO 上，在这次写之前就已经写好（没变则不写）。
+    beginBatch();
+    for (int motor = 0; motor < 4; ++motor) {
+        stageMotor(motor, frame.dir[motor], frame.speed[motor]);
+    }
+    endBatch();
+    RLOG_D("[commit] A=%d/%.1f B=%d/%.1f C=%d/%.1f D=%d/%.1f",
+           (int)frame.dir[0], frame.speed[0], (int)frame.dir[1], frame.speed[1],
+           (int)frame.dir[2], frame.speed[2], (int)frame.dir[3], frame.speed[3]);
+}
+
+void LOBOROBOT::MotorRun(int motor, MotorDir dir, float speed) {
+    RLOG_D("[MotorRun] motor=%d, dir=%d, speed=%.1f", motor, (int)dir, speed);
+    if (motor < 0 || motor > 3) return;
+    ramps.reset(motor, signedDuty(dir, speed));
+    beginBatch();
+    stageMotor(motor, dir, speed);
+    endBatch();
+}
+
 void LOBOROBOT::MotorStop(int motor) {
     // 核心逻辑：将对应电机的PWM占空比设为0（切断电机电源）
-    pwm.setDutyCycle(motor == 0 ? PWMA : motor == 1 ? PWMB : motor == 2 ? PWMC : PWMD, 0);
-    std::cout << "[MotorStop] motor=" << motor << std::endl;
+    MotorRun(motor, MotorDir::Stop, 0);
 }
 
 //前进
 void LOBOROBOT::t_up(float speed) {
-    MotorRun(0, "forward", speed);
-    MotorRun(1, "forward", speed);
-    MotorRun(2, "forward", speed);
-    MotorRun(3, "forward", speed);
+    commit(MotionFrame(MotorDir::Forward, MotorDir::Forward, MotorDir::Forward, MotorDir::Forward, speed));
 }
     
 //后退
 void LOBOROBOT::t_back(float speed) {
-    MotorRun(0, "backward", speed);
-    MotorRun(1, "backward", speed);
-    MotorRun(2, "backward", speed);
-    MotorRun(3, "backward", speed);
+    commit(MotionFrame(MotorDir::Backward, MotorDir::Backward, MotorDir::Backward, MotorDir::Backward, speed));
 }
     
 //左转
 void LOBOROBOT::turnLeft(float speed) {
-    MotorRun(0, "backward", speed);
-    MotorRun(1, "forward", speed);
-    MotorRun(2, "backward", speed);
-    MotorRun(3, "forward", speed);
+    commit(MotionFrame(MotorDir::Backward, MotorDir::Forward, MotorDir::Backward, MotorDir::Forward, speed));
 }
 
 //右转
 void LOBOROBOT::turnRight(float speed) {
-    MotorRun(0, "forward", speed);
-    MotorRun(1, "backward", speed);
-    MotorRun(2, "forward", speed);
-    MotorRun(3, "backward", speed); 
+    commit(MotionFrame(MotorDir::Forward, MotorDir::Backward, MotorDir::Forward, MotorDir::Backward, speed));
 }
 
 //左移
 void LOBOROBOT::moveLeft(float speed) {
-    MotorRun(0, "backward", speed);
-    MotorRun(1, "forward", speed);
-    MotorRun(2, "forward", speed);
-    MotorRun(3, "backward", speed);
+    commit(MotionFrame(MotorDir::Backward, MotorDir::Forward, MotorDir::Forward, MotorDir::Backward, speed));
 }
 
 //右移
 void LOBOROBOT::moveRight(float speed) {
-    MotorRun(0, "forward", speed);
-    MotorRun(1, "backward", speed);
-    MotorRun(2, "backward", speed);
-    MotorRun(3, "forward", speed);
+    commit(MotionFrame(MotorDir::Forward, MotorDir::Backward, MotorDir::Backward, MotorDir::Forward, speed));
 }
 
 //前左斜
 void LOBOROBOT::forwardLeft(float speed) {
-    MotorStop(0);
-    MotorRun(1, "forward", speed);
-    MotorRun(2, "forward", speed);
-    MotorStop(3);
+    commit(MotionFrame(MotorDir::Stop, MotorDir::Forward, MotorDir::Forward, MotorDir::Stop, speed));
 }
 
 //前右斜
 void LOBOROBOT::forwardRight(float speed) {
-    MotorRun(0, "forward", speed);
-    MotorStop(1);
-    MotorStop(2);
-    MotorRun(3, "forward", speed);
+    commit(MotionFrame(MotorDir::Forward, MotorDir::Stop, MotorDir::Stop, MotorDir::Forward, speed));
 }
 
 //后左斜
 void LOBOROBOT::backwardLeft(float speed) {
-    MotorRun(0, "backward", speed);
-    MotorStop(1);
-    MotorStop(2);
-    MotorRun(3, "backward", speed);
+    commit(MotionFrame(MotorDir::Backward, MotorDir::Stop, MotorDir::Stop, MotorDir::Backward, speed));
 }
 
 //后右斜
 void LOBOROBOT::backwardRight(float speed) {
-    MotorStop(0);
-    MotorRun(1, "backward", speed);
-    MotorRun(2, "backward", speed);
-    MotorStop(3);
+    commit(MotionFrame(MotorDir::Stop, MotorDir::Backward, MotorDir::Backward, MotorDir::Stop, speed));
 }
 
 //停止
 void LOBOROBOT::t_stop() {
-    MotorStop(0);
-    MotorStop(1);
-    MotorStop(2);
-    MotorStop(3);
+    commit(MotionFrame());
+}
+
+void LOBOROBOT::mecanumIK(float vx, float vy, float omega, float wheel[4]) {
+    // 和上面的固定动作一致：左移时 A、D 反转，B、C 正转；左转时 A、C 反转，B、D 正转
+    wheel[0] = vx - vy - omega;//A 左前
+    wheel[1] = vx + vy + omega;//B 右前
+    wheel[2] = vx + vy - omega;//C 左后
+    wheel[3] = vx - vy + omega;//D 右后
+
+    float peak = 0;
+    for (int i = 0; i < 4; ++i) peak = std::max(peak, std::fabs(wheel[i]));
+    if (peak > 100.0f) {
+        float k = 100.0f / peak;
+        for (int i = 0; i < 4; ++i) wheel[i] *= k;
+    }
+}
+
+void LOBOROBOT::drive(float vx, float vy, float omega) {
+    // 占空比低于 1% 电机转不动，当作停止，也避免在 0 附近来回切换方向脚
+    static constexpr float DEADBAND = 1.0f;
+    float wheel[4];
+    mecanumIK(vx, vy, omega, wheel);
+    MotionFrame frame;
+    for (int motor = 0; motor < 4; ++motor) {
+        frame.setSigned(motor, wheel[motor], DEADBAND);
+    }
+    commit(frame);
 }
 
 void LOBOROBOT::setServoAngle(uint8_t ch, float angleDeg) {
+    if (ch < PCA9685::CHANNELS && servoRamp[ch] >= 0) ramps.reset(servoRamp[ch], angleDeg);
+    writeServo(ch, angleDeg);
+}
+
+void LOBOROBOT::writeServo(uint8_t ch, float angleDeg) {
     float pulseUs = (angleDeg * 11.0f) + 500.0f; 
     
     // 通过 pwm 实例调用 PCA9685 的 setServoPulse 方法
     // 注意：这里的调用方式是 pwm.setServoPulse，因为 pwm 是 LOBOROBOT 类的一个成员变量
     pwm.setServoPulse(ch, (int)std::round(pulseUs), 50.0f);
 }
+
+void LOBOROBOT::setWheelRampLimits(float maxVel, float maxAccel) {
+    for (int motor = 0; motor < 4; ++motor) {
+        ramps.setLimits(motor, maxVel, maxAccel);
+    }
+}
+
+void LOBOROBOT::setServoRampLimits(int ch, float maxVel, float maxAccel) {
+    if (ch < 0) {
+        servoMaxVel = maxVel;
+        servoMaxAccel = maxAccel;
+        for (int id : servoRamp) {
+            if (id >= 0) ramps.setLimits(id, maxVel, maxAccel);
+        }
+    } else if (ch < PCA9685::CHANNELS && servoRamp[ch] >= 0) {
+        ramps.setLimits(servoRamp[ch], maxVel, maxAccel);
+    }
+}
+
+void LOBOROBOT::driveRamped(float vx, float vy, float omega) {
+    float wheel[4];
+    mecanumIK(vx, vy, omega, wheel);
+    for (int motor = 0; motor < 4; ++motor) {
+        ramps.setTarget(motor, wheel[motor]);
+    }
+}
+
+void LOBOROBOT::commitRamped(const MotionFrame& frame) {
+    for (int motor = 0; motor < 4; ++motor) {
+        ramps.setTarget(motor, signedDuty(frame.dir[motor], std::min(frame.speed[motor], 100.0f)));
+    }
+}
+
+void LOBOROBOT::setServoAngleRamped(uint8_t ch, float angleDeg) {
+    if (ch >= PCA9685::CHANNELS) return;
+    if (servoRamp[ch] < 0) {
+        servoRamp[ch] = ramps.add(angleDeg, servoMaxVel, servoMaxAccel, ch);
+        writeServo(ch, angleDeg);
+        return;
+    }
+    ramps.setTarget(servoRamp[ch], angleDeg);
+}
+
+void LOBOROBOT::updateRamps(float dt) {
+    int changed[RampGenerator::MAX_RAMPS];
+    emitRamps(changed, ramps.step(dt, changed));
+}
+
+void LOBOROBOT::settleRamps() {
+    int changed[RampGenerator::MAX_RAMPS];
+    emitRamps(changed, ramps.finish(changed));
+}
+
+void LOBOROBOT::emitRamps(const int* changed, int n) {
+    if (n == 0) return;
+
+    beginBatch();
+    bool wheelsChanged = false;
+    for (int i = 0; i < n; ++i) {
+        int id = changed[i];
+        if (id < 4) {
+            wheelsChanged = true;
+        } else {
+            writeServo(ramps.tag(id), ramps.value(id));
+        }
+    }
+    if (wheelsChanged) {
+        // 占空比低于 1% 电机转不动，当作停止；过零时自然经过 Stop 再换向
+        MotionFrame frame;
+        for (int motor = 0; motor < 4; ++motor) {
+            frame.setSigned(motor, ramps.value(motor), 1.0f);
+        }
+        applyFrame(frame);
+    }
+    endBatch();
+}
@@ -1,22 +1,93 @@
 #pragma once
 #include "pca9685.hpp"
-#include <string>
+#include "ramp.hpp"
+
+// 电机方向；Stop 只把占空比置 0，不改方向引脚
+enum class MotorDir : uint8_t { Stop, Forward, Backward };
+
+// ==================== 一帧运动指令 ====================
+// 先把 4 个轮子的方向和速度都放进来，再交给 LOBOROBOT::commit 一次性下发
+struct MotionFrame {
+    MotorDir dir[4] = {MotorDir::Stop, MotorDir::Stop, MotorDir::Stop, MotorDir::Stop};
+    float speed[4] = {0, 0, 0, 0};
+
+    MotionFrame() = default;
+
+    // 按 A(左前)、B(右前)、C(左后)、D(右后) 的顺序给出方向，速度相同
+    MotionFrame(MotorDir a, MotorDir b, MotorDir c, MotorDir d, float s)
+        : dir{a, b, c, d}, speed{s, s, s, s} {}
+
+    MotionFrame& set(int motor, MotorDir d, float s) {
+        dir[motor] = d;
+        speed[motor] = s;
+        return *this;
+    }
+
+    // 按带符号占空比设置：正数正转、负数反转、绝对值小于 deadband 视为停止
+    MotionFrame& setSigned(int motor, float duty, float deadband = 0.0f) {
+        if (duty > deadband) return set(motor, MotorDir::Forward, duty);
+        if (duty < -deadband) return set(motor, MotorDir::Backward, -duty);
+        return set(motor, MotorDir::Stop, 0);
+    }
+};
+
+// 一个电机用到的通道：PWM 调速通道 + 两个方向脚。
+// fwdPin 在正转时拉高、revPin 在反转时拉高；dirOnGpio 为 true 时方向脚是树莓派 GPIO（BCM 编号）而不是 PCA9685 通道
+struct MotorChannels {
+    uint8_t pwm;
+    uint8_t fwdPin;
+    uint8_t revPin;
+    bool dirOnGpio;
+};
 
 // ==================== LOBOROBOT 类 ====================
 class LOBOROBOT {
 private:
     PCA9685 pwm;//依赖的PWM控制器对象（初始化时创建，用于输出PWM信号）
 
-    // PWM通道映射
-    int PWMA = 0, AIN1 = 2, AIN2 = 1;//A是左前
-    int PWMB = 5, BIN1 = 3, BIN2 = 4;//B是右前
-    int PWMC = 6, CIN2 = 7, CIN1 = 8;//C是左后
-    int PWMD = 11, DIN1 = 25, DIN2 = 24;//D是右后
+    // PWM通道映射（编译期常量表，下标即电机编号）
+    static constexpr MotorChannels MOTORS[4] = {
+        {0, 1, 2, false},//A是左前：PWMA=0, AIN2=1(正转), AIN1=2(反转)
+        {5, 3, 4, false},//B是右前：PWMB=5, BIN1=3(正转), BIN2=4(反转)
+        {6, 8, 7, false},//C是左后：PWMC=6, CIN1=8(正转), CIN2=7(反转)
+        {11, 24, 25, true},//D是右后：PWMD=11, DIN2=GPIO24(正转), DIN1=GPIO25(反转)
+    };
+
+    int gpioLevel[2] = {-1, -1};//D 电机 fwdPin/revPin 上次写入的电平，-1 表示未知
+    int batchDepth = 0;//beginBatch 嵌套层数
+
+    // 加减速斜坡：4 个轮子的带符号占空比（%）固定是 0~3 号，舵机角度（度）按需创建
+    RampGenerator ramps;
+    int servoRamp[PCA9685::CHANNELS];//舵机通道 -> 斜坡 id，-1 表示还没有
+    float servoMaxVel = 300.0f, servoMaxAccel = 1500.0f;//新建舵机斜坡时的默认限制（度/s、度/s²）
+
+    //只把一个电机的方向和占空比放进 PCA9685 影子寄存器；D 电机的方向脚是 GPIO，直接写
+    void stageMotor(int motor, MotorDir dir, float speed);
+
+    //下发一帧，但不同步斜坡（updateRamps 用）
+    void applyFrame(const MotionFrame& frame);
+
+    //舵机角度换算成脉宽并写入（不同步斜坡）
+    void writeServo(uint8_t ch, float angleDeg);
+
+    //把有变化的斜坡值下发到硬件（一次批量写）
+    void emitRamps(const int* changed, int n);
+
+    //写 GPIO，电平没变就跳过
+    void writeGpio(int idx, uint8_t pin, int level);
 
 public:
     LOBOROBOT(bool debug = false);
 
-    void MotorRun(int motor, std::string index, float speed);// 电机运转（指定电机、方向、速度）
+    void MotorRun(int motor, MotorDir dir, float speed);// 电机运转（指定电机、方向、速度）
+
+    //批量输出：beginBatch 之后的电机/舵机改动只进 PCA9685 影子寄存器，
+    //最外层 endBatch 时一次连续写完（可以嵌套，commit 内部也用它）
+    void beginBatch();
+    void endBatch();
+
+    //一次性下发 4 个轮子：先写 D 电机的方向 GPIO，再用一次 PCA9685 连续写更新所有占空比和方向通道
+    void commit(const MotionFrame& frame);
 
     void MotorStop(int motor);// 单个电机停止
     
@@ -52,6 +123,38 @@ public:
     //停止
     void t_stop(); 
 
+    //麦克纳姆轮逆运动学：vx 前进、vy 左移、omega 逆时针旋转（单位都是占空比 %，-100~100），
+    //输出 A/B/C/D 四个轮子的带符号占空比；任一轮超过 100 时四个轮子按同一比例缩小，保持运动方向不变
+    static void mecanumIK(float vx, float vy, float omega, float wheel[4]);
+
+    //连续速度控制：逆运动学算出四个轮子的占空比，一次 commit 下发（适合 50~100Hz 的控制频率）
+    void drive(float vx, float vy, float omega);
+
     //舵机控制函数
     void setServoAngle(uint8_t ch, float angleDeg);
+
+    // ---------- 加减速（梯形速度曲线） ----------
+    // 上面的函数都是立即跳到目标；下面的 *Ramped 只设置目标，由 updateRamps 按控制周期逐步逼近，
+    // 避免电机瞬间满载拉低电源电压、舵机冲过头。立即型函数会把对应斜坡同步到新值。
+
+    //轮子占空比的最大变化速度（%/s）和加速度（%/s²）；<= 0 表示不限制
+    void setWheelRampLimits(float maxVel, float maxAccel);
+
+    //舵机角度的最大角速度（度/s）和角加速度（度/s²）；ch 为 -1 时设置所有舵机（包括之后新建的）
+    void setServoRampLimits(int ch, float maxVel, float maxAccel);
+
+    //带加减速的 drive
+    void driveRamped(float vx, float vy, float omega);
+
+    //带加减速的 commit：每个轮子向 ±speed 逼近
+    void commitRamped(const MotionFrame& frame);
+
+    //带加减速的舵机角度；第一次调用时舵机位置未知，直接跳到目标
+    void setServoAngleRamped(uint8_t ch, float angleDeg);
+
+    //推进所有斜坡 dt 秒，只下发有变化的通道（一次批量写）；在控制线程里每个周期调用
+    void updateRamps(float dt);
+
+    //所有斜坡立即到达目标（退出前调用，保证最后的停车/复位指令生效）
+    void settleRamps();
 };
@@ -3,15 +3,43 @@
 #include <cstring>
 #include <cstdlib>
 
-void PCA9685::write8(uint8_t reg, uint8_t value) {
+bool PCA9685::write8(uint8_t reg, uint8_t value) {
     uint8_t buf[2] = {reg, value};
     if (write(i2c_fd, buf, 2) != 2) {
         perror("I2C 写入失败");
-    } else if (debug) {
+        return false;
+    }
+    if (debug) {
         printf("[I2C 写入] reg=0x%02X, val=0x%02X\n", reg, value);
     }
+    return true;
+}
+
+bool PCA9685::writeBlock(uint8_t reg, const uint8_t* data, size_t len) {
+    // 第 1 字节是起始寄存器地址，后面紧跟数据；芯片在 AI 模式下每写 1 字节地址自动 +1
+    uint8_t buf[1 + 4 * CHANNELS];
+    if (len > sizeof(buf) - 1) {
+        fprintf(stderr, "I2C 批量写入过长: %zu\n", len);
+        return false;
+    }
+    buf[0] = reg;
+    std::memcpy(buf + 1, data, len);
+    if (write(i2c_fd, buf, len + 1) != (ssize_t)(len + 1)) {
+        perror("I2C 批量写入失败");
+        return false;
+    }
+    if (debug) {
+        printf("[I2C 批量写入] reg=0x%02X, len=%zu\n", reg, len);
+    }
+    return true;
 }
 
+void PCA9685::writeMode1(uint8_t value) {
+    if (write8(MODE1, value)) {
+        // RESTART 位写 1 只是触发动作，不保留在影子里
+        mode1 = value & ~MODE1_RESTART;
+    }
+}
 
 uint8_t PCA9685::read8(uint8_t reg) {
     //先写寄存器地址
@@ -31,6 +59,31 @@ uint8_t PCA9685::read8(uint8_t reg) {
     return data;
 }
 
+bool PCA9685::readBlock(uint8_t reg, uint8_t* data, size_t len) {
+    // 写起始地址后连续读，AI 模式下地址同样自动递增
+    if (write(i2c_fd, &reg, 1) != 1 || read(i2c_fd, data, len) != (ssize_t)len) {
+        perror("I2C 批量读取失败");
+        return false;
+    }
+    if (debug) {
+        printf("[I2C 批量读取] reg=0x%02X, len=%zu\n", reg, len);
+    }
+    return true;
+}
+
+void PCA9685::loadShadow() {
+    uint8_t regs[4 * CHANNELS];
+    if (!readBlock(LED0_ON_L, regs, sizeof(regs))) {
+        return;//读不到就保持全部未知，flush 退回按已知通道分段写
+    }
+    for (uint8_t c = 0; c < CHANNELS; ++c) {
+        // 保留 bit12（FULL ON/OFF），这样和 stage 的 12 位目标值比较时不会误判为“没变化”
+        chipOn[c] = wantOn[c] = regs[4 * c + 0] | ((regs[4 * c + 1] & 0x1F) << 8);
+        chipOff[c] = wantOff[c] = regs[4 * c + 2] | ((regs[4 * c + 3] & 0x1F) << 8);
+    }
+    knownMask = 0xFFFF;
+}
+
 PCA9685::PCA9685(int bus, int address, bool debug_mode)
     : addr(address), debug(debug_mode) {
     char filename[20];
@@ -46,7 +99,8 @@ PCA9685::PCA9685(int bus, int address, bool debug_mode)
         close(i2c_fd);
         exit(1);
     }
-    write8(0x00, 0x00); // 初始化芯片，MODE1（模式控制：重启、睡眠、自动增加地址等）复位
+    writeMode1(MODE1_AI); // 初始化芯片，MODE1（模式控制：重启、睡眠、自动增加地址等）复位，并打开自动递增
+    loadShadow(); // 一次读回 16 个通道的当前值，之后 flush(true) 可以跨过还没写过的通道合并成一次写
 }
 
 PCA9685::~PCA9685() {
@@ -59,38 +113,121 @@ void PCA9685::setPWMFreq(float freq) {
     float prescaleval = 25000000.0 / 4096.0 / freq - 1.0f;
     uint8_t prescale = static_cast<uint8_t>(std::floor(prescaleval + 0.5f));
     
-    uint8_t oldmode = read8(0x00);//保存当前的 MODE1 寄存器状态
+    if (prescale == this->prescale) {
+        return;//频率没变，不必再走一遍睡眠/重启流程
+    }
+
+    uint8_t oldmode = mode1 | MODE1_AI;//当前 MODE1 直接取影子，省一次读（批量写依赖自动递增，始终保持打开）
     // 进入睡眠模式（才能修改预分频）
-    uint8_t newmode = (oldmode & 0x7F) | 0x10;
-    write8(0x00, newmode);
+    uint8_t newmode = (oldmode & 0x7F) | MODE1_SLEEP;
+    writeMode1(newmode);
     // 设置预分频值
-    write8(0xFE, prescale);
+    if (write8(PRE_SCALE, prescale)) {
+        this->prescale = prescale;
+    }
     //恢复原模式
-    write8(0x00, oldmode);
+    writeMode1(oldmode);
     //等待振荡器稳定
     usleep(5000);
-    write8(0x00, oldmode | 0x80);// 重启(自动增量)
+    writeMode1(oldmode | MODE1_RESTART);// 重启(自动增量)
 
     if (debug) {
         printf("[PWM频率设置] freq=%.2fHz, prescale=%d\n", freq, prescale);
     }
 }
 
+void PCA9685::stage(uint8_t channel, int on, int off) {
+    // 和寄存器一样只保留 12 位
+    uint16_t o = on & 0x0FFF, f = off & 0x0FFF;
+    uint16_t bit = 1u << channel;
+    wantOn[channel] = o;
+    wantOff[channel] = f;
+    if ((knownMask & bit) && chipOn[channel] == o && chipOff[channel] == f) {
+        dirtyMask &= ~bit;
+    } else {
+        dirtyMask |= bit;
+    }
+}
+
+void PCA9685::flush(bool coalesceAll) {
+    uint8_t ch = 0;
+    while (dirtyMask != 0 && ch < CHANNELS) {
+        if (!(dirtyMask & (1u << ch))) {
+            ++ch;
+            continue;
+        }
+        // 从第一个脏通道开始向后扩展：遇到脏通道直接并入；
+        // 干净通道只有在芯片值已知且后面 MERGE_GAP 个以内（coalesceAll 时不限）还有脏通道时才顺带重写
+        uint8_t first = ch, last = ch;
+        for (uint8_t next = ch + 1; next < CHANNELS && (coalesceAll || next - last <= MERGE_GAP + 1); ++next) {
+            uint16_t bit = 1u << next;
+            if (dirtyMask & bit) {
+                last = next;
+            } else if (!(knownMask & bit)) {
+                break;
+            }
+        }
+
+        // LEDn_ON_L, LEDn_ON_H, LEDn_OFF_L, LEDn_OFF_H 四个寄存器地址连续，相邻通道也连续，一次写完
+        uint8_t regs[4 * CHANNELS];
+        uint8_t count = last - first + 1;
+        for (uint8_t i = 0; i < count; ++i) {
+            uint8_t c = first + i;
+            regs[4 * i + 0] = wantOn[c] & 0xFF;
+            regs[4 * i + 1] = (wantOn[c] >> 8) & 0x1F;//stage 的值只有 12 位；读回的 FULL 位随干净通道原样写回
+            regs[4 * i + 2] = wantOff[c] & 0xFF;
+            regs[4 * i + 3] = (wantOff[c] >> 8) & 0x1F;
+        }
+        if (writeBlock(LED0_ON_L + 4 * first, regs, 4 * count)) {
+            for (uint8_t c = first; c <= last; ++c) {
+                chipOn[c] = wantOn[c];
+                chipOff[c] = wantOff[c];
+            }
+            uint16_t runMask = static_cast<uint16_t>(((1u << count) - 1) << first);
+            knownMask |= runMask;
+            dirtyMask &= ~runMask;
+        }
+        // 写失败时保留脏位，下次 flush 重试
+        ch = last + 1;
+    }
+}
+
 void PCA9685::setPWM(uint8_t channel, int on, int off) {
-    write8(0x06 + 4 * channel, on & 0xFF);
-    write8(0x07 + 4 * channel, (on >> 8) & 0x0F);
-    write8(0x08 + 4 * channel, off & 0xFF);
-    write8(0x09 + 4 * channel, (off >> 8) & 0x0F);
+    if (channel >= CHANNELS) {
+        fprintf(stderr, "PWM 通道越界: %d\n", channel);
+        return;
+    }
+    stage(channel, on, off);
+    if (autoFlush) flush();
 
     if (debug) {
         printf("[PWM输出] CH=%d, ON=%d, OFF=%d\n", channel, on, off);
     }
 }
 
+void PCA9685::setPWMRange(uint8_t firstChannel, uint8_t count, const uint16_t* on, const uint16_t* off) {
+    if (count == 0) return;
+    if (firstChannel >= CHANNELS || count > CHANNELS - firstChannel) {
+        fprintf(stderr, "PWM 通道范围越界: first=%d, count=%d\n", firstChannel, count);
+        return;
+    }
+    // 先全部放进影子，没变化的通道不会被写；剩下的由 flush 合并成连续写
+    for (uint8_t i = 0; i < count; ++i) {
+        stage(firstChannel + i, on[i], off[i]);
+    }
+    if (autoFlush) flush();
+
+    if (debug) {
+        printf("[PWM批量输出] CH=%d..%d\n", firstChannel, firstChannel + count - 1);
+    }
+}
+
 void PCA9685::setDutyCycle(uint8_t channel, float duty) {
     if (duty < 0) duty = 0;
     if (duty > 100) duty = 100;
     int off = static_cast<int>(4096 * duty / 100.0f);
+    // 100% 算出来是 4096，寄存器只有 12 位，stage 截掉后会变成 0（满速反而停转），最多取 4095
+    if (off > 4095) off = 4095;
     setPWM(channel, 0, off);
     if (debug) {
         printf("[占空比] CH=%d, duty=%.1f%%\n", channel, duty);
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <cstdio>
+#include <cstddef>
 #include <cmath>
 #include <stdexcept>
 #include <unistd.h>
@@ -15,14 +16,51 @@ private:
     int i2c_fd{-1};//I2C设备文件描述符
     int addr{0x40};//PCA9685默认I2C地址
     bool debug{false};//调试模式标志
-    
+
+    // 寄存器地址（见 PCA9685 数据手册）
+    static constexpr uint8_t MODE1 = 0x00;
+    static constexpr uint8_t LED0_ON_L = 0x06;
+    static constexpr uint8_t PRE_SCALE = 0xFE;
+    // MODE1 位定义
+    static constexpr uint8_t MODE1_RESTART = 0x80;
+    static constexpr uint8_t MODE1_AI = 0x20;//寄存器地址自动递增
+    static constexpr uint8_t MODE1_SLEEP = 0x10;
+    // flush 时两段脏通道之间最多隔几个干净通道仍合并为一次写（多写 4 字节比多一次事务便宜）
+    static constexpr uint8_t MERGE_GAP = 1;
+
+    // 影子寄存器：芯片里实际的值（known 位为 1 时有效）和待写入的目标值
+    uint16_t chipOn[16]{}, chipOff[16]{};
+    uint16_t wantOn[16]{}, wantOff[16]{};
+    uint16_t knownMask{0};//哪些通道的芯片值已知（构造时读回成功后全部已知）
+    uint16_t dirtyMask{0};//哪些通道的目标值还没写进芯片
+    uint8_t mode1{0};//MODE1 寄存器影子，本类是唯一的写入者，所以不必再读芯片
+    uint8_t prescale{0};//PRE_SCALE 影子，0 表示未设置过（合法值 >= 3）
+    bool autoFlush{true};//每次 set* 后立即 flush
+
     //对某个寄存器写 1 字节
-    void write8(uint8_t reg, uint8_t value);
+    bool write8(uint8_t reg, uint8_t value);
+
+    //从 reg 开始连续写 len 字节（依赖 MODE1 自动递增，一次 I2C 事务完成）
+    bool writeBlock(uint8_t reg, const uint8_t* data, size_t len);
+
+    //写 MODE1 并同步影子
+    void writeMode1(uint8_t value);
+
+    //把一个通道的目标值放进影子，和芯片值相同则不标脏
+    void stage(uint8_t channel, int on, int off);
 
     //对某个寄存器读 1 字节
     uint8_t read8(uint8_t reg);
 
+    //从 reg 开始连续读 len 字节（自动递增，一次 I2C 事务）
+    bool readBlock(uint8_t reg, uint8_t* data, size_t len);
+
+    //构造时读回 LED 寄存器填充影子，所有通道变为已知
+    void loadShadow();
+
 public:
+    static constexpr uint8_t CHANNELS = 16;//PWM 通道数
+
     //构造函数:初始化I2C连接
     PCA9685(int bus = 1, int address = 0x40, bool debug_mode = false);
 
@@ -35,6 +73,17 @@ public:
     //直接设置PWM的ON/OFF值
     void setPWM(uint8_t channel, int on, int off);
 
+    //批量设置从 firstChannel 开始的 count 个连续通道，一次 I2C 事务写完
+    void setPWMRange(uint8_t firstChannel, uint8_t count, const uint16_t* on, const uint16_t* off);
+
+    //关闭后 set* 只更新影子，需要手动 flush()；默认打开，行为与逐次写入一致
+    void setAutoFlush(bool enable) { autoFlush = enable; }
+
+    //把所有脏通道合并成尽量少的自动递增连续写；
+    //coalesceAll=true 时从第一个到最后一个脏通道一次写完（中间通道须已知，构造时已读回），
+    //芯片在 I2C STOP 时统一更新输出，这样所有通道同时生效
+    void flush(bool coalesceAll = false);
+
     //设置占空比（百分比）
     void setDutyCycle(uint8_t channel, float duty);
 
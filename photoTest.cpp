@@ -1,19 +1,27 @@
 #include "Poco/Net/HTTPServer.h"
 #include "Poco/Net/HTTPRequestHandler.h"
 #include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/Net/HTTPServerParams.h"
 #include "Poco/Net/HTTPServerRequest.h"
 #include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/URI.h"
+#include "Poco/ThreadPool.h"
+#include "Poco/Timespan.h"
 #include "Poco/Util/ServerApplication.h"
-#include "Poco/StreamCopier.h"
-#include "Poco/Thread.h"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <mutex>
 #include <memory>
-#include <queue>
+#include <deque>
+#include <thread>
 #include <condition_variable>
+#include <sys/mman.h>
 
 // Include the necessary libcamera headers
 #include <libcamera/libcamera.h>
@@ -23,28 +31,102 @@
 #include <libcamera/framebuffer.h>
 #include <libcamera/framebuffer_allocator.h>
 
+using namespace libcamera;
 
+// Encoded JPEG frames are immutable once published and shared by every HTTP client
+using JpegPtr = std::shared_ptr<const std::vector<uchar>>;
 
-// --- 全局共享数据 ---
-// Mutex to protect the shared frame buffer and condition variable
-std::mutex g_frameMutex;
-// Condition variable to signal when a new frame is ready
-std::condition_variable g_frameCV;
-// Shared queue to hold the latest captured frame data
-std::queue<std::vector<uchar>> g_frameQueue;
+// --- 帧广播中心 ---
+// Holds only the latest encoded frame. Each client remembers the last sequence it sent and
+// waits for a newer one, so clients never take frames away from each other; a slow client
+// simply skips to whatever is newest when it is ready again.
+class FrameHub {
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    JpegPtr m_latest;
+    uint64_t m_seq = 0;
+    bool m_closed = false;
+
+public:
+    // Frames can arrive out of order from the encode workers; older ones are dropped
+    bool publish(uint64_t seq, JpegPtr frame) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (seq <= m_seq) return false;
+            m_seq = seq;
+            m_latest = std::move(frame);
+        }
+        m_cv.notify_all();
+        return true;
+    }
+
+    // Wait for a frame newer than `seq`; returns nullptr on timeout or shutdown
+    JpegPtr waitNewer(uint64_t& seq, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock, timeout, [&] { return m_closed || m_seq > seq; });
+        if (m_closed || m_seq <= seq) return nullptr;
+        seq = m_seq;
+        return m_latest;
+    }
+
+    JpegPtr latest() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_latest;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_cv.notify_all();
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+};
+
+FrameHub g_hub;
+std::atomic<int> g_streamClients{0};
 // Flag to indicate if the camera is ready
-bool g_cameraReady = false;
+std::atomic<bool> g_cameraReady{false};
 
 // --- Libcamera 摄像头管理类 ---
+// The completion callback only hands the request to the encode pool and returns at once;
+// a worker wraps the mmapped buffer in a cv::Mat, encodes it and re-queues the request.
+// At most kBufferCount - kSensorReserve buffers are away from the sensor (being encoded or waiting);
+// past that the oldest waiting request is recycled unencoded, so the sensor always has buffers
+// queued and the frame rate stays at the sensor rate.
 class LibcameraManager {
 private:
+    static constexpr unsigned kBufferCount = 6;
+    static constexpr unsigned kSensorReserve = 2;  // buffers that always stay queued at the sensor
+
     std::unique_ptr<CameraManager> m_cameraManager;
     std::shared_ptr<Camera> m_camera;
-    std::unique_ptr<Request> m_request;
+    std::unique_ptr<CameraConfiguration> m_config;
     std::unique_ptr<FrameBufferAllocator> m_allocator;
-    std::vector<std::unique_ptr<FrameBuffer>> m_buffers;
+    std::vector<std::unique_ptr<Request>> m_requests;
+    std::vector<std::pair<void*, size_t>> m_mappings;
+    std::vector<const uchar*> m_planes;  // indexed by request cookie
     Stream* m_stream = nullptr;
-    bool m_capturing = false;
+    unsigned m_width = 0, m_height = 0, m_stride = 0;
+    int m_quality = 80;
+    std::atomic<bool> m_capturing{false};  // also read by the encode workers
+
+    // Encode pool
+    std::mutex m_queueMutex;  // m_capturing checks + queueRequest vs stopCapture
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobCV;
+    std::deque<Request*> m_jobs;
+    std::vector<std::thread> m_workers;
+    unsigned m_busy = 0;  // requests a worker is encoding (guarded by m_jobMutex)
+    bool m_stopping = false;
+    std::atomic<uint64_t> m_captured{0}, m_encoded{0}, m_skipped{0};
+    uint64_t m_lastCaptured = 0, m_lastEncoded = 0;  // printStats() only
 
 public:
     LibcameraManager() {
@@ -52,7 +134,8 @@ public:
     }
 
     // Initialize the camera and prepare for capture
-    bool init() {
+    bool init(unsigned width = 640, unsigned height = 480, int quality = 80) {
+        m_quality = quality;
         if (m_cameraManager->start()) {
             std::cerr << "Error: Camera manager failed to start." << std::endl;
             return false;
@@ -61,55 +144,79 @@ public:
         auto cameras = m_cameraManager->cameras();
         if (cameras.empty()) {
             std::cerr << "Error: No cameras found." << std::endl;
-            m_cameraManager->stop();
             return false;
         }
         m_camera = cameras[0];
 
         if (m_camera->acquire()) {
             std::cerr << "Error: Failed to acquire camera." << std::endl;
-            m_cameraManager->stop();
+            m_camera.reset();
             return false;
         }
 
-        // Configure the camera stream
-        auto config = m_camera->createStillCaptureConfiguration();
-        auto& streamConfig = config->at(0);
-        streamConfig.size.width = 640;
-        streamConfig.size.height = 480;
-        streamConfig.pixelFormat = libcamera::formats::RGB888;
-
-        if (m_camera->configure(config.get()) < 0) {
+        // Configure a video stream (several buffers in flight), not a single still capture
+        m_config = m_camera->generateConfiguration({StreamRole::VideoRecording});
+        if (!m_config) {
+            std::cerr << "Error: Failed to generate camera configuration." << std::endl;
+            return false;
+        }
+        auto& streamConfig = m_config->at(0);
+        streamConfig.size.width = width;
+        streamConfig.size.height = height;
+        streamConfig.pixelFormat = libcamera::formats::RGB888;  // BGR byte order, what OpenCV expects
+        streamConfig.bufferCount = kBufferCount;
+
+        if (m_config->validate() == CameraConfiguration::Invalid ||
+            streamConfig.pixelFormat != libcamera::formats::RGB888) {
+            std::cerr << "Error: RGB888 " << width << "x" << height << " not supported." << std::endl;
+            return false;
+        }
+        if (m_camera->configure(m_config.get()) < 0) {
             std::cerr << "Error: Failed to configure camera stream." << std::endl;
-            m_camera->release();
-            m_cameraManager->stop();
             return false;
         }
 
         m_stream = streamConfig.stream();
+        m_width = streamConfig.size.width;
+        m_height = streamConfig.size.height;
+        m_stride = streamConfig.stride;
         m_allocator = std::make_unique<FrameBufferAllocator>(m_camera);
         if (m_allocator->allocate(m_stream) < 0) {
             std::cerr << "Error: Failed to allocate buffers." << std::endl;
-            m_camera->release();
-            m_cameraManager->stop();
             return false;
         }
 
-        // Populate the buffers vector and queue the first request
-        m_buffers = m_allocator->buffers(m_stream);
-        for (const auto& buffer : m_buffers) {
-            auto req = m_camera->createRequest();
-            if (!req) {
+        // Map every buffer once and keep one request per buffer for the lifetime of the camera
+        const auto& buffers = m_allocator->buffers(m_stream);
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            FrameBuffer* buffer = buffers[i].get();
+            const FrameBuffer::Plane& plane = buffer->planes()[0];
+            size_t length = size_t(plane.offset) + plane.length;
+            void* base = mmap(nullptr, length, PROT_READ, MAP_SHARED, plane.fd.get(), 0);
+            if (base == MAP_FAILED) {
+                std::cerr << "Error: Failed to map frame buffer." << std::endl;
+                return false;
+            }
+            m_mappings.emplace_back(base, length);
+            m_planes.push_back(static_cast<const uchar*>(base) + plane.offset);
+
+            auto req = m_camera->createRequest(i);
+            if (!req || req->addBuffer(m_stream, buffer) < 0) {
                 std::cerr << "Error: Failed to create request." << std::endl;
                 return false;
             }
-            req->addBuffer(m_stream, buffer.get());
-            m_camera->queueRequest(req.get());
+            m_requests.push_back(std::move(req));
         }
 
         // Set up the callback to process completed requests
         m_camera->requestCompleted.connect(this, &LibcameraManager::requestComplete);
 
+        // Keep a couple of buffers queued at the sensor while the rest are being encoded
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        unsigned workers = std::min<unsigned>(std::max(1u, cores - 1), kBufferCount - kSensorReserve);
+        for (unsigned i = 0; i < workers; ++i) m_workers.emplace_back(&LibcameraManager::encodeLoop, this);
+        std::cout << "Camera " << m_width << "x" << m_height << ", " << workers << " encode workers" << std::endl;
+
         g_cameraReady = true;
         return true;
     }
@@ -117,106 +224,180 @@ public:
     void startCapture() {
         if (!m_capturing) {
             m_camera->start();
+            for (auto& req : m_requests) m_camera->queueRequest(req.get());
             m_capturing = true;
         }
     }
 
     void stopCapture() {
         if (m_capturing) {
-            m_camera->stop();
-            m_capturing = false;
+            {
+                // After this block no requeue() is inside queueRequest and none can start one,
+                // so stop() never races a worker. Not held across stop(): stop() waits for
+                // libcamera's thread, which may itself be in requestComplete -> requeue().
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_capturing = false;
+            }
+            m_camera->stop();  // in-flight requests complete as cancelled
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            m_jobs.clear();
         }
     }
 
-    // The callback function that is triggered when a request (frame) is completed
+    // The callback function that is triggered when a request (frame) is completed.
+    // Runs on libcamera's thread: never encode here, just hand the request over.
     void requestComplete(Request* request) {
-        if (request->status() == Request::RequestCancelled) {
-            return;
-        }
-
-        auto const& buffers = request->buffers();
-        if (buffers.empty()) {
+        if (request->status() == Request::RequestCancelled || !m_capturing) {
             return;
         }
+        m_captured++;
 
-        const FrameBuffer* buffer = buffers.begin()->second;
-        const FrameBuffer::Plane& plane = buffer->planes()[0];
-        const void* data = plane.data();
-        size_t dataSize = plane.length();
-
-        // Convert libcamera frame to OpenCV Mat
-        cv::Mat mat(m_stream->configuration().size.height, m_stream->configuration().size.width, CV_8UC3, (void*)data, plane.bytesUsed());
-        
-        // Push the frame into the shared queue and notify waiting threads
-        std::vector<uchar> encodedBuf;
-        cv::imencode(".jpg", mat, encodedBuf, {cv::IMWRITE_JPEG_QUALITY, 80});
-
+        Request* recycle = nullptr;
         {
-            std::lock_guard<std::mutex> lock(g_frameMutex);
-            g_frameQueue.push(encodedBuf);
-            if (g_frameQueue.size() > 10) { // Limit queue size to avoid memory issues
-                g_frameQueue.pop();
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            // With every worker busy this caps the queue at kBufferCount - kSensorReserve - workers
+            if (m_busy + m_jobs.size() + 1 > kBufferCount - kSensorReserve) {
+                // Workers are behind: give the oldest waiting buffer (or this one) straight back to the sensor
+                m_skipped++;
+                if (m_jobs.empty()) {
+                    recycle = request;
+                    request = nullptr;
+                } else {
+                    recycle = m_jobs.front();
+                    m_jobs.pop_front();
+                }
             }
+            if (request) m_jobs.push_back(request);
         }
-        g_frameCV.notify_all();
+        if (request) m_jobCV.notify_one();
+        if (recycle) requeue(recycle);
+    }
 
-        // Re-queue the request to keep the stream going
-        request->reuse(Request::ReuseBuffers);
-        m_camera->queueRequest(request);
+    void printStats(double seconds) {
+        uint64_t captured = m_captured, encoded = m_encoded;
+        std::cout << "[camera] " << (captured - m_lastCaptured) / seconds << " fps captured, "
+                  << (encoded - m_lastEncoded) / seconds << " fps encoded, skipped=" << m_skipped
+                  << ", stream clients=" << g_streamClients << std::endl;
+        m_lastCaptured = captured;
+        m_lastEncoded = encoded;
     }
 
     ~LibcameraManager() {
         stopCapture();
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            m_stopping = true;
+        }
+        m_jobCV.notify_all();
+        for (auto& worker : m_workers) worker.join();
         if (m_camera) {
+            m_camera->requestCompleted.disconnect(this);
+            m_requests.clear();
+            m_allocator.reset();
             m_camera->release();
         }
+        for (auto& mapping : m_mappings) munmap(mapping.first, mapping.second);
         if (m_cameraManager) {
             m_cameraManager->stop();
         }
     }
+
+private:
+    void requeue(Request* request) {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_capturing) return;
+        // Re-queue the request to keep the stream going
+        request->reuse(Request::ReuseBuffers);
+        m_camera->queueRequest(request);
+    }
+
+    void encodeLoop() {
+        std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, m_quality};
+        while (true) {
+            Request* request;
+            {
+                std::unique_lock<std::mutex> lock(m_jobMutex);
+                m_jobCV.wait(lock, [&] { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping) return;
+                request = m_jobs.front();
+                m_jobs.pop_front();
+                m_busy++;
+            }
+
+            // Convert libcamera frame to OpenCV Mat (no copy, respects the row stride)
+            const FrameBuffer* buffer = request->buffers().begin()->second;
+            uint64_t seq = buffer->metadata().sequence + 1;  // hub sequences start above 0
+            bool ok = buffer->metadata().status == FrameMetadata::FrameSuccess;
+            auto encoded = std::make_shared<std::vector<uchar>>();
+            if (ok) {
+                cv::Mat mat(int(m_height), int(m_width), CV_8UC3, const_cast<uchar*>(m_planes[request->cookie()]),
+                            m_stride);
+                ok = cv::imencode(".jpg", mat, *encoded, params);
+            }
+            // The pixels are no longer needed once encoded: hand the buffer back first
+            requeue(request);
+            {
+                std::lock_guard<std::mutex> lock(m_jobMutex);
+                m_busy--;
+            }
+
+            if (ok) {
+                m_encoded++;
+                g_hub.publish(seq, std::move(encoded));
+            }
+        }
+    }
 };
 
 // Global instance of the camera manager
 std::shared_ptr<LibcameraManager> g_cameraManager;
 
 // --- 视频流处理器（MJPEG） ---
+// Every client reads the shared latest frame at its own pace; `/stream?fps=N` caps a client's
+// rate (handy for phones on slow Wi-Fi). A client that can't keep up just skips frames.
 class StreamHandler : public Poco::Net::HTTPRequestHandler {
 public:
     void handleRequest(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response) override {
-        response.setChunkedTransferEncoding(true);
-        response.setContentType("multipart/x-mixed-replace; boundary=frame");
-
-        std::ostream &ostr = response.send();
-
         if (!g_cameraReady) {
-            ostr << "Camera not ready";
+            response.setStatus(Poco::Net::HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+            response.send() << "Camera not ready";
             return;
         }
 
-        while (true) {
-            std::vector<uchar> frameData;
-            {
-                std::unique_lock<std::mutex> lock(g_frameMutex);
-                // Wait for a new frame to become available
-                g_frameCV.wait(lock, [&]{ return !g_frameQueue.empty(); });
-                if (!g_frameQueue.empty()) {
-                    frameData = g_frameQueue.front();
-                    g_frameQueue.pop();
-                }
-            }
+        double fps = 0;
+        for (const auto& param : Poco::URI(request.getURI()).getQueryParameters()) {
+            if (param.first == "fps") fps = std::atof(param.second.c_str());
+        }
+        const auto minInterval = std::chrono::microseconds(fps > 0 ? int64_t(1e6 / fps) : 0);
 
-            if (frameData.empty()) {
-                Poco::Thread::sleep(100);
-                continue;
+        response.setChunkedTransferEncoding(true);
+        response.setKeepAlive(false);
+        response.set("Cache-Control", "no-cache, no-store");
+        response.setContentType("multipart/x-mixed-replace; boundary=frame");
+        std::ostream &ostr = response.send();
+
+        g_streamClients++;
+        uint64_t seq = 0;
+        auto nextDue = std::chrono::steady_clock::now();
+        while (ostr) {
+            if (minInterval.count() > 0) {
+                std::this_thread::sleep_until(nextDue);
+                nextDue = std::max(nextDue + minInterval, std::chrono::steady_clock::now());
+            }
+            JpegPtr frame = g_hub.waitNewer(seq, std::chrono::seconds(1));
+            if (!frame) {
+                if (g_hub.closed()) break;
+                continue;  // camera stalled; keep the connection open
             }
 
             ostr << "--frame\r\n";
             ostr << "Content-Type: image/jpeg\r\n";
-            ostr << "Content-Length: " << frameData.size() << "\r\n\r\n";
-            ostr.write(reinterpret_cast<const char*>(frameData.data()), frameData.size());
+            ostr << "Content-Length: " << frame->size() << "\r\n\r\n";
+            ostr.write(reinterpret_cast<const char*>(frame->data()), std::streamsize(frame->size()));
             ostr << "\r\n";
             ostr.flush();
         }
+        g_streamClients--;
     }
 };
 
@@ -224,8 +405,6 @@ public:
 class CaptureHandler : public Poco::Net::HTTPRequestHandler {
 public:
     void handleRequest(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response) override {
-        response.setContentType("image/jpeg");
-
         if (!g_cameraReady) {
             response.setStatus(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
             std::ostream &ostr = response.send();
@@ -233,24 +412,22 @@ public:
             return;
         }
 
-        std::vector<uchar> frameData;
-        {
-            std::unique_lock<std::mutex> lock(g_frameMutex);
-            g_frameCV.wait_for(lock, std::chrono::seconds(2), [&]{ return !g_frameQueue.empty(); });
-            if (!g_frameQueue.empty()) {
-                frameData = g_frameQueue.front();
-            }
-        }
+        // The latest frame, or wait briefly for the first one right after start-up
+        JpegPtr frame = g_hub.latest();
+        uint64_t seq = 0;
+        if (!frame) frame = g_hub.waitNewer(seq, std::chrono::seconds(2));
 
-        if (frameData.empty()) {
+        if (!frame) {
             response.setStatus(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
             std::ostream &ostr = response.send();
             ostr << "No frame available in time";
             return;
         }
 
+        response.setContentType("image/jpeg");
+        response.setContentLength(std::streamsize(frame->size()));
         std::ostream &ostr = response.send();
-        ostr.write(reinterpret_cast<const char*>(frameData.data()), frameData.size());
+        ostr.write(reinterpret_cast<const char*>(frame->data()), std::streamsize(frame->size()));
     }
 };
 
@@ -281,9 +458,10 @@ public:
 class MyRequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory {
 public:
     Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest &request) override {
-        if (request.getURI() == "/") return new IndexHandler;
-        else if (request.getURI() == "/stream") return new StreamHandler;
-        else if (request.getURI() == "/capture") return new CaptureHandler;
+        const std::string path = Poco::URI(request.getURI()).getPath();
+        if (path == "/") return new IndexHandler;
+        else if (path == "/stream") return new StreamHandler;
+        else if (path == "/capture") return new CaptureHandler;
         else return nullptr;
     }
 };
@@ -299,15 +477,37 @@ protected:
         }
 
         g_cameraManager->startCapture();
-        
-        Poco::Net::HTTPServer s(new MyRequestHandlerFactory, Poco::Net::ServerSocket(8080), new Poco::Net::HTTPServerParams);
+
+        // Each MJPEG viewer holds one server thread for as long as it watches; the default
+        // pool (16 threads) would start queueing new browsers long before the camera is the limit
+        const int kMaxClients = 48;
+        Poco::ThreadPool pool(4, kMaxClients + 4);
+        auto* params = new Poco::Net::HTTPServerParams;
+        params->setMaxThreads(kMaxClients);
+        params->setMaxQueued(16);
+        params->setTimeout(Poco::Timespan(10, 0));  // a stalled browser releases its thread after 10 s
+
+        Poco::Net::HTTPServer s(new MyRequestHandlerFactory, pool, Poco::Net::ServerSocket(8080), params);
         s.start();
         std::cout << "Server started on http://localhost:8080" << std::endl;
 
-        waitForTerminationRequest(); // Ctrl+C 退出
-        
+        // Ctrl+C 退出; report capture/encode rates every 5 s meanwhile
+        std::atomic<bool> done{false};
+        std::thread stats([&] {
+            while (!done) {
+                for (int i = 0; i < 50 && !done; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (!done) g_cameraManager->printStats(5.0);
+            }
+        });
+        waitForTerminationRequest();
+        done = true;
+        stats.join();
+
+        // Wake all stream handlers so stop() doesn't wait on them
+        g_hub.close();
+        s.stopAll(true);
         g_cameraManager->stopCapture();
-        s.stop();
+        g_cameraManager.reset();
         return 0;
     }
 };
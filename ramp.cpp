@@ -0,0 +1,113 @@
+#include "ramp.hpp"
+#include <cmath>
+
+int RampGenerator::add(float initial, float maxVel, float maxAccel, int tag) {
+    if (count_ >= MAX_RAMPS) return -1;
+    int id = count_++;
+    pos_[id] = initial;
+    vel_[id] = 0;
+    target_[id] = initial;
+    maxVel_[id] = maxVel;
+    maxAccel_[id] = maxAccel;
+    tag_[id] = tag;
+    inActive_[id] = false;
+    return id;
+}
+
+void RampGenerator::setLimits(int id, float maxVel, float maxAccel) {
+    maxVel_[id] = maxVel;
+    maxAccel_[id] = maxAccel;
+}
+
+void RampGenerator::activate(int id) {
+    if (inActive_[id]) return;
+    inActive_[id] = true;
+    active_[activeCount_++] = id;
+}
+
+void RampGenerator::setTarget(int id, float target) {
+    if (target_[id] == target && !inActive_[id]) return;
+    target_[id] = target;
+    if (pos_[id] != target) activate(id);
+}
+
+void RampGenerator::reset(int id, float value) {
+    pos_[id] = value;
+    target_[id] = value;
+    vel_[id] = 0;
+    // 仍留在运动列表里也没关系：下一次 step 发现已到达会移除，且不会报告变化
+}
+
+int RampGenerator::step(float dt, int* changed) {
+    int n = 0;
+    int i = 0;
+    while (i < activeCount_) {
+        int id = active_[i];
+        float pos = pos_[id], vel = vel_[id];
+        float remain = target_[id] - pos;
+        float vmax = maxVel_[id], a = maxAccel_[id];
+        bool done = false;
+
+        if (remain == 0) {
+            // 已在目标上（包括运动中目标被改成当前位置）：就地停下，不越过目标
+            vel = 0;
+            done = true;
+        } else if (vmax <= 0 || a <= 0) {
+            // 不限速：直接到目标
+            pos = target_[id];
+            vel = 0;
+            done = true;
+        } else {
+            float dir = remain > 0 ? 1.0f : -1.0f;
+            float dv = a * dt;
+            if (vel * dir < 0) {
+                // 还在背离目标运动（目标中途反向）：先按 maxAccel 减速，不会越过目标
+                vel += dir * dv;
+                pos += vel * dt;
+            } else {
+                // 朝目标运动：速度不超过 maxVel、不超过上一周期 + dv，也不超过按剩余距离刚好能刹住的 sqrt(2a·剩余)，
+                // 所以减速从剩余距离算起，而不是等越过目标后再拉回来
+                float speed = std::fabs(vel) + dv;
+                float brake = std::sqrt(2 * a * std::fabs(remain));
+                if (speed > brake) speed = brake;
+                if (speed > vmax) speed = vmax;
+                vel = dir * speed;
+                float next = pos + vel * dt;
+                // 这一步会到达或越过目标就停在目标上：输出永远不会冲过头（车轮不会短暂反转，舵机不会过摆）
+                if ((target_[id] - next) * dir <= 0) {
+                    pos = target_[id];
+                    vel = 0;
+                    done = true;
+                } else {
+                    pos = next;
+                }
+            }
+        }
+
+        if (pos != pos_[id]) changed[n++] = id;
+        pos_[id] = pos;
+        vel_[id] = vel;
+
+        if (done) {
+            // 用最后一个元素填补空位，O(1) 移除
+            inActive_[id] = false;
+            active_[i] = active_[--activeCount_];
+        } else {
+            ++i;
+        }
+    }
+    return n;
+}
+
+int RampGenerator::finish(int* changed) {
+    int n = 0;
+    for (int i = 0; i < activeCount_; ++i) {
+        int id = active_[i];
+        if (pos_[id] != target_[id]) changed[n++] = id;
+        pos_[id] = target_[id];
+        vel_[id] = 0;
+        inActive_[id] = false;
+    }
+    activeCount_ = 0;
+    return n;
+}
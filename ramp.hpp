@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// ==================== 梯形速度曲线发生器 ====================
+// 每条斜坡（ramp）有当前值、当前速度、目标值，以及最大速度 maxVel（单位/秒）和最大加速度 maxAccel（单位/秒²）。
+// step(dt) 在控制线程里按固定周期调用：先以 maxAccel 加速到 maxVel，快到目标时按同样的加速度减速，
+// 减速点按剩余距离 sqrt(2·maxAccel·剩余) 计算，输出永远不会越过目标；目标中途改变也能平滑过渡（不会瞬间反向）。
+// maxVel 或 maxAccel <= 0 表示不限制，直接跳到目标。
+//
+// 数据按数组（SoA）存放，只遍历还在运动的斜坡，几百条同时运动也只是几百次浮点运算；不分配内存。
+class RampGenerator {
+public:
+    static constexpr int MAX_RAMPS = 256;
+
+    // 新建一条斜坡，初始值为 initial；tag 由调用方自定义（比如对应的通道号）。满了返回 -1
+    int add(float initial, float maxVel, float maxAccel, int tag = 0);
+
+    void setLimits(int id, float maxVel, float maxAccel);
+
+    // 设置新的目标值，下一次 step 开始向它运动
+    void setTarget(int id, float target);
+
+    // 立即跳到 value 并停止运动（外部直接写了硬件时用来同步）
+    void reset(int id, float value);
+
+    float value(int id) const { return pos_[id]; }
+    float target(int id) const { return target_[id]; }
+    int tag(int id) const { return tag_[id]; }
+    int size() const { return count_; }
+    int activeCount() const { return activeCount_; }
+
+    // 所有运动中的斜坡前进 dt 秒，把值有变化的 id 写进 changed（容量至少 MAX_RAMPS），返回个数
+    int step(float dt, int* changed);
+
+    // 所有运动中的斜坡立即到达目标（比如退出前），返回值同 step
+    int finish(int* changed);
+
+private:
+    void activate(int id);
+
+    float pos_[MAX_RAMPS];
+    float vel_[MAX_RAMPS];
+    float target_[MAX_RAMPS];
+    float maxVel_[MAX_RAMPS];
+    float maxAccel_[MAX_RAMPS];
+    int tag_[MAX_RAMPS];
+    bool inActive_[MAX_RAMPS];
+    int active_[MAX_RAMPS];//运动中的斜坡 id 列表
+    int activeCount_{0};
+    int count_{0};
+};
@@ -0,0 +1,218 @@
+#include "ranger.hpp"
+#include "ringlog.hpp"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iterator>
+
+static constexpr uint32_t TRIG_PULSE_US = 10;  // HC-SR04 要求 TRIG 至少 10us 高电平
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+UltrasonicRanger::UltrasonicRanger(int handle, const Config& config)
+    : handle_(handle),
+      config_(config),
+      hampel_(3.0f, config.hampelMinCm),
+      kalman_(config.accelVar, config.measVar) {}
+
+UltrasonicRanger::~UltrasonicRanger() {
+    stop();
+}
+
+int UltrasonicRanger::start() {
+    if (running_) return LG_OKAY;
+
+    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd_ < 0) return LG_NOT_ENOUGH_MEMORY;
+
+    int rc = lgGpioClaimOutput(handle_, 0, config_.trig, 0);
+    if (rc < 0) {
+        RLOG_E("[Ranger] lgGpioClaimOutput(TRIG=%d) 失败: %d", config_.trig, rc);
+        close(eventFd_);
+        eventFd_ = -1;
+        return rc;
+    }
+    // 告警线程给每个边沿打内核时间戳（CLOCK_MONOTONIC），回调里只做配对和计算
+    rc = lgGpioClaimAlert(handle_, 0, LG_BOTH_EDGES, config_.echo, -1);
+    if (rc >= 0) rc = lgGpioSetAlertsFunc(handle_, config_.echo, &UltrasonicRanger::alertTrampoline, this);
+    if (rc >= 0) rc = lgGpioSetWatchdog(handle_, config_.echo, (int)config_.watchdogUs);
+    if (rc < 0) {
+        RLOG_E("[Ranger] 注册 ECHO=%d 告警失败: %d", config_.echo, rc);
+        lgGpioFree(handle_, config_.echo);
+        lgGpioFree(handle_, config_.trig);
+        close(eventFd_);
+        eventFd_ = -1;
+        return rc;
+    }
+
+    // 先按最慢的安全周期触发，拿到回波宽度后再收紧
+    rc = setPeriod(config_.maxPeriodUs);
+    if (rc < 0) {
+        RLOG_E("[Ranger] lgTxPulse(TRIG=%d) 失败: %d", config_.trig, rc);
+        lgGpioSetAlertsFunc(handle_, config_.echo, nullptr, nullptr);
+        lgGpioFree(handle_, config_.echo);
+        lgGpioFree(handle_, config_.trig);
+        close(eventFd_);
+        eventFd_ = -1;
+        return rc;
+    }
+    running_ = true;
+    return LG_OKAY;
+}
+
+void UltrasonicRanger::stop() {
+    if (!running_) return;
+    running_ = false;
+    lgTxPulse(handle_, config_.trig, 0, 0, 0, 0);  // 停掉并清空 TX 队列
+    lgGpioSetAlertsFunc(handle_, config_.echo, nullptr, nullptr);
+    lgGpioFree(handle_, config_.echo);
+    lgGpioWrite(handle_, config_.trig, 0);
+    lgGpioFree(handle_, config_.trig);
+    close(eventFd_);
+    eventFd_ = -1;
+}
+
+int UltrasonicRanger::setPeriod(uint32_t periodUs) {
+    // 无限循环的脉冲在当前周期结束时被新的设置替换，不会打断正在进行的一次触发
+    int rc = lgTxPulse(handle_, config_.trig, TRIG_PULSE_US, (int)(periodUs - TRIG_PULSE_US), 0, 0);
+    if (rc >= 0) {
+        periodUs_.store(periodUs, std::memory_order_relaxed);
+        repaced_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return rc;
+}
+
+// 触发周期 = 最近几次回波里最长的 + 保护时间；变化超过 1/8 才重新下发，避免频繁改 TX 队列
+void UltrasonicRanger::pace(uint32_t echoUs) {
+    recentEchoUs_[recentPos_++ % 4] = echoUs;
+    uint32_t longest = *std::max_element(std::begin(recentEchoUs_), std::end(recentEchoUs_));
+    uint32_t want = std::clamp(longest + config_.guardUs, config_.minPeriodUs, config_.maxPeriodUs);
+    uint32_t cur = periodUs_.load(std::memory_order_relaxed);
+    uint32_t delta = want > cur ? want - cur : cur - want;
+    if (delta > cur / 8) setPeriod(want);
+}
+
+void UltrasonicRanger::alertTrampoline(int count, lgGpioAlert_p events, void* self) {
+    static_cast<UltrasonicRanger*>(self)->onAlerts(count, events);
+}
+
+void UltrasonicRanger::onAlerts(int count, const lgGpioAlert_t* events) {
+    for (int i = 0; i < count; ++i) {
+        const lgGpioReport_t& r = events[i].report;
+        if (r.flags != 0 || r.gpio != config_.echo) continue;
+
+        if (r.level == 1) {
+            // 上升沿：传感器发出了超声波。和上一次上升沿隔得太久，说明中间有触发被忽略了
+            if (lastRiseNs_ != 0) {
+                uint64_t gapUs = (r.timestamp - lastRiseNs_) / 1000;
+                uint32_t period = periodUs_.load(std::memory_order_relaxed);
+                if (period && gapUs > period + period / 2) {
+                    missed_.fetch_add(gapUs / period - 1 + (gapUs % period > period / 2), std::memory_order_relaxed);
+                    pace(std::min<uint32_t>((uint32_t)gapUs, config_.maxPeriodUs));
+                }
+            }
+            riseNs_ = lastRiseNs_ = r.timestamp;
+        } else if (r.level == 0) {
+            if (riseNs_ == 0) continue;  // 没看到上升沿（刚启动），这次不算
+            RangeSample s;
+            s.timestampNs = r.timestamp;
+            s.echoUs = (uint32_t)((r.timestamp - riseNs_) / 1000);
+            riseNs_ = 0;
+            if (s.echoUs < config_.minEchoUs) {
+                s.status = RangeSample::Status::TooClose;
+            } else if (s.echoUs > config_.maxEchoUs) {
+                s.status = RangeSample::Status::OutOfRange;
+            } else {
+                s.cm = s.echoUs * config_.cmPerUs;
+            }
+            samples_.fetch_add(1, std::memory_order_relaxed);
+            if (s.status != RangeSample::Status::Ok) invalid_.fetch_add(1, std::memory_order_relaxed);
+            publish(s);
+            pace(s.echoUs);
+        } else if (r.level == LG_TIMEOUT) {
+            RangeSample s;
+            s.timestampNs = r.timestamp ? r.timestamp : monotonicNs();
+            s.status = RangeSample::Status::Timeout;
+            riseNs_ = 0;
+            timeouts_.fetch_add(1, std::memory_order_relaxed);
+            publish(s);
+            pace(config_.maxPeriodUs);
+        }
+    }
+}
+
+void UltrasonicRanger::publish(const RangeSample& sample) {
+    if (!results_.push(sample)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t n = write(eventFd_, &one, sizeof(one));  // 计数器溢出前读取方早就读走了，EAGAIN 可以忽略
+    (void)n;
+}
+
+bool UltrasonicRanger::wait(int timeoutMs) {
+    if (!results_.empty()) return true;
+    pollfd pfd{eventFd_, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeoutMs);
+    if (rc > 0) {
+        uint64_t value;
+        ssize_t n = read(eventFd_, &value, sizeof(value));
+        (void)n;
+    }
+    return !results_.empty();
+}
+
+bool UltrasonicRanger::nextSample(RangeSample& sample) {
+    return results_.pop(sample);
+}
+
+bool UltrasonicRanger::next(RangeSample& sample, RangeReading& reading) {
+    if (!results_.pop(sample)) return false;
+    float cm = -1;
+    if (sample.status == RangeSample::Status::Ok) {
+        cm = sample.cm;
+    } else if (sample.status == RangeSample::Status::OutOfRange) {
+        cm = config_.maxEchoUs * config_.cmPerUs;  // 量程内没有障碍物，按最远处算，中值才会离开近处的旧值
+    } else if (sample.status == RangeSample::Status::Timeout) {
+        // 传感器没响应，旧数据不再代表当前距离
+        window_.clear();
+        hampel_.clear();
+        kalman_.reset();
+        lastFilteredNs_ = 0;
+    }
+    reading.outlier = false;
+    if (cm >= 0) {
+        window_.push(cm);
+        HampelFilter<float, FILTER_WINDOW>::Result h = hampel_.update(cm);
+        float dt = lastFilteredNs_ ? (sample.timestampNs - lastFilteredNs_) * 1e-9f : 0.0f;
+        kalman_.update(h.value, dt);
+        lastFilteredNs_ = sample.timestampNs;
+        reading.outlier = h.outlier;
+    }
+    reading.timestampNs = sample.timestampNs;
+    reading.rawCm = sample.cm;
+    reading.medianCm = window_.median();
+    reading.trimmedMeanCm = window_.trimmedMean(1);
+    reading.windowSize = (uint32_t)window_.size();
+    reading.smoothedCm = kalman_.primed() ? kalman_.position() : 0.0f;
+    reading.velocityCmS = kalman_.primed() ? kalman_.velocity() : 0.0f;
+    return true;
+}
+
+UltrasonicRanger::Stats UltrasonicRanger::stats() const {
+    Stats s;
+    s.samples = samples_.load(std::memory_order_relaxed);
+    s.invalid = invalid_.load(std::memory_order_relaxed);
+    s.timeouts = timeouts_.load(std::memory_order_relaxed);
+    s.missed = missed_.load(std::memory_order_relaxed);
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    s.repaced = repaced_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "filters.hpp"
+#include "spscqueue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <lgpio.h>
+
+// ==================== 超声波测距引擎（HC-SR04） ====================
+// 触发和计时都不占用调用方线程：
+//   - TRIG 由 lgpio 的 TX 线程发脉冲（lgTxPulse，10us 高电平 + 周期剩余时间低电平，无限循环）；
+//   - ECHO 的上升/下降沿由 lgpio 告警线程回调，回调里把一对边沿配成一次回波宽度，算出距离，
+//     放进单生产者单消费者的无锁结果环（SpscQueue），再写 eventfd 唤醒读取方；
+//   - 触发周期按最近的回波宽度 + 保护时间自动调整：近处的障碍物回波短，可以测得更快；
+//     没有障碍物时传感器把 ECHO 拉高约 38ms，周期自动放慢，避免在回波没结束时触发（会被传感器忽略）。
+// 读取方（一个线程）用 wait() 等待、next() 取出每次采样和滤波后的结果。
+
+// 一次原始采样
+struct RangeSample {
+    enum class Status : uint8_t {
+        Ok,          // 有效距离
+        TooClose,    // 回波太短（小于最小量程，多为误触发）
+        OutOfRange,  // 回波太长：量程内没有障碍物
+        Timeout,     // 看门狗超时：ECHO 一直没有变化（传感器掉线或接线问题）
+    };
+
+    uint64_t timestampNs{0};  // 回波下降沿时刻（CLOCK_MONOTONIC，纳秒；Timeout 为超时时刻）
+    uint32_t echoUs{0};       // 回波宽度（微秒）
+    float cm{0};              // 距离（Status::Ok 时有效）
+    Status status{Status::Ok};
+};
+
+// 滤波后的一次输出（每个有效采样都输出一次，窗口滑动）
+struct RangeReading {
+    uint64_t timestampNs{0};
+    float rawCm{0};
+    float medianCm{0};
+    float trimmedMeanCm{0};  // 去掉最小、最大各一个
+    uint32_t windowSize{0};  // 窗口里的有效样本数
+    float smoothedCm{0};     // Hampel 去掉离群点后再经卡尔曼平滑
+    float velocityCmS{0};    // 卡尔曼估计的速度，负数表示障碍物在靠近
+    bool outlier{false};     // 这次原始采样被 Hampel 判为离群点
+};
+
+class UltrasonicRanger {
+public:
+    static constexpr size_t FILTER_WINDOW = 5;
+    static constexpr size_t RESULT_RING = 64;  // 2 的幂；读取方最多落后这么多次采样
+
+    struct Config {
+        int trig{20};
+        int echo{21};
+        uint32_t minEchoUs{117};        // 约 2cm，更短的回波当作误触发
+        uint32_t maxEchoUs{23300};      // 约 400cm，HC-SR04 的标称量程
+        uint32_t guardUs{8000};         // 回波结束后到下一次触发的保护时间（等远处的余波衰减）
+        uint32_t minPeriodUs{15000};    // 触发周期下限（约 66Hz）
+        uint32_t maxPeriodUs{60000};    // 触发周期上限（数据手册建议的 60ms）
+        uint32_t watchdogUs{200000};    // 这么久 ECHO 没有任何变化就报 Timeout
+        float cmPerUs{0.034326f / 2};   // 声速（20°C）往返折半
+        float hampelMinCm{5.0f};        // Hampel 门限的下限（读数量化时 MAD 常为 0）
+        float accelVar{1e4f};           // 卡尔曼过程噪声：障碍物相对加速度的方差（(cm/s²)²）
+        float measVar{1.0f};            // 卡尔曼测量噪声（cm²）
+    };
+
+    // handle：lgGpiochipOpen 返回的句柄（调用方负责打开/关闭芯片）
+    UltrasonicRanger(int handle, const Config& config);
+    ~UltrasonicRanger();
+
+    UltrasonicRanger(const UltrasonicRanger&) = delete;
+    UltrasonicRanger& operator=(const UltrasonicRanger&) = delete;
+
+    // 申请 GPIO、注册回调并开始触发；失败时返回 lgpio 错误码（< 0），已申请的资源会释放
+    int start();
+    void stop();
+
+    // 等到有新采样（或超时），timeoutMs < 0 表示一直等；返回是否有数据可取
+    bool wait(int timeoutMs);
+
+    // 取一次原始采样（读取方线程）
+    bool nextSample(RangeSample& sample);
+
+    // 取出一次采样并更新滤波器：超量程按最大量程进窗口，太近的误触发不进窗口，超时清空窗口；
+    // 每次采样都照样返回给调用方看状态。
+    // 返回 false 表示结果环已经空了
+    bool next(RangeSample& sample, RangeReading& reading);
+
+    // 可以交给 poll/epoll 的 fd（有新采样时可读）；读取方用 wait() 时不需要关心
+    int eventFd() const { return eventFd_; }
+
+    uint32_t periodUs() const { return periodUs_.load(std::memory_order_relaxed); }
+
+    struct Stats {
+        uint64_t samples{0};     // 配成对的回波（含超量程）
+        uint64_t invalid{0};     // TooClose + OutOfRange
+        uint64_t timeouts{0};
+        uint64_t missed{0};      // 触发后没有回波（传感器在忙、忽略了触发）
+        uint64_t dropped{0};     // 结果环满，读取方太慢
+        uint64_t repaced{0};     // 调整触发周期的次数
+    };
+    Stats stats() const;
+
+private:
+    static void alertTrampoline(int count, lgGpioAlert_p events, void* self);
+    void onAlerts(int count, const lgGpioAlert_t* events);
+    void publish(const RangeSample& sample);
+    void pace(uint32_t echoUs);
+    int setPeriod(uint32_t periodUs);
+
+    int handle_;
+    Config config_;
+    int eventFd_{-1};
+    bool running_{false};
+
+    // 只在告警线程里访问
+    uint64_t riseNs_{0};        // 0 表示还没等到上升沿
+    uint64_t lastRiseNs_{0};
+    uint32_t recentEchoUs_[4]{};
+    size_t recentPos_{0};
+
+    std::atomic<uint32_t> periodUs_{0};
+    SpscQueue<RangeSample, RESULT_RING> results_;
+
+    // 只在读取方线程里访问（滤波器见 filters.hpp）
+    SortedWindow<float, FILTER_WINDOW> window_;
+    HampelFilter<float, FILTER_WINDOW> hampel_;
+    KalmanCV kalman_;
+    uint64_t lastFilteredNs_{0};
+
+    std::atomic<uint64_t> samples_{0}, invalid_{0}, timeouts_{0}, missed_{0}, dropped_{0}, repaced_{0};
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <time.h>
+
+// ==================== 分级环形缓冲日志 ====================
+// 控制回路里不能直接 std::cout << ... << std::endl：每次都要加锁、格式化、flush 到终端。
+// 这里调用方只把格式化好的一行放进固定大小的环形缓冲（无锁、无堆分配），
+// 由后台线程统一写到 stderr。缓冲满时丢弃新日志并计数，绝不阻塞调用方。
+//
+// 用法：RLOG_I("motor=%d speed=%.1f", motor, speed);
+// 定义 NDEBUG（Release 构建）后 RLOG_D/RLOG_I 整条语句被编译掉，参数也不会求值；
+// RLOG_W/RLOG_E 保留。定义 RLOG_DISABLE 则全部编译掉。
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+class RingLogger {
+public:
+    static constexpr size_t CAPACITY = 256;//槽位数，必须是 2 的幂
+    static constexpr size_t kLineMax = 120;//每条日志最长字节数（超出截断）
+
+    static RingLogger& instance() {
+        static RingLogger logger;
+        return logger;
+    }
+
+    //多生产者入队（Vyukov 有界队列）：每个槽位带序号，抢到槽位后写内容再发布
+    void log(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 3, 4))) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[pos & (CAPACITY - 1)];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);//缓冲满
+                return;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->ns = nowNs();
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(slot->text, kLineMax, fmt, ap);
+        va_end(ap);
+        slot->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    //把已入队的日志全部写出（后台线程调用，退出前也会调用一次）
+    void drain() {
+        for (;;) {
+            Slot& slot = slots_[tail_ & (CAPACITY - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) break;
+            static const char* const names[] = {"DBG", "INFO", "WARN", "ERR "};
+            fprintf(stderr, "[%s %llu.%06llu] %s\n", names[(int)slot.level],
+                    (unsigned long long)(slot.ns / 1000000000ull),
+                    (unsigned long long)(slot.ns / 1000ull % 1000000ull), slot.text);
+            slot.seq.store(tail_ + CAPACITY, std::memory_order_release);
+            ++tail_;
+        }
+        size_t lost = dropped_.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            fprintf(stderr, "[WARN] 日志缓冲已满，丢弃 %zu 条\n", lost);
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        LogLevel level{LogLevel::Info};
+        uint64_t ns{0};
+        char text[kLineMax];
+    };
+
+    RingLogger() {
+        for (size_t i = 0; i < CAPACITY; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+        writer_ = std::thread([this]() {
+            while (running_.load(std::memory_order_relaxed)) {
+                drain();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        });
+    }
+
+    ~RingLogger() {
+        running_ = false;
+        if (writer_.joinable()) writer_.join();
+        drain();
+    }
+
+    static uint64_t nowNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+
+    Slot slots_[CAPACITY];
+    alignas(64) std::atomic<size_t> head_{0};//生产者写位置
+    alignas(64) size_t tail_{0};//只有后台线程访问
+    std::atomic<size_t> dropped_{0};
+    std::atomic<bool> running_{true};
+    std::thread writer_;
+};
+
+#if defined(RLOG_DISABLE)
+#define RLOG_D(...) ((void)0)
+#define RLOG_I(...) ((void)0)
+#define RLOG_W(...) ((void)0)
+#define RLOG_E(...) ((void)0)
+#else
+#if defined(NDEBUG)
+#define RLOG_D(...) ((void)0)
+#define RLOG_I(...) ((void)0)
+#else
+#define RLOG_D(...) RingLogger::instance().log(LogLevel::Debug, __VA_ARGS__)
+#define RLOG_I(...) RingLogger::instance().log(LogLevel::Info, __VA_ARGS__)
+#endif
+#define RLOG_W(...) RingLogger::instance().log(LogLevel::Warn, __VA_ARGS__)
+#define RLOG_E(...) RingLogger::instance().log(LogLevel::Error, __VA_ARGS__)
+#endif
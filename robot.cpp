@@ -1,12 +1,9 @@
 #include <iostream>
-#include <iomanip> // for std::setprecision
-#include <thread>  // for std::this_thread::sleep_for
-#include <chrono>  // for std::chrono::milliseconds
-#include <atomic>  // 原子变量（autoRotation）
 #include <termios.h> // 终端控制（getch）
 #include <unistd.h> //  POSIX 系统调用（getchar, sleep）
 #include <cstdio>    // C 风格输入输出
 #include "loborobot.hpp"
+#include "controlloop.hpp"
 
 // ============ 键盘控制工具 ============
 int getch() {//实现无回车输入，按一个键立即响应
@@ -36,17 +33,22 @@ int main() {
     
     try {
         LOBOROBOT robot(false); // true = 开启调试模式;false = 关闭调试模式
+        // 控制线程：100Hz、绑定 CPU3、SCHED_FIFO 优先级 50；启动后电机和舵机只由它访问
+        ControlLoop loop(robot, 100.0, 3, 50);
+        loop.start();
+        // 本线程是控制队列唯一的生产者；队列满（控制线程卡住）时提示一下
+        auto send = [&](const ControlCommand& cmd) {
+            if (!loop.post(cmd)) std::cerr << "[警告] 控制队列已满，指令被丢弃\n";
+        };
         
         //初始化小车速度
         float speed = 30.0f;
         //初始化舵机位置
-        robot.setServoAngle(10, 80);//底座舵机，底座舵机旋转角度范围0~180度
-        robot.setServoAngle(9, 0);//顶部舵机，顶部舵机旋转角度范围0~90度
+        send(ControlCommand::servo(10, 80));//底座舵机，底座舵机旋转角度范围0~180度
+        send(ControlCommand::servo(9, 0));//顶部舵机，顶部舵机旋转角度范围0~90度
         //初始化舵机旋转角度和时间间隔
         float t = 0.5f, angle = 10.0f;
         float baseAngle = 80, topAngle = 0;
-        bool autoDirection = true;
-        std::atomic<bool> autoRotation(false); // 控制自动旋转的标志位（原子变量，线程安全）
 
         std::cout << "W/w: 控制小车前进\n";
         std::cout << "S/s: 控制小车后退\n";
@@ -67,71 +69,43 @@ int main() {
         std::cout << "X:   退出程序\n";
         std::cout << "当前速度: " << speed << "%\n";
 
-        // 新开一个线程处理自动旋转
-        std::thread autoThread([&]() {
-            while (true) {
-                if (autoRotation) {
-                    if (autoDirection) {
-                        baseAngle += angle;
-                        if (baseAngle >= 180) {
-                            baseAngle = 180;
-                            autoDirection = false;
-                            std::cout << "[自动] 到达边界 190 度, 反转\n";
-                        }
-                    } else {
-                        baseAngle -= angle;
-                        if (baseAngle <= 0) {
-                            baseAngle = 0;
-                            autoDirection = true;
-                            std::cout << "[自动] 到达边界 2 度, 反转\n";
-                        }
-                    }
-                    robot.setServoAngle(10, baseAngle);
-                    std::cout << "\r[自动] 底座角度: " << baseAngle << "度" << std::flush;
-                    std::this_thread::sleep_for(std::chrono::duration<float>(t));
-                } else {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                }
-            }
-        });
-
-        std:;atomic<bool> running = true;
+        bool running = true;
         while (running) {
             int key = getch();
             if (key != EOF) { // 如果按下了按键
-                std::cout << "检测到按键: " << static_cast<char>(key) << std::endl;
+                std::cout << "检测到按键: " << static_cast<char>(key) << "\n";
                 switch(key) {
-                    //方向
+                    //方向（都是 drive 的特例：vx 前进、vy 左移、omega 逆时针）
                     case 'w':
                     case 'W':
-                        robot.t_up(speed);
+                        send(ControlCommand::drive(speed, 0, 0));
                         std::cout << "前进\n";
                         break;
                     case 's':
                     case 'S':
-                        robot.t_back(speed);
+                        send(ControlCommand::drive(-speed, 0, 0));
                         std::cout << "后退\n";
                         break;
                     case 'a':
-                        robot.turnLeft(speed);
+                        send(ControlCommand::drive(0, 0, speed));
                         std::cout << "左转\n";
                         break;
                     case 'A':
-                        robot.moveLeft(speed);
+                        send(ControlCommand::drive(0, speed, 0));
                         std::cout << "左移\n";
                         break;
                     case 'd':
-                        robot.turnRight(speed);
+                        send(ControlCommand::drive(0, 0, -speed));
                         std::cout << "右转\n";
                         break;
                     case 'D':
-                        robot.moveRight(speed);
+                        send(ControlCommand::drive(0, -speed, 0));
                         std::cout << "右移\n";
                         break;
 
                     //停止   
                     case ' ':
-                        robot.t_stop();
+                        send(ControlCommand::drive(0, 0, 0));
                         std::cout << "停止\n";
                         break;
                 
@@ -151,7 +125,7 @@ int main() {
                     case '0': 
                         speed = 0;  
                         std::cout << "速度 = 0%\n";  
-                        robot.t_stop(); 
+                        send(ControlCommand::drive(0, 0, 0));
                         break;
                     case '1': 
                         speed = 10; 
@@ -191,48 +165,45 @@ int main() {
                         break;
 
                     //控制底座舵机旋转---------------------------------------------------
+                    //以控制线程里的当前角度为准（自动旋转可能改过它）；手动指令会让控制线程停止自动旋转
                     case 'j':
                     case 'J':
-                        autoRotation = false; // 切换到手动模式
-                        baseAngle += angle;
+                        baseAngle = loop.servoAngle(10) + angle;
                         if (baseAngle > 190) {
                             baseAngle = 190;
                         }
-                        robot.setServoAngle(10, baseAngle);
+                        send(ControlCommand::servo(10, baseAngle));
                         std::cout << "[操作] 底座舵机角度设置为: " << baseAngle << "度\n";
                         break;
                     
                     case 'L':
                     case 'l':
-                        autoRotation = false; // 切换到手动模式
-                        baseAngle -= angle;
+                        baseAngle = loop.servoAngle(10) - angle;
                         if (baseAngle < 2) {
                             baseAngle = 2;
                         }
-                        robot.setServoAngle(10, baseAngle);
+                        send(ControlCommand::servo(10, baseAngle));
                         std::cout << "[操作] 底座舵机角度设置为: " << baseAngle << "度\n";
                         break;
                     
                     //控制顶部舵机旋转----------------------------------------------------
                     case 'K':
                     case 'k':
-                        autoRotation = false; // 切换到手动模式
-                        topAngle += angle;
+                        topAngle = loop.servoAngle(9) + angle;
                         if (topAngle > 90) {
                             topAngle = 90;
                         }
-                        robot.setServoAngle(9, topAngle);
+                        send(ControlCommand::servo(9, topAngle));
                         std::cout << "[操作] 顶部舵机角度设置为: " << topAngle << "度\n";
                         break;
                     
                     case 'I':
                     case 'i':
-                        autoRotation = false; // 切换到手动模式
-                        topAngle -= angle;
+                        topAngle = loop.servoAngle(9) - angle;
                         if (topAngle < 0) {
                             topAngle = 0;
                         }
-                        robot.setServoAngle(9, topAngle);
+                        send(ControlCommand::servo(9, topAngle));
                         std::cout << "[操作] 顶部舵机角度设置为: " << topAngle << "度\n";
                         break;
                     //------------------------------------------------------------------
@@ -240,21 +211,21 @@ int main() {
                     //开始自动旋转
                     case 'z':
                     case 'Z':
-                        autoRotation = true;
+                        send(ControlCommand::sweepStart(10, angle, t, 0, 180));
                         std::cout << "\n[状态] 开始自动旋转 (底座在0-180度间往返)...\n";
                         break;
                         
                     //暂停舵机自动旋转
                     case 'o':
                     case 'O':
-                        autoRotation = false;
+                        send(ControlCommand::sweepStop());
                         std::cout << "\n[状态] 自动旋转已暂停。\n";
                         break;
 
                     //改变选择的角度
                     case 'c':
                     case 'C':{
-                        autoRotation = false; // 切换到手动模式
+                        send(ControlCommand::sweepStop()); // 切换到手动模式
                         float oldAngle = angle;
                         std::cout << "请输入新的旋转角度 (当前 " << angle << "): ";
                         std::cin >> angle;
@@ -266,7 +237,7 @@ int main() {
                     //改变间隔时间
                     case 't':
                     case 'T':{
-                        autoRotation = false; // 切换到手动模式
+                        send(ControlCommand::sweepStop()); // 切换到手动模式
                         float oldT = t;
                         std::cout << "请输入新的间隔时间 (秒, 当前 " << t << "): ";
                         std::cin >> t;
@@ -279,10 +250,10 @@ int main() {
                     case 'x':
                     case 'X':
                         //恢复到初始位置
-                        autoRotation = false;
-                        robot.setServoAngle(10, 80);//底座舵机
-                        robot.setServoAngle(9, 0);//顶部舵机
-                        baseAngle = 90, topAngle = 0;
+                        send(ControlCommand::sweepStop());
+                        send(ControlCommand::drive(0, 0, 0));
+                        send(ControlCommand::servo(10, 80));//底座舵机
+                        send(ControlCommand::servo(9, 0));//顶部舵机
                         running = false;
                         std::cout << "退出指令接收\n";
                         break;
@@ -291,7 +262,7 @@ int main() {
                 }
             }
         }
-        autoThread.detach(); // 主程序退出时释放线程
+        loop.stop(); // 控制线程执行完剩余指令后退出
         std::cout << "\n退出程序\n";
     } catch (const std::exception& e) {
         std::cerr << "程序异常终止: " << e.what() << std::endl;
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <lgpio.h>
+#include "sonararray.hpp"
+
+// ==================== 多路超声波阵列测试 ====================
+// 用法：sudo ./sonarTest [rr|grouped]
+//   rr      ：轮询，每个传感器单独一个时隙（默认，最保守）
+//   grouped ：前/后一组、左/右一组，朝向相反的两个同时发射，帧长减半
+// 每帧输出一行距离向量（每 200ms 一行），每秒输出一次吞吐报告。
+
+// 根据接线修改：{TRIG, ECHO, 分组}
+static const SonarArray::Sensor SENSORS[] = {
+    {20, 21, 0},  // 前
+    {16, 12, 1},  // 左
+    {19, 26, 0},  // 后
+    {6, 13, 1},   // 右
+};
+
+static std::atomic<bool> run_loop(true);
+
+static void signal_handler(int signum) {
+    if (signum == SIGINT) run_loop = false;
+}
+
+int main(int argc, char** argv) {
+    std::signal(SIGINT, signal_handler);
+
+    SonarArray::Config config;
+    config.sensors.assign(std::begin(SENSORS), std::end(SENSORS));
+    config.pattern = (argc > 1 && std::strcmp(argv[1], "grouped") == 0) ? SonarArray::Pattern::Grouped
+                                                                         : SonarArray::Pattern::RoundRobin;
+
+    int handle = lgGpiochipOpen(0);
+    if (handle < LG_OKAY) {
+        std::cerr << "lgGpiochipOpen failed, error code: " << handle << std::endl;
+        return 1;
+    }
+    SonarArray sonar(handle, config);
+    int ret = sonar.start();
+    if (ret < 0) {
+        std::cerr << "SonarArray start failed, error code: " << ret << std::endl;
+        lgGpiochipClose(handle);
+        return 1;
+    }
+    std::printf("%u 个传感器，%u 个时隙，帧长 %uus\n", sonar.sensorCount(), sonar.slots(), sonar.frameUs());
+
+    using Clock = std::chrono::steady_clock;
+    auto lastPrint = Clock::now();
+    auto lastReport = lastPrint;
+    RangeScan scan;
+    while (run_loop.load()) {
+        if (!sonar.wait(100)) continue;
+        bool got = false;
+        while (sonar.next(scan)) got = true;  // 只显示最新一帧
+        auto now = Clock::now();
+        if (got && now - lastPrint >= std::chrono::milliseconds(200)) {
+            lastPrint = now;
+            std::printf("#%-6llu", (unsigned long long)scan.seq);
+            for (uint32_t i = 0; i < scan.count; ++i) {
+                const RangeSample& s = scan.samples[i];
+                if (s.status == RangeSample::Status::Ok) std::printf("  %6.1fcm", s.cm);
+                else if (s.status == RangeSample::Status::OutOfRange) std::printf("  %8s", "far");
+                else if (s.status == RangeSample::Status::TooClose) std::printf("  %8s", "near");
+                else std::printf("  %8s", "--");
+            }
+            std::printf("\n");
+        }
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            lastReport = now;
+            sonar.report(stdout);
+        }
+    }
+
+    sonar.stop();
+    lgGpiochipClose(handle);
+    std::cout << "done\n";
+    return 0;
+}
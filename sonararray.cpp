@@ -0,0 +1,283 @@
+#include "sonararray.hpp"
+#include "ringlog.hpp"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+static constexpr uint32_t TRIG_PULSE_US = 10;
+static constexpr uint32_t ONE_SECOND_US = 1000000;
+
+static uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 不小于 us 的最小的 1 秒的约数：lgpio 按整秒内的周期整数倍对齐脉冲起点，帧长整除 1 秒时各路 TRIG 相位固定
+static uint32_t roundUpToSecondDivisor(uint32_t us) {
+    uint32_t best = ONE_SECOND_US;
+    for (uint32_t p2 = 1; p2 <= 64; p2 *= 2) {        // 1000000 = 2^6 * 5^6
+        for (uint32_t p5 = 1; p5 <= 15625; p5 *= 5) {
+            uint32_t d = p2 * p5;
+            if (d >= us && d < best) best = d;
+        }
+    }
+    return best;
+}
+
+SonarArray::SonarArray(int handle, const Config& config) : handle_(handle), config_(config) {}
+
+SonarArray::~SonarArray() {
+    stop();
+}
+
+int SonarArray::start() {
+    if (running_) return LG_OKAY;
+    if (config_.sensors.empty() || config_.sensors.size() > RangeScan::MAX_SENSORS) return LG_TOO_MANY_GPIOS;
+
+    // 时隙划分：轮询模式一个传感器一个时隙，分组模式按 group 编号（必须从 0 连续编号）
+    count_ = (uint32_t)config_.sensors.size();
+    slots_ = 0;
+    for (uint32_t i = 0; i < count_; ++i) {
+        int group = config_.pattern == Pattern::RoundRobin ? (int)i : config_.sensors[i].group;
+        if (group < 0 || group >= (int)count_) return LG_BAD_CONFIG_VALUE;
+        slots_ = std::max<uint32_t>(slots_, (uint32_t)group + 1);
+    }
+    for (uint32_t g = 0; g < slots_; ++g) {
+        bool used = false;
+        for (uint32_t i = 0; i < count_; ++i) {
+            used = used || (config_.pattern == Pattern::RoundRobin ? i == g : config_.sensors[i].group == (int)g);
+        }
+        if (!used) return LG_BAD_CONFIG_VALUE;
+    }
+    // 帧长向上取到 1 秒的约数，多出来的时间平均分给各个时隙（余波衰减得更充分）
+    frameUs_ = roundUpToSecondDivisor(slots_ * config_.slotUs);
+    slotSpacingUs_ = frameUs_ / slots_;
+
+    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd_ < 0) return LG_NOT_ENOUGH_MEMORY;
+
+    open_ = false;
+    reported_ = 0;
+    current_ = RangeScan{};
+    for (uint32_t i = 0; i < count_; ++i) {
+        const Sensor& pins = config_.sensors[i];
+        SensorState& s = sensors_[i];
+        s = SensorState{};
+        s.owner = this;
+        s.index = i;
+        s.trig = pins.trig;
+        s.echo = pins.echo;
+        uint32_t group = config_.pattern == Pattern::RoundRobin ? i : (uint32_t)pins.group;
+        s.offsetUs = group * slotSpacingUs_;
+
+        int rc = lgGpioClaimOutput(handle_, 0, s.trig, 0);
+        if (rc >= 0) {
+            rc = lgGpioClaimAlert(handle_, 0, LG_BOTH_EDGES, s.echo, -1);
+            if (rc < 0) lgGpioFree(handle_, s.trig);
+        }
+        if (rc >= 0) {
+            s.claimed = true;
+            rc = lgGpioSetAlertsFunc(handle_, s.echo, &SonarArray::alertTrampoline, &s);
+        }
+        if (rc >= 0) rc = lgGpioSetWatchdog(handle_, s.echo, (int)config_.watchdogUs);
+        if (rc < 0) {
+            RLOG_E("[SonarArray] 传感器 %u（TRIG=%d ECHO=%d）初始化失败: %d", i, s.trig, s.echo, rc);
+            release();
+            return rc;
+        }
+    }
+
+    // 所有告警都就绪后再统一发射，各路 TRIG 周期相同、只差 offset
+    for (uint32_t i = 0; i < count_; ++i) {
+        SensorState& s = sensors_[i];
+        int rc = lgTxPulse(handle_, s.trig, TRIG_PULSE_US, (int)(frameUs_ - TRIG_PULSE_US), (int)s.offsetUs, 0);
+        if (rc < 0) {
+            RLOG_E("[SonarArray] lgTxPulse(TRIG=%d) 失败: %d", s.trig, rc);
+            release();
+            return rc;
+        }
+    }
+    RLOG_I("[SonarArray] %u 个传感器，%u 个时隙，帧长 %uus（每个传感器 %.1fHz，合计 %.1fHz）", count_, slots_,
+           frameUs_, 1e6 / frameUs_, 1e6 * count_ / frameUs_);
+    lastReportNs_ = monotonicNs();
+    running_ = true;
+    return LG_OKAY;
+}
+
+void SonarArray::stop() {
+    if (!running_) return;
+    running_ = false;
+    release();
+}
+
+void SonarArray::release() {
+    for (uint32_t i = 0; i < count_; ++i) {
+        SensorState& s = sensors_[i];
+        if (!s.claimed) continue;
+        lgTxPulse(handle_, s.trig, 0, 0, 0, 0);
+        lgGpioSetAlertsFunc(handle_, s.echo, nullptr, nullptr);
+        lgGpioFree(handle_, s.echo);
+        lgGpioWrite(handle_, s.trig, 0);
+        lgGpioFree(handle_, s.trig);
+        s.claimed = false;
+    }
+    if (eventFd_ >= 0) close(eventFd_);
+    eventFd_ = -1;
+}
+
+void SonarArray::alertTrampoline(int count, lgGpioAlert_p events, void* sensor) {
+    SensorState& s = *static_cast<SensorState*>(sensor);
+    s.owner->onAlerts(s, count, events);
+}
+
+void SonarArray::onAlerts(SensorState& sensor, int count, const lgGpioAlert_t* events) {
+    for (int i = 0; i < count; ++i) {
+        const lgGpioReport_t& r = events[i].report;
+        if (r.flags != 0 || r.gpio != sensor.echo) continue;
+
+        if (r.level == 1) {
+            onRise(sensor, r.timestamp);
+        } else if (r.level == 0) {
+            if (sensor.riseNs == 0) continue;
+            RangeSample s;
+            s.timestampNs = r.timestamp;
+            s.echoUs = (uint32_t)((r.timestamp - sensor.riseNs) / 1000);
+            sensor.riseNs = 0;
+            if (s.echoUs < config_.minEchoUs) {
+                s.status = RangeSample::Status::TooClose;
+            } else if (s.echoUs > config_.maxEchoUs) {
+                s.status = RangeSample::Status::OutOfRange;
+            } else {
+                s.cm = s.echoUs * config_.cmPerUs;
+            }
+            samples_.fetch_add(1, std::memory_order_relaxed);
+            if (!open_ || sensor.riseSeq != current_.seq) {
+                // 回波结束前这一帧已经发布了（无障碍物时 ECHO 会拉高约 38ms，比时隙长）
+                late_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            fill(sensor, s);
+        } else if (r.level == LG_TIMEOUT) {
+            sensor.riseNs = 0;
+            if (!open_) continue;
+            RangeSample s;
+            s.timestampNs = r.timestamp ? r.timestamp : monotonicNs();
+            s.status = RangeSample::Status::Timeout;
+            fill(sensor, s);
+        }
+    }
+}
+
+// 上升沿：按传感器的时隙偏移倒推帧起点，离当前帧起点超过半帧就是新的一帧
+void SonarArray::onRise(SensorState& sensor, uint64_t ns) {
+    uint64_t frameNs = (uint64_t)frameUs_ * 1000;
+    uint64_t start = ns - (uint64_t)sensor.offsetUs * 1000;
+    bool newFrame = current_.seq == 0 || (start > current_.startNs && start - current_.startNs > frameNs / 2);
+    if (newFrame) {
+        if (open_) closeFrame();
+        current_.seq++;
+        current_.startNs = start;
+        current_.count = count_;
+        for (uint32_t i = 0; i < count_; ++i) {
+            current_.samples[i] = RangeSample{};
+            current_.samples[i].status = RangeSample::Status::Timeout;
+            filled_[i] = false;
+        }
+        reported_ = 0;
+        open_ = true;
+    } else {
+        // 同一帧里：上升沿应该落在自己时隙的前半段，否则相位漂了，回波可能和邻近时隙串扰
+        uint64_t expect = current_.startNs + (uint64_t)sensor.offsetUs * 1000;
+        uint64_t skew = ns > expect ? ns - expect : expect - ns;
+        if (skew > (uint64_t)slotSpacingUs_ * 500) skewed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    sensor.riseNs = ns;
+    sensor.riseSeq = current_.seq;
+}
+
+void SonarArray::fill(SensorState& sensor, const RangeSample& sample) {
+    if (filled_[sensor.index]) return;
+    filled_[sensor.index] = true;
+    current_.samples[sensor.index] = sample;
+    if (sample.status == RangeSample::Status::Ok) {
+        valid_.fetch_add(1, std::memory_order_relaxed);
+        perSensorValid_[sensor.index].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (++reported_ == count_) closeFrame();
+}
+
+// 发布当前帧：还在等回波、已经超过最大量程的按超量程算，没有上升沿的保持 Timeout
+void SonarArray::closeFrame() {
+    open_ = false;
+    uint64_t now = monotonicNs();
+    for (uint32_t i = 0; i < count_; ++i) {
+        if (filled_[i]) continue;
+        const SensorState& s = sensors_[i];
+        if (s.riseNs != 0 && s.riseSeq == current_.seq && now - s.riseNs > (uint64_t)config_.maxEchoUs * 1000) {
+            current_.samples[i].status = RangeSample::Status::OutOfRange;
+            current_.samples[i].timestampNs = now;
+            current_.samples[i].echoUs = (uint32_t)((now - s.riseNs) / 1000);
+        } else {
+            missed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    if (!results_.push(current_)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t n = write(eventFd_, &one, sizeof(one));
+    (void)n;
+}
+
+bool SonarArray::wait(int timeoutMs) {
+    if (!results_.empty()) return true;
+    pollfd pfd{eventFd_, POLLIN, 0};
+    if (poll(&pfd, 1, timeoutMs) > 0) {
+        uint64_t value;
+        ssize_t n = read(eventFd_, &value, sizeof(value));
+        (void)n;
+    }
+    return !results_.empty();
+}
+
+bool SonarArray::next(RangeScan& scan) {
+    return results_.pop(scan);
+}
+
+SonarArray::Stats SonarArray::stats() const {
+    Stats s;
+    s.frames = frames_.load(std::memory_order_relaxed);
+    s.samples = samples_.load(std::memory_order_relaxed);
+    s.valid = valid_.load(std::memory_order_relaxed);
+    s.missed = missed_.load(std::memory_order_relaxed);
+    s.late = late_.load(std::memory_order_relaxed);
+    s.skewed = skewed_.load(std::memory_order_relaxed);
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void SonarArray::report(FILE* out) {
+    uint64_t now = monotonicNs();
+    double secs = (now - lastReportNs_) / 1e9;
+    if (secs <= 0) return;
+    Stats s = stats();
+    std::fprintf(out, "[SonarArray] 帧 %.1f/s，回波 %.1f/s（有效 %.1f/s，理论上限 %.1f/s）漏 %llu 迟到 %llu 相位偏 %llu 丢帧 %llu\n",
+                 (s.frames - lastStats_.frames) / secs, (s.samples - lastStats_.samples) / secs,
+                 (s.valid - lastStats_.valid) / secs, 1e6 * count_ / frameUs_,
+                 (unsigned long long)(s.missed - lastStats_.missed), (unsigned long long)(s.late - lastStats_.late),
+                 (unsigned long long)(s.skewed - lastStats_.skewed),
+                 (unsigned long long)(s.dropped - lastStats_.dropped));
+    for (uint32_t i = 0; i < count_; ++i) {
+        uint64_t v = validSamples(i);
+        std::fprintf(out, "  #%u TRIG=%d ECHO=%d 偏移 %6uus 有效 %.1f/s\n", i, sensors_[i].trig, sensors_[i].echo,
+                     sensors_[i].offsetUs, (v - lastPerSensor_[i]) / secs);
+        lastPerSensor_[i] = v;
+    }
+    lastStats_ = s;
+    lastReportNs_ = now;
+}
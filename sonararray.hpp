@@ -0,0 +1,138 @@
+#pragma once
+#include "ranger.hpp"
+#include "spscqueue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <lgpio.h>
+
+// ==================== 多路超声波阵列（HC-SR04 × N） ====================
+// 几个传感器同时发射会互相收到对方的超声波（串扰），所以按时隙轮流发射：
+//   - 一帧分成若干时隙，每个时隙留够最大量程的往返时间 + 余波衰减时间；
+//   - 同一组的传感器在同一个时隙一起发射（朝向不同、互不干扰的传感器可以分到一组），
+//     轮询模式下每个传感器单独一组；
+//   - 每个 TRIG 都是 lgTxPulse 的无限循环脉冲，周期都等于帧长，用 offset 错开到自己的时隙。
+//     lgpio 按"整秒内的周期整数倍"对齐每路脉冲的起点，帧长取 1 秒的约数，所有 TRIG 就锁在同一个相位上，
+//     之后完全由 TX 线程发射，不需要任何线程参与调度。
+// 每个 ECHO 单独注册告警回调（userdata 指向该传感器自己的记录），回调都在 lgpio 的同一个告警线程里，
+// 把边沿配成回波宽度后填进当前帧；一帧的所有传感器都有结果（或下一帧开始）时，整帧的距离向量
+// 放进无锁结果环并写 eventfd。
+
+// 一帧的测距结果
+struct RangeScan {
+    static constexpr size_t MAX_SENSORS = 8;
+
+    uint64_t seq{0};
+    uint64_t startNs{0};  // 帧起点（由第 0 个时隙的上升沿推算，CLOCK_MONOTONIC）
+    uint32_t count{0};    // 有效的传感器个数
+    // 本帧没等到回波（漏触发、传感器掉线）的传感器标成 Timeout
+    RangeSample samples[MAX_SENSORS];
+};
+
+class SonarArray {
+public:
+    static constexpr size_t RESULT_RING = 32;  // 2 的幂
+
+    enum class Pattern {
+        RoundRobin,  // 每个传感器单独一个时隙
+        Grouped,     // 按 Sensor::group 分时隙，同组同时发射
+    };
+
+    struct Sensor {
+        int trig;
+        int echo;
+        int group{0};  // 只在 Pattern::Grouped 下使用，从 0 开始连续编号
+    };
+
+    struct Config {
+        std::vector<Sensor> sensors;
+        Pattern pattern{Pattern::RoundRobin};
+        uint32_t slotUs{30000};       // 每个时隙的最短长度：400cm 往返约 23.3ms + 余波衰减
+        uint32_t minEchoUs{117};      // 约 2cm
+        uint32_t maxEchoUs{23300};    // 约 400cm，更长的回波当作超量程
+        uint32_t watchdogUs{500000};  // ECHO 这么久没有变化报 Timeout（传感器掉线）
+        float cmPerUs{0.034326f / 2};
+    };
+
+    // handle：lgGpiochipOpen 返回的句柄（调用方负责打开/关闭芯片）
+    SonarArray(int handle, const Config& config);
+    ~SonarArray();
+
+    SonarArray(const SonarArray&) = delete;
+    SonarArray& operator=(const SonarArray&) = delete;
+
+    // 申请全部 GPIO、注册回调并开始按时隙发射；失败返回 lgpio 错误码（< 0），已申请的资源会释放
+    int start();
+    void stop();
+
+    // 等到有新的一帧（或超时），timeoutMs < 0 表示一直等
+    bool wait(int timeoutMs);
+    bool next(RangeScan& scan);
+    int eventFd() const { return eventFd_; }
+
+    uint32_t frameUs() const { return frameUs_; }
+    uint32_t slots() const { return slots_; }
+    uint32_t sensorCount() const { return count_; }
+
+    struct Stats {
+        uint64_t frames{0};
+        uint64_t samples{0};     // 所有传感器配成对的回波（含超量程）
+        uint64_t valid{0};       // 其中距离有效的
+        uint64_t missed{0};      // 整帧结束时还没有回波的传感器次数
+        uint64_t late{0};        // 帧已经发布后才结束的回波（按超量程发布过了）
+        uint64_t skewed{0};      // 上升沿不在自己时隙里（相位没锁住，可能串扰）
+        uint64_t dropped{0};     // 结果环满
+    };
+    Stats stats() const;
+    uint64_t validSamples(size_t sensor) const { return perSensorValid_[sensor].load(std::memory_order_relaxed); }
+
+    // 吞吐报告：自上次调用以来的整体采样率、帧率、每个传感器的有效采样率，以及按帧长算的理论上限
+    void report(FILE* out);
+
+private:
+    struct SensorState {
+        SonarArray* owner{nullptr};
+        uint32_t index{0};
+        int trig{-1};
+        int echo{-1};
+        uint32_t offsetUs{0};  // 在帧里的发射时刻
+        bool claimed{false};
+        // 只在告警线程里访问
+        uint64_t riseNs{0};
+        uint64_t riseSeq{0};
+    };
+
+    static void alertTrampoline(int count, lgGpioAlert_p events, void* sensor);
+    void onAlerts(SensorState& sensor, int count, const lgGpioAlert_t* events);
+    void onRise(SensorState& sensor, uint64_t ns);
+    void fill(SensorState& sensor, const RangeSample& sample);
+    void closeFrame();
+    void release();
+
+    int handle_;
+    Config config_;
+    int eventFd_{-1};
+    bool running_{false};
+    uint32_t count_{0};
+    uint32_t slots_{0};
+    uint32_t slotSpacingUs_{0};
+    uint32_t frameUs_{0};
+    SensorState sensors_[RangeScan::MAX_SENSORS];
+
+    // 当前帧，只在告警线程里访问
+    RangeScan current_;
+    bool open_{false};
+    uint32_t reported_{0};
+    bool filled_[RangeScan::MAX_SENSORS]{};
+
+    SpscQueue<RangeScan, RESULT_RING> results_;
+
+    std::atomic<uint64_t> frames_{0}, samples_{0}, valid_{0}, missed_{0}, late_{0}, skewed_{0}, dropped_{0};
+    std::atomic<uint64_t> perSensorValid_[RangeScan::MAX_SENSORS] = {};
+
+    // report() 的上一次快照（只在调用 report 的线程里访问）
+    uint64_t lastReportNs_{0};
+    Stats lastStats_;
+    uint64_t lastPerSensor_[RangeScan::MAX_SENSORS]{};
+};
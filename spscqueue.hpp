@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// ==================== 单生产者单消费者无锁队列 ====================
+// 固定容量的环形缓冲，push 只能在一个线程里调用，pop 只能在另一个线程里调用。
+// 不加锁、不分配内存；队列满时 push 返回 false，由调用方决定丢弃还是重试。
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue 容量必须是 2 的幂");
+
+public:
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == N) return false;//满
+        buf_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;//空
+        item = buf_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+private:
+    T buf_[N];
+    alignas(64) std::atomic<size_t> head_{0};//生产者写位置
+    alignas(64) std::atomic<size_t> tail_{0};//消费者读位置
+};